@@ -7,8 +7,16 @@
 #include "nbl/ext/ScreenShot/ScreenShot.h"
 #include "nbl/ext/FullScreenTriangle/FullScreenTriangle.h"
 
+#include "nbl/system/CStdoutLogger.h"
+
+#include "../common/ResidentMemory.hpp"
+#include "../common/StreamingImageWriter.hpp"
+
 #include <iostream>
 #include <cstdio>
+#include <chrono>
+#include <fstream>
+#include <thread>
 
 using namespace nbl;
 
@@ -22,6 +30,246 @@ struct NBL_CAPTION_DATA_TO_DISPLAY
 	std::string extension;
 };
 
+static core::vector<std::string> readTestingImagePaths()
+{
+	core::vector<std::string> paths;
+	std::ifstream list(testingImagePathsFile.data());
+	for (std::string line; std::getline(list, line); )
+		if (line != "" && line[0] != ';')
+			paths.push_back(line);
+	return paths;
+}
+
+/*
+	Streams an 8 bit RGBA or BGRA screenshot into a PNG, bands of rows get swizzled and deflated on all cores
+	while the file only ever holds the finished blocks. Any other format goes through the asset writer.
+*/
+static bool writeScreenShotPNG(asset::IAssetManager* assetManager, core::smart_refctd_ptr<asset::ICPUImageView>&& imageView, const std::string& path)
+{
+	if (!imageView)
+		return false;
+	const auto& viewParams = imageView->getCreationParameters();
+	const auto* image = viewParams.image.get();
+	const auto& imageParams = image->getCreationParameters();
+
+	bool swapRedAndBlue = false;
+	switch (viewParams.format)
+	{
+		case asset::EF_R8G8B8A8_UNORM: [[fallthrough]];
+		case asset::EF_R8G8B8A8_SRGB:
+			break;
+		case asset::EF_B8G8R8A8_UNORM: [[fallthrough]];
+		case asset::EF_B8G8R8A8_SRGB:
+			swapRedAndBlue = true;
+			break;
+		default:
+		{
+			asset::IAssetWriter::SAssetWriteParams writeParams(imageView.get());
+			return assetManager->writeAsset(path,writeParams);
+		}
+	}
+
+	const uint32_t width = imageParams.extent.width;
+	const uint32_t height = imageParams.extent.height;
+	const auto& region = image->getRegions().begin()[0];
+	const size_t rowPitch = size_t(region.bufferRowLength ? region.bufferRowLength:width)*4ull;
+	const auto* texels = reinterpret_cast<const uint8_t*>(image->getBuffer()->getPointer())+region.bufferOffset;
+
+	examples::CStreamingPNGWriter writer(path,width,height,4u);
+	if (!writer.isValid())
+		return false;
+
+	constexpr uint32_t RowsPerBand = examples::CStreamingPNGWriter::RowsPerBlock;
+	core::vector<uint32_t> bands((height+RowsPerBand-1u)/RowsPerBand);
+	std::iota(bands.begin(),bands.end(),0u);
+	std::atomic_bool success = true;
+	std::for_each(core::execution::par,bands.begin(),bands.end(),[&](const uint32_t band) -> void
+		{
+			const uint32_t firstRow = band*RowsPerBand;
+			const uint32_t rowCount = std::min(RowsPerBand,height-firstRow);
+			const uint8_t* bandTexels = texels+firstRow*rowPitch;
+			core::vector<uint8_t> swizzled;
+			if (swapRedAndBlue)
+			{
+				swizzled.resize(size_t(rowCount)*width*4ull);
+				for (uint32_t y=0u; y<rowCount; y++)
+				for (uint32_t x=0u; x<width; x++)
+				{
+					const uint8_t* in = bandTexels+y*rowPitch+x*4ull;
+					uint8_t* out = swizzled.data()+(size_t(y)*width+x)*4ull;
+					out[0] = in[2];
+					out[1] = in[1];
+					out[2] = in[0];
+					out[3] = in[3];
+				}
+			}
+			if (!writer.writeRows(firstRow,rowCount,swapRedAndBlue ? swizzled.data():bandTexels,swapRedAndBlue ? width*4ull:rowPitch))
+				success = false;
+		}
+	);
+	return writer.finish() && success;
+}
+
+/*
+	Headless loader throughput, decodes every image of the testing list with N threads calling `getAsset` concurrently,
+	with caching off so every call decodes. Reports decode MB/s of texels per format, wall clock scaling with the thread count
+	and the peak resident memory of each run. The decoded texels get checksummed, the single threaded run is the reference
+	for the others and the checksums get logged so they can be compared between builds.
+*/
+class CImageLoaderBenchmark
+{
+	using clock_type = std::chrono::steady_clock;
+
+public:
+	CImageLoaderBenchmark(system::ILogger* logger) : m_logger(logger)
+	{
+		m_system = system::IApplicationFramework::createSystem();
+		m_assetManager = core::make_smart_refctd_ptr<asset::IAssetManager>(core::smart_refctd_ptr(m_system));
+	}
+
+	void run()
+	{
+		// the list is short, so it gets decoded a few times per run to give the threads something to share
+		constexpr uint32_t Passes = 8u;
+
+		const auto paths = readTestingImagePaths();
+		if (paths.empty())
+		{
+			m_logger->log("No images to load, %s is missing or empty", system::ILogger::ELL_ERROR, testingImagePathsFile.data());
+			return;
+		}
+
+		core::vector<std::string> formats(paths.size());
+		for (size_t i = 0u; i < paths.size(); i++)
+		{
+			formats[i] = std::filesystem::path(paths[i]).extension().string();
+			std::transform(formats[i].begin(), formats[i].end(), formats[i].begin(), [](const char c) -> char { return static_cast<char>(std::tolower(c)); });
+		}
+
+		m_logger->log("Image loader benchmark, %zu images, %u passes, %u hardware threads", system::ILogger::ELL_PERFORMANCE, paths.size(), Passes, std::thread::hardware_concurrency());
+
+		core::vector<SResult> reference;
+		double singleThreadedSeconds = 0.0;
+		const uint32_t maxThreads = core::max(std::thread::hardware_concurrency(), 1u);
+		for (uint32_t threadCount = 1u; ; threadCount = core::min(threadCount * 2u, maxThreads))
+		{
+			core::vector<SResult> results(paths.size() * Passes);
+			std::atomic_uint32_t nextJob = 0u;
+			examples::CResidentMemorySampler residentSampler;
+
+			const auto start = clock_type::now();
+			{
+				core::vector<std::thread> threads;
+				threads.reserve(threadCount);
+				for (uint32_t t = 0u; t < threadCount; t++)
+					threads.emplace_back([&]() -> void
+						{
+							for (uint32_t job = nextJob++; job < results.size(); job = nextJob++)
+								results[job] = load(paths[job % paths.size()]);
+						}
+					);
+				for (auto& thread : threads)
+					thread.join();
+			}
+			const double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+			residentSampler.stop();
+
+			// per format throughput is the decoded size over the time spent in `getAsset`, so it doesn't depend on the thread count unless something contends
+			core::map<std::string, std::pair<size_t, double>> formatTotals;
+			size_t totalBytes = 0ull;
+			uint32_t failures = 0u, mismatches = 0u;
+			for (size_t job = 0u; job < results.size(); job++)
+			{
+				const auto& result = results[job];
+				if (result.byteSize == 0ull)
+				{
+					failures++;
+					continue;
+				}
+				auto& totals = formatTotals[formats[job % paths.size()]];
+				totals.first += result.byteSize;
+				totals.second += result.seconds;
+				totalBytes += result.byteSize;
+
+				const auto& expected = threadCount == 1u ? results[job % paths.size()] : reference[job % paths.size()];
+				if (result.byteSize != expected.byteSize || result.checksum != expected.checksum)
+					mismatches++;
+			}
+			if (failures)
+				m_logger->log("%u threads: %u loads failed!", system::ILogger::ELL_ERROR, threadCount, failures);
+			if (mismatches)
+				m_logger->log("%u threads: %u loads decoded different texels than the single threaded run!", system::ILogger::ELL_ERROR, threadCount, mismatches);
+
+			if (threadCount == 1u)
+			{
+				reference.assign(results.begin(), results.begin() + paths.size());
+				singleThreadedSeconds = seconds;
+				for (size_t i = 0u; i < paths.size(); i++)
+					m_logger->log("\t%s: %zu bytes of texels, checksum %016llx", system::ILogger::ELL_INFO, paths[i].c_str(), reference[i].byteSize, static_cast<unsigned long long>(reference[i].checksum));
+			}
+
+			m_logger->log("%u threads: %.1f MB/s of texels, %.2fx of single threaded, %.1f%% efficiency, peak resident memory %.1f MB (+%.1f MB)", system::ILogger::ELL_PERFORMANCE,
+				threadCount, double(totalBytes) * 1e-6 / seconds, singleThreadedSeconds / seconds, 100.0 * singleThreadedSeconds / (seconds * threadCount),
+				double(residentSampler.getPeakResident()) * 1e-6, double(residentSampler.getPeakGrowth()) * 1e-6);
+			for (const auto& [format, totals] : formatTotals)
+				m_logger->log("\t%s: %.1f MB/s per decoding thread", system::ILogger::ELL_PERFORMANCE, format.c_str(), double(totals.first) * 1e-6 / totals.second);
+
+			if (threadCount == maxThreads)
+				break;
+		}
+	}
+
+private:
+	struct SResult
+	{
+		size_t byteSize = 0ull; // 0 on failure
+		uint64_t checksum = 0ull;
+		double seconds = 0.0;
+	};
+
+	SResult load(const std::string& path)
+	{
+		constexpr auto cachingFlags = static_cast<asset::IAssetLoader::E_CACHING_FLAGS>(asset::IAssetLoader::ECF_DONT_CACHE_REFERENCES | asset::IAssetLoader::ECF_DONT_CACHE_TOP_LEVEL);
+		asset::IAssetLoader::SAssetLoadParams loadParams(0ull, nullptr, cachingFlags);
+
+		SResult result;
+		const auto start = clock_type::now();
+		auto bundle = m_assetManager->getAsset(path, loadParams);
+		result.seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+
+		const auto contents = bundle.getContents();
+		if (contents.empty())
+			return result;
+
+		const asset::ICPUImage* image = nullptr;
+		auto asset = *contents.begin();
+		switch (asset->getAssetType())
+		{
+			case asset::IAsset::ET_IMAGE:
+				image = static_cast<const asset::ICPUImage*>(asset.get());
+				break;
+			case asset::IAsset::ET_IMAGE_VIEW:
+				image = static_cast<const asset::ICPUImageView*>(asset.get())->getCreationParameters().image.get();
+				break;
+			default:
+				return result;
+		}
+
+		// FNV-1a, every mip level and layer of every loader lives in the one buffer
+		const auto* buffer = image->getBuffer();
+		const uint8_t* texels = reinterpret_cast<const uint8_t*>(buffer->getPointer());
+		result.checksum = 0xcbf29ce484222325ull;
+		for (size_t i = 0u; i < buffer->getSize(); i++)
+			result.checksum = (result.checksum ^ texels[i]) * 0x100000001b3ull;
+		result.byteSize = buffer->getSize();
+		return result;
+	}
+
+	system::ILogger* m_logger;
+	core::smart_refctd_ptr<system::ISystem> m_system;
+	core::smart_refctd_ptr<asset::IAssetManager> m_assetManager;
+};
+
 class ColorSpaceTestSampleApp : public ApplicationBase
 {
 	constexpr static uint32_t WIN_W = 512u;
@@ -632,15 +880,14 @@ public:
 
 			const std::string writePath = "screenShot_" + captionData.name + ".png";
 
-			return ext::ScreenShot::createScreenShot(
+			auto cpuImageView = ext::ScreenShot::createScreenShot(
 				logicalDevice.get(),
 				queues[decltype(initOutput)::EQT_TRANSFER_UP],
 				nullptr,
 				gpuSourceImageView.get(),
-				assetManager.get(),
-				writePath,
-				asset::IImage::EL_PRESENT_SRC,
-				asset::EAF_NONE);
+				asset::EAF_NONE,
+				asset::IImage::EL_PRESENT_SRC);
+			return writeScreenShotPNG(assetManager.get(),std::move(cpuImageView),writePath);
 		};
 
 		for (size_t i = 0; i < gpuImageViews->size(); ++i)
@@ -721,6 +968,22 @@ public:
 	}
 };
 
+#ifdef _NBL_PLATFORM_ANDROID_
 NBL_COMMON_API_MAIN(ColorSpaceTestSampleApp)
+#else
+int main(int argc, char** argv) {
+	// CPU only benchmark, no window or device gets created
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::string_view(argv[i]) != "-benchmark_loaders")
+			continue;
+
+		auto logger = core::make_smart_refctd_ptr<system::CStdoutLogger>(core::bitflag(system::ILogger::ELL_INFO) | system::ILogger::ELL_PERFORMANCE | system::ILogger::ELL_ERROR);
+		CImageLoaderBenchmark(logger.get()).run();
+		return 0;
+	}
+	CommonAPI::main<ColorSpaceTestSampleApp>(argc, argv);
+}
+#endif
 
 extern "C" {  _declspec(dllexport) DWORD NvOptimusEnablement = 0x00000001; }
\ No newline at end of file
@@ -0,0 +1,124 @@
+// Copyright (C) 2018-2023 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+#ifndef _IMPORTANCE_SAMPLING_ENVMAPS_HIERARCHICAL_SAMPLING_TABLE_H_INCLUDED_
+#define _IMPORTANCE_SAMPLING_ENVMAPS_HIERARCHICAL_SAMPLING_TABLE_H_INCLUDED_
+
+#include "nabla.h"
+
+#include <numeric>
+
+
+// Marginal/conditional sampling of a piecewise constant 2D PDF, where every row and the marginal are complete binary trees of
+// "probability of going left" in 32bit fixed point, laid out breadth first so the top levels of every descent are shared and stay in cache.
+// Descending with the random number rescaled at every node is the same warp as inverting the CDF and interpolating within the bin,
+// but the table is about half the size of a double CDF and every row builds independently.
+class CHierarchicalSamplingTable2D
+{
+	public:
+		// `pdf` is row-major and doesn't need to be normalized, `rowIntegrals` are the sums of its rows which whoever made the PDF already has
+		CHierarchicalSamplingTable2D(const double* pdf, nbl::core::vector<double>&& rowIntegrals, const uint32_t width, const uint32_t height)
+			: m_width(width), m_height(height), m_rowLeaves(roundUpToPoT(width)), m_marginalLeaves(roundUpToPoT(height)), m_rowIntegrals(std::move(rowIntegrals))
+		{
+			assert(m_rowIntegrals.size() == height);
+			m_rowNodes.resize(size_t(height) * (m_rowLeaves - 1u));
+
+			nbl::core::vector<uint32_t> rows(height);
+			std::iota(rows.begin(), rows.end(), 0u);
+			std::for_each(nbl::core::execution::par, rows.begin(), rows.end(), [&](const uint32_t y) -> void
+				{
+					buildTree(pdf + size_t(y) * width, width, m_rowLeaves, m_rowNodes.data() + size_t(y) * (m_rowLeaves - 1u));
+				}
+			);
+
+			m_marginalNodes.resize(m_marginalLeaves - 1u);
+			m_integral = buildTree(m_rowIntegrals.data(), height, m_marginalLeaves, m_marginalNodes.data());
+		}
+
+		inline double getIntegral() const { return m_integral; }
+		inline double getRowIntegral(const uint32_t row) const { return m_rowIntegrals[row]; }
+
+		// returns the row and writes the warped `xi` in [0,1) to `xiRemapped`, like `bisectionSearch` over the normalized marginal CDF would
+		inline uint32_t sampleRow(const double xi, double& xiRemapped) const
+		{
+			return descend(m_marginalNodes.data(), m_marginalLeaves, m_height, xi, xiRemapped);
+		}
+		inline uint32_t sampleColumn(const uint32_t row, const double xi, double& xiRemapped) const
+		{
+			return descend(m_rowNodes.data() + size_t(row) * (m_rowLeaves - 1u), m_rowLeaves, m_width, xi, xiRemapped);
+		}
+
+		inline size_t getByteSize() const
+		{
+			return (m_rowNodes.size() + m_marginalNodes.size()) * sizeof(uint32_t) + m_rowIntegrals.size() * sizeof(double);
+		}
+
+	private:
+		static inline constexpr double FixedPointOne = double(0x1ull << 32ull);
+		// can't be a rounded ratio, the right child has no weight so the random number passes through unchanged
+		static inline constexpr uint32_t OnlyLeft = 0xffffffffu;
+
+		static inline uint32_t roundUpToPoT(const uint32_t value)
+		{
+			uint32_t retval = 1u;
+			while (retval < value)
+				retval <<= 1u;
+			return retval;
+		}
+
+		// node `i` (1 based) has children `2i` and `2i+1`, leaves past `count` have no weight, returns the sum of all weights
+		static inline double buildTree(const double* weights, const uint32_t count, const uint32_t leafCount, uint32_t* outNodes)
+		{
+			nbl::core::vector<double> sums(leafCount * 2u, 0.0);
+			std::copy(weights, weights + count, sums.begin() + leafCount);
+			for (uint32_t node = leafCount - 1u; node > 0u; node--)
+			{
+				const double left = sums[node * 2u];
+				const double right = sums[node * 2u + 1u];
+				sums[node] = left + right;
+
+				uint32_t ratio;
+				if (right <= 0.0)
+					ratio = OnlyLeft;
+				else if (left <= 0.0)
+					ratio = 0u;
+				// rounding must not take away the only way into a child with some weight
+				else
+					ratio = static_cast<uint32_t>(nbl::core::clamp(left / sums[node] * FixedPointOne, 1.0, double(OnlyLeft - 1u)));
+				outNodes[node - 1u] = ratio;
+			}
+			return sums[1];
+		}
+
+		static inline uint32_t descend(const uint32_t* nodes, const uint32_t leafCount, const uint32_t count, double xi, double& xiRemapped)
+		{
+			uint32_t node = 1u;
+			while (node < leafCount)
+			{
+				const uint32_t fixedRatio = nodes[node - 1u];
+				node <<= 1u;
+				if (fixedRatio == OnlyLeft)
+					continue;
+				const double ratio = double(fixedRatio) / FixedPointOne;
+				if (xi < ratio)
+					xi /= ratio;
+				else
+				{
+					xi = (xi - ratio) / (1.0 - ratio);
+					node |= 1u;
+				}
+			}
+			const uint32_t leaf = nbl::core::min(node - leafCount, count - 1u);
+			xiRemapped = (leaf + nbl::core::min(xi, 1.0)) / count;
+			return leaf;
+		}
+
+		uint32_t m_width, m_height;
+		uint32_t m_rowLeaves, m_marginalLeaves;
+		nbl::core::vector<uint32_t> m_rowNodes;
+		nbl::core::vector<uint32_t> m_marginalNodes;
+		nbl::core::vector<double> m_rowIntegrals;
+		double m_integral;
+};
+
+#endif
@@ -8,6 +8,12 @@
 #include "nbl/ext/ScreenShot/ScreenShot.h"
 #include "../common/Camera.hpp"
 #include "../common/CommonAPI.h"
+#include "HierarchicalSamplingTable.h"
+#include "nbl/system/CStdoutLogger.h"
+
+#include <chrono>
+#include <numeric>
+#include <random>
 
 using namespace nbl;
 using namespace asset;
@@ -15,9 +21,8 @@ using namespace core;
 using namespace video;
 using namespace ui;
 
-using SATFilter = CSummedAreaTableImageFilter<false>;
-
-static core::smart_refctd_ptr<ICPUBuffer> computeLuminancePdf(smart_refctd_ptr<ICPUImage> envmap, float* normalizationFactor)
+// Scalar reference, one thread walks every texel
+static core::smart_refctd_ptr<ICPUBuffer> computeLuminancePdfReference(smart_refctd_ptr<ICPUImage> envmap, float* normalizationFactor)
 {
 	const core::vector2d<uint32_t> envmapExtent = { envmap->getCreationParameters().extent.width, envmap->getCreationParameters().extent.height };
 	const uint32_t channelCount = getFormatChannelCount(envmap->getCreationParameters().format);
@@ -56,6 +61,93 @@ static core::smart_refctd_ptr<ICPUBuffer> computeLuminancePdf(smart_refctd_ptr<I
 	return outBuffer;
 }
 
+// Writes `luminance*sin(theta)` of the rows in [firstRow,lastRow) and every row's sum, the texel loop has no dependencies between iterations
+// and a compile time channel count so it vectorizes, while the row sum uses independent accumulators.
+template<uint32_t ChannelCount>
+static void computeLuminancePdfRows(const float* envmap, const core::vector2d<uint32_t>& extent, const uint32_t firstRow, const uint32_t lastRow, double* outPdf, double* outRowIntegrals)
+{
+	// alpha doesn't contribute
+	constexpr uint32_t LuminanceChannels = ChannelCount < 3u ? ChannelCount : 3u;
+	constexpr double LuminanceScales[3] = { 0.2126729 , 0.7151522, 0.0721750 };
+
+	for (uint32_t y = firstRow; y < lastRow; ++y)
+	{
+		const double sinTheta = core::sin(core::PI<double>() * ((y + 0.5) / (double)extent.Y));
+		const float* inRow = envmap + size_t(y) * extent.X * ChannelCount;
+		double* outRow = outPdf + size_t(y) * extent.X;
+
+		for (uint32_t x = 0; x < extent.X; ++x)
+		{
+			double result = 0.0;
+			for (uint32_t ch = 0; ch < LuminanceChannels; ++ch)
+				result += LuminanceScales[ch] * inRow[x * ChannelCount + ch];
+			outRow[x] = result * sinTheta;
+		}
+
+		double partialSums[4] = { 0.0, 0.0, 0.0, 0.0 };
+		uint32_t x = 0;
+		for (; x + 4u <= extent.X; x += 4u)
+		for (uint32_t i = 0; i < 4u; ++i)
+			partialSums[i] += outRow[x + i];
+		for (; x < extent.X; ++x)
+			partialSums[0] += outRow[x];
+		outRowIntegrals[y] = (partialSums[0] + partialSums[1]) + (partialSums[2] + partialSums[3]);
+	}
+}
+
+// Same PDF as `computeLuminancePdfReference`, bands of rows get processed in parallel and the per-row integrals come out of the same pass.
+// The normalization factor is summed from the row integrals in order, so it doesn't depend on the scheduling. The row integrals get moved into
+// `outRowIntegrals` if requested, `CHierarchicalSamplingTable2D` takes them instead of summing the rows again.
+static core::smart_refctd_ptr<ICPUBuffer> computeLuminancePdf(smart_refctd_ptr<ICPUImage> envmap, float* normalizationFactor, core::vector<double>* outRowIntegrals = nullptr)
+{
+	const core::vector2d<uint32_t> envmapExtent = { envmap->getCreationParameters().extent.width, envmap->getCreationParameters().extent.height };
+	const uint32_t channelCount = getFormatChannelCount(envmap->getCreationParameters().format);
+
+	const core::vector2d<uint32_t> pdfDomainExtent = { envmapExtent.X, envmapExtent.Y };
+
+	core::smart_refctd_ptr<ICPUBuffer> outBuffer = core::make_smart_refctd_ptr<ICPUBuffer>(size_t(pdfDomainExtent.X) * pdfDomainExtent.Y * sizeof(double));
+	core::vector<double> rowIntegrals(pdfDomainExtent.Y);
+
+	const float* envmapPixel = (const float*)envmap->getBuffer()->getPointer();
+	double* outPixel = (double*)outBuffer->getPointer();
+	double* rowIntegralsPixel = rowIntegrals.data();
+
+	// a band of a 16K wide envmap is 2MB of input, enough work per task while still balancing well
+	constexpr uint32_t RowsPerBand = 16u;
+	core::vector<uint32_t> bands((pdfDomainExtent.Y + RowsPerBand - 1u) / RowsPerBand);
+	std::iota(bands.begin(), bands.end(), 0u);
+	std::for_each(core::execution::par, bands.begin(), bands.end(), [&](const uint32_t band) -> void
+		{
+			const uint32_t firstRow = band * RowsPerBand;
+			const uint32_t lastRow = core::min(firstRow + RowsPerBand, pdfDomainExtent.Y);
+			switch (channelCount)
+			{
+				case 1u:
+					computeLuminancePdfRows<1u>(envmapPixel, pdfDomainExtent, firstRow, lastRow, outPixel, rowIntegralsPixel);
+					break;
+				case 2u:
+					computeLuminancePdfRows<2u>(envmapPixel, pdfDomainExtent, firstRow, lastRow, outPixel, rowIntegralsPixel);
+					break;
+				case 3u:
+					computeLuminancePdfRows<3u>(envmapPixel, pdfDomainExtent, firstRow, lastRow, outPixel, rowIntegralsPixel);
+					break;
+				default:
+					computeLuminancePdfRows<4u>(envmapPixel, pdfDomainExtent, firstRow, lastRow, outPixel, rowIntegralsPixel);
+					break;
+			}
+		}
+	);
+
+	if (normalizationFactor)
+	{
+		const double pdfSum = std::accumulate(rowIntegralsPixel, rowIntegralsPixel + pdfDomainExtent.Y, 0.0);
+		*normalizationFactor = (pdfDomainExtent.X * pdfDomainExtent.Y)/(pdfSum*2.0*core::PI<double>()*core::PI<double>());
+	}
+	if (outRowIntegrals)
+		*outRowIntegrals = std::move(rowIntegrals);
+	return outBuffer;
+}
+
 // Returns the offset into the passed array the element at which is <= the passed element (`x`)
 // returns offset = -1 if passed element is < the element at index 0
 static int32_t bisectionSearch(const double* arr, const uint32_t arrCount, const double x, double* xFound)
@@ -74,6 +166,203 @@ static int32_t bisectionSearch(const double* arr, const uint32_t arrCount, const
 	return offset;
 }
 
+// Synthetic RGBA32F envmap, so the CPU benchmarks and validation don't depend on any HDRI being present
+static core::smart_refctd_ptr<ICPUImage> createSyntheticEnvmap(const core::vector2d<uint32_t> extent)
+{
+	IImage::SCreationParams params;
+	params.flags = static_cast<asset::IImage::E_CREATE_FLAGS>(0u);
+	params.type = IImage::ET_2D;
+	params.format = asset::EF_R32G32B32A32_SFLOAT;
+	params.extent = { extent.X, extent.Y, 1u };
+	params.mipLevels = 1u;
+	params.arrayLayers = 1u;
+	params.samples = asset::ICPUImage::ESCF_1_BIT;
+
+	auto regions = core::make_refctd_dynamic_array<core::smart_refctd_dynamic_array<ICPUImage::SBufferCopy>>(1ull);
+	regions->begin()->bufferOffset = 0ull;
+	regions->begin()->bufferRowLength = extent.X;
+	regions->begin()->bufferImageHeight = 0u;
+	regions->begin()->imageSubresource = {};
+	regions->begin()->imageSubresource.layerCount = 1u;
+	regions->begin()->imageOffset = { 0, 0, 0 };
+	regions->begin()->imageExtent = { extent.X, extent.Y, 1u };
+
+	// a sky gradient with some high frequency detail and a sun, like a real HDRI the dynamic range is huge
+	auto texels = core::make_smart_refctd_ptr<ICPUBuffer>(size_t(extent.X) * extent.Y * 4u * sizeof(float));
+	{
+		float* out = (float*)texels->getPointer();
+		core::vector<uint32_t> rows(extent.Y);
+		std::iota(rows.begin(), rows.end(), 0u);
+		std::for_each(core::execution::par_unseq, rows.begin(), rows.end(), [&](const uint32_t y) -> void
+			{
+				const float v = (y + 0.5f) / extent.Y;
+				for (uint32_t x = 0; x < extent.X; ++x)
+				{
+					const float u = (x + 0.5f) / extent.X;
+					const float detail = 0.5f + 0.5f * std::sin(u * 400.f) * std::cos(v * 300.f);
+					const float sunDistance = (u - 0.3f) * (u - 0.3f) + (v - 0.25f) * (v - 0.25f);
+					const float sun = sunDistance < 0.0001f ? 50000.f : 0.f;
+					float* texel = out + (size_t(y) * extent.X + x) * 4u;
+					texel[0] = (1.f - v) * 0.6f + detail * 0.1f + sun;
+					texel[1] = (1.f - v) * 0.8f + detail * 0.1f + sun;
+					texel[2] = 1.2f - v + detail * 0.05f + sun;
+					texel[3] = 1.f;
+				}
+			}
+		);
+	}
+	auto envmap = ICPUImage::create(std::move(params));
+	envmap->setBufferAndRegions(std::move(texels), regions);
+	return envmap;
+}
+
+// Times `computeLuminancePdf` against the scalar reference on synthetic RGBA32F envmaps up to the size of our HDRI library, no window or device gets created
+static void benchmarkLuminancePdf(system::ILogger* logger)
+{
+	const core::vector2d<uint32_t> Extents[] = { { 2048u, 1024u }, { 8192u, 4096u }, { 16384u, 8192u } };
+
+	for (const auto& extent : Extents)
+	{
+		auto envmap = createSyntheticEnvmap(extent);
+
+		float referenceNormalization = 0.f, normalization = 0.f;
+		auto start = std::chrono::steady_clock::now();
+		auto referencePdf = computeLuminancePdfReference(envmap, &referenceNormalization);
+		const double referenceSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		start = std::chrono::steady_clock::now();
+		auto pdf = computeLuminancePdf(envmap, &normalization);
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		// only the summation order differs, and FMA contraction might differ between the loops
+		const double* referencePixel = (const double*)referencePdf->getPointer();
+		const double* pdfPixel = (const double*)pdf->getPointer();
+		double maxRelativeError = 0.0;
+		for (size_t i = 0u; i < size_t(extent.X) * extent.Y; ++i)
+			if (referencePixel[i] != pdfPixel[i])
+				maxRelativeError = core::max(maxRelativeError, std::abs(pdfPixel[i] - referencePixel[i]) / std::abs(referencePixel[i]));
+		const double normalizationError = std::abs(double(normalization) - double(referenceNormalization)) / double(referenceNormalization);
+		if (maxRelativeError > 1e-12 || normalizationError > 1e-6)
+			logger->log("Luminance PDF of %ux%u differs from the reference, max relative error %e, normalization factor error %e", system::ILogger::ELL_ERROR, extent.X, extent.Y, maxRelativeError, normalizationError);
+
+		const double megaTexels = double(extent.X) * double(extent.Y) * 1e-6;
+		logger->log("Luminance PDF %ux%u: reference %.2f ms (%.1f MTexel/s), parallel %.2f ms (%.1f MTexel/s) on %u hardware threads, %.2fx", system::ILogger::ELL_PERFORMANCE,
+			extent.X, extent.Y, referenceSeconds * 1000.0, megaTexels / referenceSeconds, seconds * 1000.0, megaTexels / seconds, std::thread::hardware_concurrency(), referenceSeconds / seconds);
+	}
+}
+
+// Checks `CHierarchicalSamplingTable2D` against bisection over the marginal and conditional CDFs it replaced,
+// then checks that the texels it picks are distributed like the luminance PDF with a chi-square test, returns false if either check fails
+static bool validateSamplingTable(system::ILogger* logger)
+{
+	const core::vector2d<uint32_t> extent = { 512u, 256u };
+	const size_t texelCount = size_t(extent.X) * extent.Y;
+	constexpr uint32_t SampleCount = 0x1u << 22u;
+
+	auto envmap = createSyntheticEnvmap(extent);
+	float normalization = 0.f;
+	core::vector<double> rowIntegrals;
+	auto pdf = computeLuminancePdf(envmap, &normalization, &rowIntegrals);
+	const double* pdfPixel = (const double*)pdf->getPointer();
+
+	auto start = std::chrono::steady_clock::now();
+	const CHierarchicalSamplingTable2D samplingTable(pdfPixel, std::move(rowIntegrals), extent.X, extent.Y);
+	const double buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	// normalized inclusive prefix sums like the SAT filter used to make, the last value is forced to 1 so `bisectionSearch` never runs off the end
+	core::vector<double> conditionalCdf(texelCount), marginalCdf(extent.Y);
+	for (uint32_t y = 0; y < extent.Y; ++y)
+	{
+		double* row = conditionalCdf.data() + size_t(y) * extent.X;
+		std::partial_sum(pdfPixel + size_t(y) * extent.X, pdfPixel + size_t(y + 1u) * extent.X, row);
+		marginalCdf[y] = row[extent.X - 1u];
+		for (uint32_t x = 0; x < extent.X; ++x)
+			row[x] /= marginalCdf[y];
+		row[extent.X - 1u] = 1.0;
+	}
+	std::partial_sum(marginalCdf.begin(), marginalCdf.end(), marginalCdf.begin());
+	for (auto& value : marginalCdf)
+		value /= marginalCdf.back();
+	marginalCdf.back() = 1.0;
+
+	core::vector<core::vector2d<double>> xis(SampleCount);
+	{
+		std::mt19937 rng(0x45u);
+		std::uniform_real_distribution<double> dist(0.0, 1.0);
+		for (auto& xi : xis)
+		{
+			xi.X = dist(rng);
+			xi.Y = dist(rng);
+		}
+	}
+
+	core::vector<uint32_t> texels(SampleCount);
+	core::vector<core::vector2d<double>> warped(SampleCount);
+	start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < SampleCount; ++i)
+	{
+		const uint32_t row = samplingTable.sampleRow(xis[i].Y, warped[i].Y);
+		texels[i] = row * extent.X + samplingTable.sampleColumn(row, xis[i].X, warped[i].X);
+	}
+	const double tableSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	core::vector<core::vector2d<double>> referenceWarped(SampleCount);
+	core::vector<uint32_t> referenceTexels(SampleCount);
+	start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < SampleCount; ++i)
+	{
+		const uint32_t row = bisectionSearch(marginalCdf.data(), extent.Y, xis[i].Y, &referenceWarped[i].Y) + 1;
+		referenceTexels[i] = row * extent.X + bisectionSearch(conditionalCdf.data() + size_t(row) * extent.X, extent.X, xis[i].X, &referenceWarped[i].X) + 1;
+	}
+	const double referenceSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	// the ratios are quantized to 32bit so samples right on a bin edge can land in the neighbouring texel, but the warp itself must stay continuous
+	double maxWarpError = 0.0;
+	uint32_t differentTexels = 0u;
+	for (uint32_t i = 0; i < SampleCount; ++i)
+	{
+		maxWarpError = core::max(maxWarpError, std::abs(warped[i].Y - referenceWarped[i].Y));
+		// the column warps are only comparable within the same row
+		if (texels[i] / extent.X == referenceTexels[i] / extent.X)
+			maxWarpError = core::max(maxWarpError, std::abs(warped[i].X - referenceWarped[i].X));
+		if (texels[i] != referenceTexels[i])
+			differentTexels++;
+	}
+	const bool warpMatches = maxWarpError <= 1.0 / double(core::max(extent.X, extent.Y));
+	if (!warpMatches)
+		logger->log("Hierarchical sampling table warp differs from bisection by up to %e", system::ILogger::ELL_ERROR, maxWarpError);
+
+	// Pearson's chi-square against the PDF, neighbouring texels get pooled until they expect at least 5 samples
+	core::vector<uint32_t> histogram(texelCount, 0u);
+	for (const uint32_t texel : texels)
+		histogram[texel]++;
+	double chiSquare = 0.0;
+	uint32_t bins = 0u;
+	{
+		double expected = 0.0, observed = 0.0;
+		for (size_t i = 0u; i < texelCount; ++i)
+		{
+			expected += pdfPixel[i] / samplingTable.getIntegral() * double(SampleCount);
+			observed += double(histogram[i]);
+			if (expected < 5.0 && i + 1u != texelCount)
+				continue;
+			chiSquare += (observed - expected) * (observed - expected) / expected;
+			bins++;
+			expected = observed = 0.0;
+		}
+	}
+	const double degreesOfFreedom = double(bins - 1u);
+	const double sigmas = (chiSquare - degreesOfFreedom) / std::sqrt(2.0 * degreesOfFreedom);
+	const bool followsPdf = sigmas <= 5.0;
+	if (!followsPdf)
+		logger->log("Hierarchical sampling table samples don't follow the PDF, chi-square %f with %u bins is %.1f sigma off", system::ILogger::ELL_ERROR, chiSquare, bins, sigmas);
+
+	logger->log("Sampling table %ux%u: built in %.2f ms (%zu bytes vs %zu for the CDFs), %.1f MSamples/s vs %.1f MSamples/s with bisection, max warp difference %e, %u of %u samples in another texel, chi-square %.1f sigma",
+		system::ILogger::ELL_PERFORMANCE, extent.X, extent.Y, buildSeconds * 1000.0, samplingTable.getByteSize(), (texelCount + extent.Y) * sizeof(double),
+		double(SampleCount) * 1e-6 / tableSeconds, double(SampleCount) * 1e-6 / referenceSeconds, maxWarpError, differentTexels, SampleCount, sigmas);
+	return warpMatches && followsPdf;
+}
+
 class ImportanceSamplingEnvMaps : public ApplicationBase
 {
 	static constexpr uint32_t WIN_W = 2048;
@@ -323,7 +612,8 @@ public:
 			auto envmapImage = core::smart_refctd_ptr_static_cast<asset::ICPUImage>(*envmapImageBundle.getContents().begin());
 			const uint32_t channelCount = getFormatChannelCount(envmapImage->getCreationParameters().format);
 
-			auto luminancePdfBuffer = computeLuminancePdf(envmapImage, &envmapNormalizationFactor);
+			core::vector<double> luminanceRowIntegrals;
+			auto luminancePdfBuffer = computeLuminancePdf(envmapImage, &envmapNormalizationFactor, &luminanceRowIntegrals);
 
 			ICPUImageView::SCreationParams viewParams;
 			viewParams.flags = static_cast<ICPUImageView::E_CREATE_FLAGS>(0u);
@@ -342,207 +632,52 @@ public:
 
 			const core::vector2d<uint32_t> pdfDomainExtent = { envmapImage->getCreationParameters().extent.width, envmapImage->getCreationParameters().extent.height };
 
-			core::smart_refctd_ptr<ICPUImage> conditionalCdfImage = nullptr;
-			core::smart_refctd_ptr<ICPUBuffer> conditionalIntegrals = nullptr;
-			{
-				// Create ICPUImage from the buffer for the input image to the SAT filter
-				auto luminanceImageParams = envmapImage->getCreationParameters();
-				luminanceImageParams.format = EF_R64_SFLOAT;
-				luminanceImageParams.extent = { pdfDomainExtent.X, pdfDomainExtent.Y, 1 };
-
-				auto luminanceImageRegions = core::make_refctd_dynamic_array<core::smart_refctd_dynamic_array<ICPUImage::SBufferCopy>>(1ull);
-				luminanceImageRegions->begin()->bufferOffset = 0ull;
-				luminanceImageRegions->begin()->bufferRowLength = luminanceImageParams.extent.width;
-				luminanceImageRegions->begin()->bufferImageHeight = 0u;
-				luminanceImageRegions->begin()->imageSubresource = {};
-				luminanceImageRegions->begin()->imageSubresource.layerCount = 1u;
-				luminanceImageRegions->begin()->imageOffset = { 0, 0, 0 };
-				luminanceImageRegions->begin()->imageExtent = { luminanceImageParams.extent.width, luminanceImageParams.extent.height, 1 };
-
-				core::smart_refctd_ptr<ICPUImage> luminanceImage = ICPUImage::create(std::move(luminanceImageParams));
-				luminanceImage->setBufferAndRegions(core::smart_refctd_ptr(luminancePdfBuffer), luminanceImageRegions);
-
-				// Create out image
-				const size_t conditionalCdfBufferSize = pdfDomainExtent.X * pdfDomainExtent.Y * sizeof(double);
-				core::smart_refctd_ptr<ICPUBuffer> conditionalCdfBuffer = core::make_smart_refctd_ptr<ICPUBuffer>(conditionalCdfBufferSize);
-				memset(conditionalCdfBuffer->getPointer(), 0, conditionalCdfBufferSize);
-
-				auto conditionalCdfImageParams = luminanceImage->getCreationParameters();
-				conditionalCdfImageParams.format = EF_R64_SFLOAT;
-
-				auto conditionalCdfImageRegions(luminanceImageRegions);
-				conditionalCdfImage = ICPUImage::create(std::move(conditionalCdfImageParams));
-				conditionalCdfImage->setBufferAndRegions(std::move(conditionalCdfBuffer), conditionalCdfImageRegions);
-
-				// Set up the filter state
-				SATFilter sum_filter;
-				SATFilter::state_type state;
-
-				state.inImage = luminanceImage.get();
-				state.outImage = conditionalCdfImage.get();
-				state.inOffset = { 0, 0, 0 };
-				state.inBaseLayer = 0;
-				state.outOffset = { 0, 0, 0 };
-				state.outBaseLayer = 0;
-				state.extent = luminanceImage->getCreationParameters().extent;
-				state.layerCount = luminanceImage->getCreationParameters().arrayLayers;
-				state.scratchMemoryByteSize = state.getRequiredScratchByteSize(state.inImage, state.extent);
-				state.scratchMemory = reinterpret_cast<uint8_t*>(_NBL_ALIGNED_MALLOC(state.scratchMemoryByteSize, 32));
-				state.axesToSum = ((0) << 2) | ((0) << 1) | ((1) << 0); // ZYX
-				state.inMipLevel = 0;
-				state.outMipLevel = 0;
-
-				if (!sum_filter.execute(core::execution::par_unseq, &state))
-					std::cout << "SAT filter failed for some reason" << std::endl;
-
-				_NBL_ALIGNED_FREE(state.scratchMemory);
-
-				// From the outImage you gotta extract integrals and normalize
-				double* conditionalCdfPixel = (double*)conditionalCdfImage->getBuffer()->getPointer();
-
-				conditionalIntegrals = core::make_smart_refctd_ptr<ICPUBuffer>(pdfDomainExtent.Y * sizeof(double));
-				double* conditionalIntegralsPixel = (double*)conditionalIntegrals->getPointer();
-				for (uint32_t y = 0; y < pdfDomainExtent.Y; ++y)
-				{
-					// printf("\n Conditional Integral[%d] = %f", y, conditionalCdfPixel[y * pdfDomainExtent.X + (pdfDomainExtent.X - 1)]);
-					*conditionalIntegralsPixel++ = conditionalCdfPixel[y * pdfDomainExtent.X + (pdfDomainExtent.X - 1)];
-				}
-
-				conditionalCdfPixel = (double*)conditionalCdfImage->getBuffer()->getPointer();
-				conditionalIntegralsPixel = (double*)conditionalIntegrals->getPointer();
-
-				// now normalize
-				for (uint32_t y = 0; y < pdfDomainExtent.Y; ++y)
-				{
-					for (uint32_t x = 0; x < pdfDomainExtent.X; ++x)
-					{
-						conditionalCdfPixel[y * pdfDomainExtent.X + x] /= conditionalIntegralsPixel[y];
-					}
-				}
-			}
-
-			core::smart_refctd_ptr<ICPUImage> marginalCdfImage = nullptr;
-			double marginalIntegral = 0.0;
-			{
-				// Input: conditionalIntegrals
-				// Create ICPUImage from the buffer for the input image to the SAT filter
-				IImage::SCreationParams inParams;
-				inParams.flags = static_cast<asset::IImage::E_CREATE_FLAGS>(0u);
-				inParams.type = IImage::ET_1D;
-				inParams.format = asset::EF_R64_SFLOAT;
-				inParams.extent = { pdfDomainExtent.Y, 1, 1 };
-				inParams.mipLevels = 1u;
-				inParams.arrayLayers = 1u;
-				inParams.samples = asset::ICPUImage::ESCF_1_BIT;
-
-				auto inImageRegions = core::make_refctd_dynamic_array<core::smart_refctd_dynamic_array<ICPUImage::SBufferCopy>>(1ull);
-				inImageRegions->begin()->bufferOffset = 0ull;
-				inImageRegions->begin()->bufferRowLength = inParams.extent.width;
-				inImageRegions->begin()->bufferImageHeight = 0u;
-				inImageRegions->begin()->imageSubresource = {};
-				inImageRegions->begin()->imageSubresource.layerCount = 1u;
-				inImageRegions->begin()->imageOffset = { 0, 0, 0 };
-				inImageRegions->begin()->imageExtent = { inParams.extent.width, inParams.extent.height, inParams.extent.depth };
-
-				core::smart_refctd_ptr<ICPUImage> inImage = ICPUImage::create(std::move(inParams));
-				inImage->setBufferAndRegions(core::smart_refctd_ptr(conditionalIntegrals), inImageRegions);
-
-				// Ouput: 1d cdf of conditionalIntegrals
-				// Create out image
-				core::smart_refctd_ptr<ICPUBuffer> marginalCdfBuffer = core::make_smart_refctd_ptr<ICPUBuffer>(conditionalIntegrals->getSize());
-				memset(marginalCdfBuffer->getPointer(), 0, marginalCdfBuffer->getSize());
-
-				auto marginalCdfImageParams = inImage->getCreationParameters();
-				marginalCdfImageParams.format = EF_R64_SFLOAT;
-
-				auto marginalCdfImageRegions(inImageRegions);
-				marginalCdfImage = ICPUImage::create(std::move(marginalCdfImageParams));
-				marginalCdfImage->setBufferAndRegions(std::move(marginalCdfBuffer), marginalCdfImageRegions);
-
-				// Set up the filter state
-				SATFilter sum_filter;
-				SATFilter::state_type state;
-
-				state.inImage = inImage.get();
-				state.outImage = marginalCdfImage.get();
-				state.inOffset = { 0, 0, 0 };
-				state.inBaseLayer = 0;
-				state.outOffset = { 0, 0, 0 };
-				state.outBaseLayer = 0;
-				state.extent = inImage->getCreationParameters().extent;
-				state.layerCount = inImage->getCreationParameters().arrayLayers;
-				state.scratchMemoryByteSize = state.getRequiredScratchByteSize(state.inImage, state.extent);
-				state.scratchMemory = reinterpret_cast<uint8_t*>(_NBL_ALIGNED_MALLOC(state.scratchMemoryByteSize, 32));
-				state.axesToSum = ((0) << 2) | ((0) << 1) | ((1) << 0); // ZYX
-				state.inMipLevel = 0;
-				state.outMipLevel = 0;
-
-				if (!sum_filter.execute(core::execution::par_unseq, &state))
-					std::cout << "SAT filter failed for some reason" << std::endl;
-
-				_NBL_ALIGNED_FREE(state.scratchMemory);
-
-				// From the outImage you gotta extract integral and normalize
-				double* marginalCdfPixel = (double*)marginalCdfImage->getBuffer()->getPointer();
-
-				marginalIntegral = marginalCdfPixel[pdfDomainExtent.Y - 1];
-
-				// now normalize
-				for (uint32_t y = 0; y < pdfDomainExtent.Y; ++y)
-				{
-					// printf("\n MarginalCDFPixel[%d] = %f", y, marginalCdfPixel[y]);
-					marginalCdfPixel[y] /= marginalIntegral;
-				}
-			}
-
-			for (uint32_t i = 1; i < (marginalCdfImage->getBuffer()->getSize() / sizeof(double)); ++i)
-				assert(((double*)marginalCdfImage->getBuffer()->getPointer())[i] > ((double*)marginalCdfImage->getBuffer()->getPointer())[i - 1]);
+			// replaces the conditional and marginal CDF images, every row of the table builds in parallel
+			const double* luminancePdfPixel = (const double*)luminancePdfBuffer->getPointer();
+			const CHierarchicalSamplingTable2D samplingTable(luminancePdfPixel, std::move(luminanceRowIntegrals), pdfDomainExtent.X, pdfDomainExtent.Y);
 
 			// Computing LUTs
 
 			const uint32_t phiPdfLUTChannelCount = 2u; // phi and pdf
 			const size_t phiPdfLUTBufferSize = pdfDomainExtent.X * pdfDomainExtent.Y * phiPdfLUTChannelCount * sizeof(float);
 			core::smart_refctd_ptr<ICPUBuffer> phiPdfLUTBuffer = core::make_smart_refctd_ptr<ICPUBuffer>(phiPdfLUTBufferSize);
-			memset(phiPdfLUTBuffer->getPointer(), 0, phiPdfLUTBufferSize);
 
 			const uint32_t thetaLUTChannelCount = 1u; // theta
 			const size_t thetaLUTBufferSize = pdfDomainExtent.Y * thetaLUTChannelCount * sizeof(float);
 			core::smart_refctd_ptr<ICPUBuffer> thetaLUTBuffer = core::make_smart_refctd_ptr<ICPUBuffer>(thetaLUTBufferSize);
-			memset(thetaLUTBuffer->getPointer(), 0, thetaLUTBufferSize);
 
 			float* phiPdfLUTPixel = (float*)phiPdfLUTBuffer->getPointer();
 			float* thetaLUTPixel = (float*)thetaLUTBuffer->getPointer();
 
-			core::vector2d<double> xi(0.0, 0.0);
-			core::vector2d<double> xiRemapped = { 0.0, 0.0 };
-			for (uint32_t y = 0; y < pdfDomainExtent.Y; ++y)
-			{
-				xi.Y = (y + 0.5) / (double)pdfDomainExtent.Y;
+			core::vector<uint32_t> lutRows(pdfDomainExtent.Y);
+			std::iota(lutRows.begin(), lutRows.end(), 0u);
+			std::for_each(core::execution::par, lutRows.begin(), lutRows.end(), [&](const uint32_t y) -> void
+				{
+					core::vector2d<double> xi(0.0, (y + 0.5) / (double)pdfDomainExtent.Y);
+					core::vector2d<double> xiRemapped = { 0.0, 0.0 };
 
-				int32_t yoffset = bisectionSearch((double*)marginalCdfImage->getBuffer()->getPointer(), pdfDomainExtent.Y, xi.Y, &xiRemapped.Y);
-				const uint32_t rowToSample = (uint32_t)(yoffset + 1);
-				assert(rowToSample < pdfDomainExtent.Y);
-				double marginalPdf = ((double*)conditionalIntegrals->getPointer())[rowToSample] / marginalIntegral;
+					const uint32_t rowToSample = samplingTable.sampleRow(xi.Y, xiRemapped.Y);
 
-				const double theta = xiRemapped.Y * core::PI<double>();
-				*thetaLUTPixel++ = (float)theta;
+					const double theta = xiRemapped.Y * core::PI<double>();
+					thetaLUTPixel[y] = (float)theta;
 
-				for (uint32_t x = 0; x < pdfDomainExtent.X; ++x)
-				{
-					xi.X = (x + 0.5) / (double)pdfDomainExtent.X;
+					float* phiPdfLUTRow = phiPdfLUTPixel + size_t(y) * pdfDomainExtent.X * phiPdfLUTChannelCount;
+					for (uint32_t x = 0; x < pdfDomainExtent.X; ++x)
+					{
+						xi.X = (x + 0.5) / (double)pdfDomainExtent.X;
 
-					const int32_t xoffset = bisectionSearch((double*)conditionalCdfImage->getBuffer()->getPointer() + rowToSample * pdfDomainExtent.X, pdfDomainExtent.X, xi.X, &xiRemapped.X);
-					const uint32_t colToSample = (uint32_t)(xoffset + 1);
-					assert(colToSample < pdfDomainExtent.X);
-					const double conditionalPdf = ((double*)luminancePdfBuffer->getPointer())[rowToSample * pdfDomainExtent.X + colToSample] / ((double*)conditionalIntegrals->getPointer())[rowToSample];
+						const uint32_t colToSample = samplingTable.sampleColumn(rowToSample, xi.X, xiRemapped.X);
+						// marginal times conditional probability
+						const double texelProbability = luminancePdfPixel[rowToSample * pdfDomainExtent.X + colToSample] / samplingTable.getIntegral();
 
-					const double phi = xiRemapped.X * 2.0 * core::PI<double>();
-					const double pdf = (core::sin(theta) == 0.0) ? 0.0 : (marginalPdf * conditionalPdf) / (2.0 * core::PI<double>() * core::PI<double>() * core::sin(theta));
+						const double phi = xiRemapped.X * 2.0 * core::PI<double>();
+						const double pdf = (core::sin(theta) == 0.0) ? 0.0 : texelProbability / (2.0 * core::PI<double>() * core::PI<double>() * core::sin(theta));
 
-					*phiPdfLUTPixel++ = (float)phi;
-					*phiPdfLUTPixel++ = (float)pdf;
+						*phiPdfLUTRow++ = (float)phi;
+						*phiPdfLUTRow++ = (float)pdf;
+					}
 				}
-			}
+			);
 
 			phiPdfLUTImageView = getLUTGPUImageViewFromBuffer(phiPdfLUTBuffer, IGPUImage::ET_2D, asset::EF_R32G32_SFLOAT, { pdfDomainExtent.X, pdfDomainExtent.Y, 1 }, IGPUImageView::ET_2D);
 			thetaLUTImageView = getLUTGPUImageViewFromBuffer(thetaLUTBuffer, IGPUImage::ET_1D, asset::EF_R32_SFLOAT, { pdfDomainExtent.Y, 1, 1 }, IGPUImageView::ET_1D);
@@ -883,4 +1018,27 @@ public:
 		return windowCb->isWindowOpen();
 	}
 };
-NBL_COMMON_API_MAIN(ImportanceSamplingEnvMaps)
\ No newline at end of file
+
+#ifdef _NBL_PLATFORM_ANDROID_
+NBL_COMMON_API_MAIN(ImportanceSamplingEnvMaps)
+#else
+int main(int argc, char** argv) {
+	// CPU only benchmark and validation, no window or device gets created
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string_view arg = argv[i];
+		if (arg != "-benchmark_pdf" && arg != "-validate_sampling")
+			continue;
+
+		auto logger = core::make_smart_refctd_ptr<system::CStdoutLogger>(core::bitflag(system::ILogger::ELL_INFO) | system::ILogger::ELL_PERFORMANCE | system::ILogger::ELL_ERROR);
+		if (arg == "-benchmark_pdf")
+		{
+			benchmarkLuminancePdf(logger.get());
+			return 0;
+		}
+		// the exit code is the verdict, so build machines without a GPU can run it
+		return validateSamplingTable(logger.get()) ? 0 : 1;
+	}
+	CommonAPI::main<ImportanceSamplingEnvMaps>(argc, argv);
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,355 @@
+// Copyright (C) 2018-2023 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+#ifndef _ALLOCATOR_TEST_ALLOCATION_TRACE_H_INCLUDED_
+#define _ALLOCATOR_TEST_ALLOCATION_TRACE_H_INCLUDED_
+
+#include "nabla.h"
+
+#include <random>
+
+
+// A recorded (or synthesized) stream of `multi_alloc`/`multi_free`/`reset` calls which can be replayed against any address allocator.
+// Frees don't reference addresses (those are allocator specific) but the index of the allocation request they're undoing,
+// so the same trace can drive allocators which give out different addresses or fail different requests.
+struct SAllocationTrace
+{
+	struct SParams
+	{
+		uint32_t maxAlign = 1u;
+		uint32_t addressSpaceSize = 0u;
+		uint32_t alignOffset = 0u;
+		uint32_t offset = 0u;
+		uint32_t blockSz = 1u;
+	};
+
+	enum class E_OP : uint8_t
+	{
+		MULTI_ALLOC,
+		MULTI_FREE,
+		RESET
+	};
+	struct SOp
+	{
+		E_OP type;
+		// number of addresses allocated or freed in one call
+		uint32_t count;
+		// index of the first element in `allocs` for `MULTI_ALLOC`, or in `frees` for `MULTI_FREE`
+		uint32_t first;
+	};
+	struct SAlloc
+	{
+		uint32_t size;
+		uint32_t align;
+		// what the allocator returned when the trace was captured, for reference only as replays don't need to match
+		uint32_t address = UnknownAddress;
+	};
+	static inline constexpr uint32_t UnknownAddress = ~0u;
+
+	inline uint32_t getAllocCount() const {return static_cast<uint32_t>(allocs.size());}
+
+	// Recorded traces have no limit on how many addresses a single call can allocate or free, so split them up for allocators which do
+	inline void limitOpSize(const uint32_t maxCount)
+	{
+		nbl::core::vector<SOp> newOps;
+		newOps.reserve(ops.size());
+		for (const auto& op : ops)
+		{
+			if (op.type==E_OP::RESET)
+			{
+				newOps.push_back(op);
+				continue;
+			}
+			for (uint32_t done=0u; done<op.count; done+=maxCount)
+				newOps.push_back({op.type,std::min(op.count-done,maxCount),op.first+done});
+		}
+		ops = std::move(newOps);
+	}
+
+	std::string name;
+	SParams params;
+	nbl::core::vector<SOp> ops;
+	nbl::core::vector<SAlloc> allocs;
+	// every entry is an index into `allocs`, the allocation is freed only if it succeeded and hasn't been freed or reset yet
+	nbl::core::vector<uint32_t> frees;
+};
+
+// Deterministic synthetic trace, only the seed and the parameters decide the contents so results from different runs are comparable.
+// The distributions mirror the ones of the randomized correctness test.
+inline SAllocationTrace generateAllocationTrace(const char* name, const uint32_t seed, const SAllocationTrace::SParams& params, const uint32_t frameCount, const uint32_t maxMultiOps)
+{
+	SAllocationTrace trace;
+	trace.name = name;
+	trace.params = params;
+
+	std::mt19937 mt(seed);
+	auto getRandomNumber = [&mt](uint32_t rangeBegin, uint32_t rangeEnd) -> uint32_t
+	{
+		return std::uniform_int_distribution<uint32_t>(rangeBegin,rangeEnd)(mt);
+	};
+
+	// sizes are log-uniform so we get a healthy mix of tiny and huge allocations
+	const uint32_t maxSizeLog2 = nbl::core::findMSB(std::max(params.addressSpaceSize>>4u,1u));
+	nbl::core::vector<uint32_t> live;
+	for (uint32_t frame=0u; frame<frameCount; frame++)
+	{
+		const uint32_t multiAllocCnt = getRandomNumber(1u,64u);
+		for (uint32_t i=0u; i<multiAllocCnt; i++)
+		{
+			const uint32_t allocCnt = getRandomNumber(1u,maxMultiOps-1u);
+			trace.ops.push_back({SAllocationTrace::E_OP::MULTI_ALLOC,allocCnt,trace.getAllocCount()});
+			for (uint32_t j=0u; j<allocCnt; j++)
+			{
+				const uint32_t sizeLog2 = getRandomNumber(0u,maxSizeLog2);
+				live.push_back(trace.getAllocCount());
+				const uint32_t size = getRandomNumber(1u<<sizeLog2,(2u<<sizeLog2)-1u);
+				trace.allocs.push_back({size,getRandomNumber(1u,params.maxAlign)});
+			}
+
+			// free a random subset of what's live, allocators which can't free in any order will ignore the choice and free the most recent
+			const uint32_t freeCnt = getRandomNumber(0u,std::min<uint32_t>(live.size(),maxMultiOps));
+			if (freeCnt)
+			{
+				trace.ops.push_back({SAllocationTrace::E_OP::MULTI_FREE,freeCnt,static_cast<uint32_t>(trace.frees.size())});
+				for (uint32_t j=0u; j<freeCnt; j++)
+				{
+					const uint32_t pick = getRandomNumber(0u,live.size()-1u);
+					trace.frees.push_back(live[pick]);
+					live[pick] = live.back();
+					live.pop_back();
+				}
+			}
+		}
+		trace.ops.push_back({SAllocationTrace::E_OP::RESET,0u,0u});
+		live.clear();
+	}
+	return trace;
+}
+
+// Captures the calls made on a live allocator, call it right after every `multi_alloc_addr`, `multi_free_addr` and `reset`.
+// NOTE: not thread-safe, when recording a concurrently used allocator lock around the allocator call and the record together.
+class CAllocationTraceRecorder
+{
+	public:
+		CAllocationTraceRecorder(std::string name, const SAllocationTrace::SParams& params)
+		{
+			m_trace.name = std::move(name);
+			m_trace.params = params;
+		}
+
+		inline void multi_alloc(const uint32_t count, const uint32_t* outAddresses, const uint32_t* sizes, const uint32_t* alignments, const uint32_t invalidAddress)
+		{
+			m_trace.ops.push_back({SAllocationTrace::E_OP::MULTI_ALLOC,count,m_trace.getAllocCount()});
+			for (uint32_t i=0u; i<count; i++)
+			{
+				const bool success = outAddresses[i]!=invalidAddress;
+				if (success)
+					m_liveAllocs[outAddresses[i]] = m_trace.getAllocCount();
+				m_trace.allocs.push_back({sizes[i],alignments[i],success ? outAddresses[i]:SAllocationTrace::UnknownAddress});
+			}
+		}
+
+		// frees of addresses we didn't see being allocated are dropped
+		inline void multi_free(const uint32_t count, const uint32_t* addresses)
+		{
+			SAllocationTrace::SOp op = {SAllocationTrace::E_OP::MULTI_FREE,0u,static_cast<uint32_t>(m_trace.frees.size())};
+			for (uint32_t i=0u; i<count; i++)
+			{
+				auto found = m_liveAllocs.find(addresses[i]);
+				if (found==m_liveAllocs.end())
+					continue;
+				m_trace.frees.push_back(found->second);
+				m_liveAllocs.erase(found);
+				op.count++;
+			}
+			if (op.count)
+				m_trace.ops.push_back(op);
+		}
+
+		inline void reset()
+		{
+			m_trace.ops.push_back({SAllocationTrace::E_OP::RESET,0u,0u});
+			m_liveAllocs.clear();
+		}
+
+		inline const SAllocationTrace& getTrace() const {return m_trace;}
+
+	private:
+		SAllocationTrace m_trace;
+		// address to index in `m_trace.allocs`
+		nbl::core::unordered_map<uint32_t,uint32_t> m_liveAllocs;
+};
+
+// Binary trace file layout, all fixed size fields are little endian:
+//	- `SFileHeader`
+//	- name, `nameLength` chars without a null terminator
+//	- `opCount` ops, each one a LEB128 `type|(count<<2)` followed by its payload
+//		- `MULTI_ALLOC`: `count` times LEB128 size, alignment and `address+1` (so the unknown address encodes as 0)
+//		- `MULTI_FREE`: `count` times LEB128 distance back from the most recent allocation, so LIFO-ish frees stay one byte
+struct SAllocationTraceFileHeader
+{
+	static inline constexpr uint32_t Magic = 0x5254414eu; // "NATR"
+	static inline constexpr uint32_t CurrentVersion = 1u;
+
+	uint32_t magic = Magic;
+	uint32_t version = CurrentVersion;
+	SAllocationTrace::SParams params;
+	uint32_t nameLength;
+	uint32_t opCount;
+	uint32_t allocCount;
+	uint32_t freeCount;
+
+	// the fields in file order, the in-memory layout (padding, byte order) never touches the file
+	template<typename F>
+	inline void visitFields(F&& f)
+	{
+		for (uint32_t* field : {&magic,&version,&params.maxAlign,&params.addressSpaceSize,&params.alignOffset,&params.offset,&params.blockSz,&nameLength,&opCount,&allocCount,&freeCount})
+			f(*field);
+	}
+	static inline constexpr size_t FileSize = 11u*sizeof(uint32_t);
+};
+
+inline nbl::core::vector<uint8_t> serializeAllocationTrace(const SAllocationTrace& trace)
+{
+	nbl::core::vector<uint8_t> retval;
+	retval.reserve(SAllocationTraceFileHeader::FileSize+trace.name.size());
+
+	SAllocationTraceFileHeader header;
+	header.params = trace.params;
+	header.nameLength = static_cast<uint32_t>(trace.name.size());
+	header.opCount = static_cast<uint32_t>(trace.ops.size());
+	header.allocCount = trace.getAllocCount();
+	header.freeCount = static_cast<uint32_t>(trace.frees.size());
+	header.visitFields([&retval](const uint32_t field) -> void
+	{
+		for (uint32_t shift=0u; shift<32u; shift+=8u)
+			retval.push_back(static_cast<uint8_t>(field>>shift));
+	});
+	retval.insert(retval.end(),trace.name.begin(),trace.name.end());
+
+	auto writeVarint = [&retval](uint64_t value) -> void
+	{
+		do
+		{
+			const uint8_t lowBits = value&0x7fu;
+			value >>= 7u;
+			retval.push_back(value ? (lowBits|0x80u):lowBits);
+		} while (value);
+	};
+	uint32_t allocsSoFar = 0u;
+	for (const auto& op : trace.ops)
+	{
+		writeVarint(static_cast<uint64_t>(op.type)|(uint64_t(op.count)<<2u));
+		switch (op.type)
+		{
+			case SAllocationTrace::E_OP::MULTI_ALLOC:
+				for (uint32_t i=0u; i<op.count; i++)
+				{
+					const auto& alloc = trace.allocs[op.first+i];
+					writeVarint(alloc.size);
+					writeVarint(alloc.align);
+					writeVarint(uint64_t(alloc.address)+1ull);
+				}
+				allocsSoFar = op.first+op.count;
+				break;
+			case SAllocationTrace::E_OP::MULTI_FREE:
+				for (uint32_t i=0u; i<op.count; i++)
+					writeVarint(allocsSoFar-1u-trace.frees[op.first+i]);
+				break;
+			default:
+				break;
+		}
+	}
+	return retval;
+}
+
+// returns false if the data is truncated, of an unknown version or references allocations which don't exist
+inline bool deserializeAllocationTrace(const uint8_t* data, const size_t size, SAllocationTrace& outTrace)
+{
+	if (size<SAllocationTraceFileHeader::FileSize)
+		return false;
+	const uint8_t* it = data;
+	const uint8_t* const end = data+size;
+
+	SAllocationTraceFileHeader header;
+	header.visitFields([&it](uint32_t& field) -> void
+	{
+		field = 0u;
+		for (uint32_t shift=0u; shift<32u; shift+=8u)
+			field |= uint32_t(*(it++))<<shift;
+	});
+	if (header.magic!=SAllocationTraceFileHeader::Magic || header.version!=SAllocationTraceFileHeader::CurrentVersion)
+		return false;
+
+	if (size_t(end-it)<header.nameLength)
+		return false;
+	outTrace.name.assign(reinterpret_cast<const char*>(it),header.nameLength);
+	it += header.nameLength;
+
+	bool truncated = false;
+	auto readVarint = [&]() -> uint64_t
+	{
+		uint64_t value = 0ull;
+		for (uint32_t shift=0u; shift<64u; shift+=7u)
+		{
+			if (it==end)
+			{
+				truncated = true;
+				return 0ull;
+			}
+			const uint8_t byte = *(it++);
+			value |= uint64_t(byte&0x7fu)<<shift;
+			if (!(byte&0x80u))
+				break;
+		}
+		return value;
+	};
+
+	outTrace.params = header.params;
+	outTrace.ops.clear();
+	outTrace.allocs.clear();
+	outTrace.frees.clear();
+	// don't trust the header counts for reservations, a corrupt file shouldn't make us allocate gigabytes
+	for (uint32_t i=0u; i<header.opCount; i++)
+	{
+		const uint64_t typeAndCount = readVarint();
+		SAllocationTrace::SOp op;
+		op.type = static_cast<SAllocationTrace::E_OP>(typeAndCount&0x3u);
+		op.count = static_cast<uint32_t>(typeAndCount>>2u);
+		switch (op.type)
+		{
+			case SAllocationTrace::E_OP::MULTI_ALLOC:
+				op.first = outTrace.getAllocCount();
+				for (uint32_t j=0u; j<op.count && !truncated; j++)
+				{
+					SAllocationTrace::SAlloc alloc;
+					alloc.size = static_cast<uint32_t>(readVarint());
+					alloc.align = static_cast<uint32_t>(readVarint());
+					alloc.address = static_cast<uint32_t>(readVarint()-1ull);
+					outTrace.allocs.push_back(alloc);
+				}
+				break;
+			case SAllocationTrace::E_OP::MULTI_FREE:
+				op.first = static_cast<uint32_t>(outTrace.frees.size());
+				for (uint32_t j=0u; j<op.count && !truncated; j++)
+				{
+					const uint64_t distance = readVarint();
+					if (distance>=outTrace.getAllocCount())
+						return false;
+					outTrace.frees.push_back(outTrace.getAllocCount()-1u-static_cast<uint32_t>(distance));
+				}
+				break;
+			case SAllocationTrace::E_OP::RESET:
+				op.first = 0u;
+				break;
+			default:
+				return false;
+		}
+		if (truncated)
+			return false;
+		outTrace.ops.push_back(op);
+	}
+	return outTrace.getAllocCount()==header.allocCount && outTrace.frees.size()==header.freeCount;
+}
+
+#endif
@@ -3,6 +3,14 @@
 // For conditions of distribution and use, see copyright notice in nabla.h
 #include "../common/MonoSystemMonoLoggerApplication.hpp"
 
+#include "AllocationTrace.h"
+
+#include <barrier>
+#include <chrono>
+#include <optional>
+#include <sstream>
+#include <thread>
+
 using namespace nbl;
 using namespace core;
 using namespace system;
@@ -49,6 +57,31 @@ class RandomNumberGenerator
 
 RandomNumberGenerator rng;
 
+struct RandParams
+{
+	uint32_t maxAlign;
+	uint32_t addressSpaceSize;
+	uint32_t alignOffset;
+	uint32_t offset;
+	uint32_t blockSz;
+};
+
+RandParams getRandParams()
+{
+	RandParams randParams;
+
+	randParams.maxAlign = rng.getRndMaxAlign();
+	randParams.addressSpaceSize = rng.getRndBuffSize();
+
+	randParams.alignOffset = rng.getRandomNumber(0u, randParams.maxAlign - 1u);
+	randParams.offset = rng.getRandomNumber(0u, randParams.addressSpaceSize - 1u);
+
+	randParams.blockSz = rng.getRandomNumber(1u, (randParams.addressSpaceSize - randParams.offset) / 2u);
+	assert(randParams.blockSz > 0u);
+
+	return randParams;
+}
+
 template<typename AlctrType>
 class AllocatorHandler
 {
@@ -108,15 +141,6 @@ private:
 		};
 	};
 
-	struct RandParams
-	{
-		uint32_t maxAlign;
-		uint32_t addressSpaceSize;
-		uint32_t alignOffset;
-		uint32_t offset;
-		uint32_t blockSz;
-	};
-
 private:
 	void executeForFrame(AlctrType& alctr, RandParams& randAllocParams)
 	{
@@ -195,22 +219,6 @@ private:
 		}
 	}
 	
-	RandParams getRandParams()
-	{
-		RandParams randParams;
-
-		randParams.maxAlign = rng.getRndMaxAlign();
-		randParams.addressSpaceSize = rng.getRndBuffSize();
-
-		randParams.alignOffset = rng.getRandomNumber(0u, randParams.maxAlign - 1u);
-		randParams.offset = rng.getRandomNumber(0u, randParams.addressSpaceSize - 1u);
-
-		randParams.blockSz = rng.getRandomNumber(1u, (randParams.addressSpaceSize - randParams.offset) / 2u);
-		assert(randParams.blockSz > 0u);
-
-		return randParams;
-	}
-
 private:
 	core::vector<AllocationData> results;
 	inline void checkStillIteratable(const AlctrType& alctr)
@@ -296,6 +304,612 @@ void AllocatorHandler<core::LinearAddressAllocator<uint32_t>>::randFreeAllocated
 }
 
 
+// Replays `SAllocationTrace`s instead of generating random calls on the fly, so every allocator sees exactly the same workload
+template<typename AlctrType>
+class AllocatorBenchmark
+{
+	using Traits = core::address_allocator_traits<AlctrType>;
+	using clock_type = std::chrono::steady_clock;
+
+	static inline constexpr bool IsLinear = std::is_same_v<AlctrType,core::LinearAddressAllocator<uint32_t>>;
+	static inline constexpr bool IsPool = std::is_same_v<AlctrType,core::PoolAddressAllocator<uint32_t>>||std::is_same_v<AlctrType,core::IteratablePoolAddressAllocator<uint32_t>>;
+
+public:
+	struct SResult
+	{
+		uint64_t allocCount = 0ull;
+		uint64_t failedAllocCount = 0ull;
+		double allocSeconds = 0.0;
+		double freeSeconds = 0.0;
+		double allocsPerSecond = 0.0;
+		// latencies are per `multi_alloc_addr` call
+		double p50LatencyNs = 0.0;
+		double p99LatencyNs = 0.0;
+		// allocator bookkeeping memory, not part of the address space
+		uint64_t reservedBytes = 0ull;
+		uint64_t peakAllocatedBytes = 0ull;
+		// `1-largestFreeBlock/totalFree` sampled after every `multi_alloc_addr`, meaningless (always 0) for the pool and linear allocators
+		double meanFragmentation = 0.0;
+		double peakFragmentation = 0.0;
+	};
+
+	// optionally records what the allocator did, so a synthetic trace can be turned into a "captured" one with real addresses
+	static SResult replay(const SAllocationTrace& trace, CAllocationTraceRecorder* recorder=nullptr)
+	{
+		SResult result = {};
+
+		const auto& params = trace.params;
+		AlctrType alctr;
+		void* reservedSpace = nullptr;
+		if constexpr (IsLinear)
+			alctr = AlctrType(nullptr, params.offset, params.alignOffset, params.maxAlign, params.addressSpaceSize);
+		else
+		{
+			result.reservedBytes = AlctrType::reserved_size(params.maxAlign, params.addressSpaceSize, params.blockSz);
+			reservedSpace = _NBL_ALIGNED_MALLOC(result.reservedBytes, _NBL_SIMD_ALIGNMENT);
+			alctr = AlctrType(reservedSpace, params.offset, params.alignOffset, params.maxAlign, params.addressSpaceSize, params.blockSz);
+		}
+
+		core::vector<uint32_t> addresses(trace.getAllocCount(),AlctrType::invalid_address);
+		// successful allocations since the last reset in allocation order, needed for LIFO frees and for cheap resets
+		core::vector<uint32_t> live;
+		core::vector<uint32_t> outAddresses(Traits::maxMultiOps);
+		core::vector<uint32_t> sizes(Traits::maxMultiOps);
+		core::vector<uint32_t> alignments(Traits::maxMultiOps);
+		core::vector<uint32_t> freeIndices(Traits::maxMultiOps);
+
+		core::vector<double> latencies;
+		double fragmentationSum = 0.0;
+		for (const auto& op : trace.ops)
+		switch (op.type)
+		{
+			case SAllocationTrace::E_OP::MULTI_ALLOC:
+			{
+				for (uint32_t j=0u; j<op.count; j++)
+				{
+					const auto& alloc = trace.allocs[op.first+j];
+					outAddresses[j] = AlctrType::invalid_address;
+					if constexpr (IsPool)
+					{
+						sizes[j] = params.blockSz;
+						alignments[j] = params.blockSz;
+					}
+					else
+					{
+						sizes[j] = alloc.size;
+						alignments[j] = alloc.align;
+					}
+				}
+
+				const auto start = clock_type::now();
+				Traits::multi_alloc_addr(alctr, op.count, outAddresses.data(), sizes.data(), alignments.data());
+				const std::chrono::duration<double,std::nano> elapsed = clock_type::now()-start;
+				latencies.push_back(elapsed.count());
+				result.allocSeconds += elapsed.count()*1e-9;
+				if (recorder)
+					recorder->multi_alloc(op.count, outAddresses.data(), sizes.data(), alignments.data(), AlctrType::invalid_address);
+
+				for (uint32_t j=0u; j<op.count; j++)
+				{
+					if (outAddresses[j]==AlctrType::invalid_address)
+					{
+						result.failedAllocCount++;
+						continue;
+					}
+					result.allocCount++;
+					addresses[op.first+j] = outAddresses[j];
+					live.push_back(op.first+j);
+				}
+
+				result.peakAllocatedBytes = std::max<uint64_t>(result.peakAllocatedBytes,Traits::get_allocated_size(alctr));
+				if constexpr (!IsLinear && !IsPool)
+				{
+					const auto freeSize = Traits::get_free_size(alctr);
+					const double fragmentation = freeSize ? (1.0-double(Traits::max_size(alctr))/double(freeSize)):0.0;
+					fragmentationSum += fragmentation;
+					result.peakFragmentation = std::max(result.peakFragmentation,fragmentation);
+				}
+				break;
+			}
+			case SAllocationTrace::E_OP::MULTI_FREE:
+			{
+				// the linear allocator can only be reset
+				if constexpr (!IsLinear)
+				{
+					uint32_t freeCnt = 0u;
+					if constexpr (Traits::supportsArbitraryOrderFrees)
+					{
+						for (uint32_t j=0u; j<op.count; j++)
+						{
+							const uint32_t allocIx = trace.frees[op.first+j];
+							if (addresses[allocIx]!=AlctrType::invalid_address)
+								freeIndices[freeCnt++] = allocIx;
+						}
+					}
+					else
+					{
+						// no choice but to free whatever came last, but we can only pop what's still live
+						while (freeCnt<op.count && !live.empty())
+						{
+							freeIndices[freeCnt++] = live.back();
+							live.pop_back();
+						}
+					}
+
+					for (uint32_t j=0u; j<freeCnt; j++)
+					{
+						const uint32_t allocIx = freeIndices[j];
+						outAddresses[j] = addresses[allocIx];
+						sizes[j] = IsPool ? params.blockSz:trace.allocs[allocIx].size;
+						addresses[allocIx] = AlctrType::invalid_address;
+					}
+
+					const auto start = clock_type::now();
+					Traits::multi_free_addr(alctr, freeCnt, outAddresses.data(), sizes.data());
+					result.freeSeconds += std::chrono::duration<double>(clock_type::now()-start).count();
+					if (recorder)
+						recorder->multi_free(freeCnt, outAddresses.data());
+				}
+				break;
+			}
+			case SAllocationTrace::E_OP::RESET:
+			{
+				alctr.reset();
+				if (recorder)
+					recorder->reset();
+				for (const auto allocIx : live)
+					addresses[allocIx] = AlctrType::invalid_address;
+				live.clear();
+				break;
+			}
+		}
+
+		if constexpr (!IsLinear)
+			_NBL_ALIGNED_FREE(reservedSpace);
+
+		if (result.allocSeconds>0.0)
+			result.allocsPerSecond = double(result.allocCount)/result.allocSeconds;
+		if (!latencies.empty())
+		{
+			fragmentationSum /= double(latencies.size());
+			result.meanFragmentation = fragmentationSum;
+			auto percentile = [&latencies](const double p) -> double
+			{
+				auto nth = latencies.begin()+static_cast<size_t>(p*double(latencies.size()-1u));
+				std::nth_element(latencies.begin(),nth,latencies.end());
+				return *nth;
+			};
+			result.p50LatencyNs = percentile(0.5);
+			result.p99LatencyNs = percentile(0.99);
+		}
+		return result;
+	}
+};
+
+// Writes a whole file at once, returns false on failure
+bool writeWholeFile(ISystem* system, const system::path& outputPath, const void* data, const size_t size)
+{
+	ISystem::future_t<smart_refctd_ptr<IFile>> future;
+	system->createFile(future, outputPath, IFile::ECF_WRITE);
+	if (auto pFile = future.acquire(); pFile && pFile->get())
+	{
+		IFile::success_t writeSuccess;
+		(*pFile)->write(writeSuccess, data, 0, size);
+		return bool(writeSuccess);
+	}
+	return false;
+}
+
+// Benchmark mode, enabled with `-benchmark [results.json]`, traces are generated from fixed seeds so JSONs from different runs can be diffed
+class AllocatorBenchmarkRunner
+{
+	public:
+		AllocatorBenchmarkRunner(ILogger* logger) : m_logger(logger) {}
+
+		inline void addTrace(SAllocationTrace&& trace) {m_traces.push_back(std::move(trace));}
+
+		// fixed seeds, so these are the same across runs and machines
+		inline void addBuiltinTraces()
+		{
+			// NOTE: alignments and block sizes stay under `maxAlignmentExp`, address spaces under `maxVirtualMemoryBufferSize`
+			constexpr uint32_t MaxMultiOps = address_allocator_traits<GeneralpurposeAddressAllocator<uint32_t>>::maxMultiOps;
+			m_traces.push_back(generateAllocationTrace("small_blocks_64MiB",0x45d9f3bu,{256u,64u<<20u,0u,0u,256u},16u,MaxMultiOps));
+			m_traces.push_back(generateAllocationTrace("mixed_256MiB",0x2c1b3c6du,{4096u,256u<<20u,0u,0u,4096u},16u,MaxMultiOps));
+			m_traces.push_back(generateAllocationTrace("offset_misaligned_256MiB",0x297a2d39u,{1024u,256u<<20u,17u,4099u,1024u},16u,MaxMultiOps));
+			m_traces.push_back(generateAllocationTrace("large_1GiB",0x68e31da4u,{4096u,1u<<30u,0u,0u,64u<<10u},8u,MaxMultiOps));
+		}
+
+		// lets us tune the allocator creation parameters against a fixed workload, zero keeps what the trace was captured with
+		inline void overrideParams(const uint32_t maxAlign, const uint32_t addressSpaceSize, const uint32_t blockSz)
+		{
+			for (auto& trace : m_traces)
+			{
+				if (maxAlign)
+					trace.params.maxAlign = maxAlign;
+				if (addressSpaceSize)
+					trace.params.addressSpaceSize = addressSpaceSize;
+				if (blockSz)
+					trace.params.blockSz = blockSz;
+				trace.params.alignOffset %= trace.params.maxAlign;
+			}
+		}
+
+		// replays every trace once more against `AlctrType` and saves what it did as binary trace files in `outputDir`
+		template<typename AlctrType>
+		bool capture(ISystem* system, const system::path& outputDir) const
+		{
+			for (auto trace : m_traces)
+			{
+				trace.limitOpSize(address_allocator_traits<AlctrType>::maxMultiOps);
+				CAllocationTraceRecorder recorder(trace.name,trace.params);
+				AllocatorBenchmark<AlctrType>::replay(trace,&recorder);
+
+				const auto data = serializeAllocationTrace(recorder.getTrace());
+				const auto outputPath = outputDir/(trace.name+".natrace");
+				if (!writeWholeFile(system,outputPath,data.data(),data.size()))
+				{
+					m_logger->log("Failed to write allocation trace to \"%s\"!", ILogger::ELL_ERROR, outputPath.string().c_str());
+					return false;
+				}
+				m_logger->log("Captured %zu ops and %u allocations to \"%s\" in %zu bytes", ILogger::ELL_INFO, trace.ops.size(), trace.getAllocCount(), outputPath.string().c_str(), data.size());
+			}
+			return true;
+		}
+
+		template<typename AlctrType>
+		void run(const char* allocatorName)
+		{
+			for (auto trace : m_traces)
+			{
+				trace.limitOpSize(address_allocator_traits<AlctrType>::maxMultiOps);
+				const auto result = AllocatorBenchmark<AlctrType>::replay(trace);
+				m_logger->log(
+					"%s on \"%s\": %.0f allocs/s, p50 %.0f ns, p99 %.0f ns, %llu failed allocs, peak %llu bytes allocated, %llu bytes reserved, fragmentation mean %.3f peak %.3f",
+					ILogger::ELL_PERFORMANCE, allocatorName, trace.name.c_str(), result.allocsPerSecond, result.p50LatencyNs, result.p99LatencyNs,
+					result.failedAllocCount, result.peakAllocatedBytes, result.reservedBytes, result.meanFragmentation, result.peakFragmentation
+				);
+
+				if (!m_json.empty())
+					m_json += ",\n";
+				std::ostringstream entry;
+				entry << "\t\t{\"allocator\": \"" << allocatorName << "\", \"trace\": \"" << trace.name << "\""
+					<< ", \"allocCount\": " << result.allocCount
+					<< ", \"failedAllocCount\": " << result.failedAllocCount
+					<< ", \"allocSeconds\": " << result.allocSeconds
+					<< ", \"freeSeconds\": " << result.freeSeconds
+					<< ", \"allocsPerSecond\": " << result.allocsPerSecond
+					<< ", \"p50LatencyNs\": " << result.p50LatencyNs
+					<< ", \"p99LatencyNs\": " << result.p99LatencyNs
+					<< ", \"reservedBytes\": " << result.reservedBytes
+					<< ", \"peakAllocatedBytes\": " << result.peakAllocatedBytes
+					<< ", \"meanFragmentation\": " << result.meanFragmentation
+					<< ", \"peakFragmentation\": " << result.peakFragmentation << "}";
+				m_json += entry.str();
+			}
+		}
+
+		bool writeJSON(ISystem* system, const system::path& outputPath) const
+		{
+			const std::string json = "{\n\t\"results\": [\n"+m_json+"\n\t]\n}\n";
+			if (writeWholeFile(system,outputPath,json.data(),json.size()))
+				return true;
+			m_logger->log("Failed to write benchmark results to \"%s\"!", ILogger::ELL_ERROR, outputPath.string().c_str());
+			return false;
+		}
+
+	private:
+		ILogger* m_logger;
+		core::vector<SAllocationTrace> m_traces;
+		std::string m_json;
+};
+
+
+// Same as `std::recursive_mutex` but keeps count of how long it has been waited on and held for.
+// The statistics are static because the concurrency adaptor doesn't expose its lock and we only stress one allocator at a time.
+class CInstrumentedRecursiveMutex
+{
+		using clock_type = std::chrono::steady_clock;
+
+	public:
+		inline void lock()
+		{
+			const auto start = clock_type::now();
+			m_mutex.lock();
+			onAcquired(start);
+		}
+
+		inline bool try_lock()
+		{
+			const auto start = clock_type::now();
+			if (!m_mutex.try_lock())
+				return false;
+			onAcquired(start);
+			return true;
+		}
+
+		inline void unlock()
+		{
+			if ((--m_depth)==0u)
+				s_holdNs += std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now()-m_holdStart).count();
+			m_mutex.unlock();
+		}
+
+		static inline void resetStats()
+		{
+			s_waitNs = 0ull;
+			s_holdNs = 0ull;
+			s_acquisitions = 0ull;
+		}
+
+		static inline std::atomic<uint64_t> s_waitNs = 0ull;
+		static inline std::atomic<uint64_t> s_holdNs = 0ull;
+		static inline std::atomic<uint64_t> s_acquisitions = 0ull;
+
+	private:
+		// only ever touched by the owning thread
+		inline void onAcquired(const clock_type::time_point start)
+		{
+			const auto acquired = clock_type::now();
+			s_waitNs += std::chrono::duration_cast<std::chrono::nanoseconds>(acquired-start).count();
+			if ((m_depth++)==0u)
+			{
+				m_holdStart = acquired;
+				s_acquisitions++;
+			}
+		}
+
+		std::recursive_mutex m_mutex;
+		uint32_t m_depth = 0u;
+		clock_type::time_point m_holdStart;
+};
+
+// Drives one shared locked allocator from many threads, enabled with `-stress [maxThreads]`
+template<typename AlctrTypeST>
+class ConcurrentAllocatorStress
+{
+	using AlctrType = core::AddressAllocatorConcurrencyAdaptor<AlctrTypeST,CInstrumentedRecursiveMutex>;
+	using Traits = core::address_allocator_traits<AlctrType>;
+	using clock_type = std::chrono::steady_clock;
+
+	static inline constexpr bool IsLinear = std::is_same_v<AlctrTypeST,core::LinearAddressAllocator<uint32_t>>;
+	static inline constexpr bool IsPool = std::is_same_v<AlctrTypeST,core::PoolAddressAllocator<uint32_t>>||std::is_same_v<AlctrTypeST,core::IteratablePoolAddressAllocator<uint32_t>>;
+
+	// thread count independent, so the results of different thread counts can be compared
+	static inline constexpr uint32_t IterationsPerRound = 256u;
+	static inline constexpr uint32_t RoundCount = 8u;
+
+public:
+	struct SResult
+	{
+		uint32_t threadCount = 0u;
+		// every `multi_alloc_addr` and `multi_free_addr` call is an op
+		uint64_t opCount = 0ull;
+		uint64_t allocCount = 0ull;
+		double seconds = 0.0;
+		double opsPerSecond = 0.0;
+		double meanLockHoldNs = 0.0;
+		double meanLockWaitNs = 0.0;
+		// overlapping live allocations and allocated size bookkeeping going out of sync
+		uint64_t invariantViolations = 0ull;
+	};
+
+	static SResult run(const RandParams& params, const uint32_t threadCount, const uint32_t seed)
+	{
+		SResult result = {};
+		result.threadCount = threadCount;
+
+		void* reservedSpace = nullptr;
+		std::optional<AlctrType> alctr;
+		if constexpr (IsLinear)
+			alctr.emplace(nullptr, params.offset, params.alignOffset, params.maxAlign, params.addressSpaceSize);
+		else
+		{
+			const auto reservedSize = AlctrTypeST::reserved_size(params.maxAlign, params.addressSpaceSize, params.blockSz);
+			reservedSpace = _NBL_ALIGNED_MALLOC(reservedSize, _NBL_SIMD_ALIGNMENT);
+			alctr.emplace(reservedSpace, params.offset, params.alignOffset, params.maxAlign, params.addressSpaceSize, params.blockSz);
+		}
+		// give every thread a fair share of the address space so we measure contention and not out of memory failures,
+		// the linear allocator can't free so it gets reset after every iteration and its allocations need to leave room for the alignment padding
+		const uint32_t maxAllocSize = std::max<uint32_t>(Traits::max_size(*alctr)/(threadCount*Traits::maxMultiOps),1u);
+		const uint32_t maxAlignment = IsLinear ? std::min<uint32_t>(params.maxAlign,(maxAllocSize+1u)/2u):params.maxAlign;
+
+		struct SThreadState
+		{
+			std::mt19937 mt;
+			core::vector<std::pair<uint32_t,uint32_t>> live;
+			uint64_t opCount = 0ull;
+			uint64_t allocCount = 0ull;
+		};
+		core::vector<SThreadState> threadStates(threadCount);
+		for (uint32_t t=0u; t<threadCount; t++)
+			threadStates[t].mt.seed(seed+t);
+
+		// only called while no thread is allocating, checks that no two threads were given overlapping memory and gives all of it back
+		auto checkAndFreeLive = [&]() -> void
+		{
+			core::vector<std::pair<uint32_t,uint32_t>> allLive;
+			uint64_t liveSize = 0ull;
+			for (auto& state : threadStates)
+			{
+				for (const auto& allocation : state.live)
+					liveSize += allocation.second;
+				allLive.insert(allLive.end(),state.live.begin(),state.live.end());
+			}
+			std::sort(allLive.begin(),allLive.end());
+			for (size_t i=1u; i<allLive.size(); i++)
+			if (uint64_t(allLive[i-1u].first)+allLive[i-1u].second>allLive[i].first)
+				result.invariantViolations++;
+			if (Traits::get_allocated_size(*alctr)<liveSize)
+				result.invariantViolations++;
+
+			if constexpr (IsLinear)
+				alctr->reset();
+			else
+			{
+				for (auto& state : threadStates)
+				{
+					for (auto it=state.live.begin(); it!=state.live.end(); )
+					{
+						const uint32_t freeCnt = std::min<uint32_t>(std::distance(it,state.live.end()),Traits::maxMultiOps);
+						core::vector<uint32_t> addresses(freeCnt), sizes(freeCnt);
+						for (uint32_t j=0u; j<freeCnt; j++,it++)
+						{
+							addresses[j] = it->first;
+							sizes[j] = it->second;
+						}
+						Traits::multi_free_addr(*alctr, freeCnt, addresses.data(), sizes.data());
+					}
+				}
+				if (Traits::get_allocated_size(*alctr)!=0u)
+					result.invariantViolations++;
+			}
+			for (auto& state : threadStates)
+				state.live.clear();
+		};
+		// the linear allocator is reset by the last thread to finish an iteration, the time spent waiting for it is counted in
+		auto onLinearIterationEnd = [&checkAndFreeLive]() noexcept -> void {checkAndFreeLive();};
+		std::barrier linearIterationBarrier(threadCount,onLinearIterationEnd);
+
+		auto threadBody = [&](SThreadState& state) -> void
+		{
+			auto getRandomNumber = [&state](uint32_t rangeBegin, uint32_t rangeEnd) -> uint32_t
+			{
+				return std::uniform_int_distribution<uint32_t>(rangeBegin,rangeEnd)(state.mt);
+			};
+
+			core::vector<uint32_t> outAddresses(Traits::maxMultiOps);
+			core::vector<uint32_t> sizes(Traits::maxMultiOps);
+			core::vector<uint32_t> alignments(Traits::maxMultiOps);
+			for (uint32_t i=0u; i<IterationsPerRound; i++)
+			{
+				const uint32_t allocCnt = getRandomNumber(1u,Traits::maxMultiOps-1u);
+				for (uint32_t j=0u; j<allocCnt; j++)
+				{
+					outAddresses[j] = AlctrType::invalid_address;
+					if constexpr (IsPool)
+					{
+						sizes[j] = params.blockSz;
+						alignments[j] = params.blockSz;
+					}
+					else
+					{
+						alignments[j] = getRandomNumber(1u,maxAlignment);
+						sizes[j] = getRandomNumber(1u,IsLinear ? (maxAllocSize-alignments[j]+1u):maxAllocSize);
+					}
+				}
+				Traits::multi_alloc_addr(*alctr, allocCnt, outAddresses.data(), sizes.data(), alignments.data());
+				state.opCount++;
+				for (uint32_t j=0u; j<allocCnt; j++)
+				if (outAddresses[j]!=AlctrType::invalid_address)
+				{
+					state.live.emplace_back(outAddresses[j],sizes[j]);
+					state.allocCount++;
+				}
+
+				if constexpr (IsLinear)
+					linearIterationBarrier.arrive_and_wait();
+				else
+				{
+					const uint32_t freeCnt = getRandomNumber(0u,std::min<uint32_t>(state.live.size(),Traits::maxMultiOps));
+					if (freeCnt==0u)
+						continue;
+					std::shuffle(state.live.begin(),state.live.end(),state.mt);
+					for (uint32_t j=0u; j<freeCnt; j++)
+					{
+						const auto& allocation = state.live[state.live.size()-freeCnt+j];
+						outAddresses[j] = allocation.first;
+						sizes[j] = allocation.second;
+					}
+					Traits::multi_free_addr(*alctr, freeCnt, outAddresses.data(), sizes.data());
+					state.live.resize(state.live.size()-freeCnt);
+					state.opCount++;
+				}
+			}
+		};
+
+		for (uint32_t round=0u; round<RoundCount; round++)
+		{
+			CInstrumentedRecursiveMutex::resetStats();
+			// don't count thread creation towards the time
+			std::atomic<bool> go = false;
+			core::vector<std::thread> threads;
+			threads.reserve(threadCount);
+			for (auto& state : threadStates)
+				threads.emplace_back([&go,&threadBody,&state]() -> void
+				{
+					while (!go.load(std::memory_order_acquire))
+						std::this_thread::yield();
+					threadBody(state);
+				});
+			const auto start = clock_type::now();
+			go.store(true,std::memory_order_release);
+			for (auto& thread : threads)
+				thread.join();
+			result.seconds += std::chrono::duration<double>(clock_type::now()-start).count();
+
+			const uint64_t acquisitions = CInstrumentedRecursiveMutex::s_acquisitions;
+			if (acquisitions)
+			{
+				result.meanLockHoldNs += double(CInstrumentedRecursiveMutex::s_holdNs)/double(acquisitions*RoundCount);
+				result.meanLockWaitNs += double(CInstrumentedRecursiveMutex::s_waitNs)/double(acquisitions*RoundCount);
+			}
+
+			// now that we're single threaded again
+			checkAndFreeLive();
+		}
+
+		alctr.reset();
+		if constexpr (!IsLinear)
+			_NBL_ALIGNED_FREE(reservedSpace);
+
+		for (const auto& state : threadStates)
+		{
+			result.opCount += state.opCount;
+			result.allocCount += state.allocCount;
+		}
+		if (result.seconds>0.0)
+			result.opsPerSecond = double(result.opCount)/result.seconds;
+		return result;
+	}
+
+	// returns the total number of invariant violations over all thread counts
+	static uint64_t runScaling(ILogger* logger, const char* allocatorName, const uint32_t maxThreads)
+	{
+		const RandParams params = getRandParams();
+		const uint32_t seed = rng.getRandomNumber(0u,~0u);
+		logger->log(
+			"%s stress test with maxAlign %d, addressSpaceSize %d, alignOffset %d, offset %d, blockSz %d",
+			ILogger::ELL_INFO, allocatorName, params.maxAlign, params.addressSpaceSize, params.alignOffset, params.offset, params.blockSz
+		);
+
+		uint64_t invariantViolations = 0ull;
+		double singleThreadedOpsPerSecond = 0.0;
+		// powers of two plus a few counts that aren't, so uneven splits of the address space get exercised too
+		core::vector<uint32_t> threadCounts;
+		for (uint32_t threadCount=1u; threadCount<maxThreads; threadCount<<=1u)
+			threadCounts.push_back(threadCount);
+		if (maxThreads>3u)
+			threadCounts.push_back(3u);
+		threadCounts.push_back(maxThreads);
+		std::sort(threadCounts.begin(),threadCounts.end());
+		for (const uint32_t threadCount : threadCounts)
+		{
+			const auto result = run(params,threadCount,seed);
+			if (threadCount==1u)
+				singleThreadedOpsPerSecond = result.opsPerSecond;
+			logger->log(
+				"%s with %d threads: %.0f ops/s (%.2fx of 1 thread), %llu allocations, mean lock hold %.0f ns, mean lock wait %.0f ns, %llu invariant violations",
+				result.invariantViolations ? ILogger::ELL_ERROR:ILogger::ELL_PERFORMANCE, allocatorName, threadCount, result.opsPerSecond,
+				singleThreadedOpsPerSecond>0.0 ? result.opsPerSecond/singleThreadedOpsPerSecond:0.0, result.allocCount,
+				result.meanLockHoldNs, result.meanLockWaitNs, result.invariantViolations
+			);
+			invariantViolations += result.invariantViolations;
+		}
+		return invariantViolations;
+	}
+};
+
+
 class AllocatorTestApp final : public nbl::examples::MonoSystemMonoLoggerApplication
 {
 		using base_t = examples::MonoSystemMonoLoggerApplication;
@@ -309,6 +923,64 @@ class AllocatorTestApp final : public nbl::examples::MonoSystemMonoLoggerApplica
 			if (!base_t::onAppInitialized(std::move(system)))
 				return false;
 
+			// Benchmark mode replaces the randomized correctness tests, by default it uses the builtin synthetic traces
+			//	`-trace <file.natrace>` (repeatable) replays captured traces instead
+			//	`-maxAlign`, `-addressSpaceSize` and `-blockSz` override the allocator creation parameters stored in the traces
+			//	`-capture <dir>` saves the traces with the addresses a General Purpose allocator handed out, so they can be kept as regression traces
+			if (hasOption("-benchmark"))
+			{
+				const std::string* outputPath = getOptionValue("-benchmark");
+
+				AllocatorBenchmarkRunner runner(m_logger.get());
+				for (auto it=argv.begin(); it!=argv.end(); it++)
+				{
+					if (*it!="-trace")
+						continue;
+					if (std::next(it)==argv.end() || std::next(it)->starts_with('-'))
+						return logFail("`-trace` needs to be followed by the path of a trace file!");
+					SAllocationTrace trace;
+					if (!loadTrace(*(++it),trace))
+						return false;
+					runner.addTrace(std::move(trace));
+				}
+				if (!hasOption("-trace"))
+					runner.addBuiltinTraces();
+
+				auto getUintOption = [&](const char* option) -> uint32_t
+				{
+					const std::string* value = getOptionValue(option);
+					return value ? std::strtoul(value->c_str(),nullptr,0):0u;
+				};
+				runner.overrideParams(getUintOption("-maxAlign"),getUintOption("-addressSpaceSize"),getUintOption("-blockSz"));
+
+				if (const std::string* captureDir=getOptionValue("-capture"); captureDir)
+				if (!runner.capture<core::GeneralpurposeAddressAllocator<uint32_t>>(m_system.get(),*captureDir))
+					return false;
+
+				runner.run<core::PoolAddressAllocator<uint32_t>>("Pool");
+				runner.run<core::IteratablePoolAddressAllocator<uint32_t>>("IteratablePool");
+				runner.run<core::LinearAddressAllocator<uint32_t>>("Linear");
+				runner.run<core::StackAddressAllocator<uint32_t>>("Stack");
+				runner.run<core::GeneralpurposeAddressAllocator<uint32_t>>("General");
+				return runner.writeJSON(m_system.get(),outputPath ? system::path(*outputPath):"allocator_benchmark.json");
+			}
+
+			// Multi-threaded stress replaces the randomized correctness tests as well
+			if (hasOption("-stress"))
+			{
+				const std::string* maxThreadsArg = getOptionValue("-stress");
+				const uint32_t maxThreads = maxThreadsArg ? std::max(std::atoi(maxThreadsArg->c_str()),1):64u;
+
+				uint64_t invariantViolations = 0ull;
+				invariantViolations += ConcurrentAllocatorStress<core::PoolAddressAllocator<uint32_t>>::runScaling(m_logger.get(),"Pool",maxThreads);
+				invariantViolations += ConcurrentAllocatorStress<core::IteratablePoolAddressAllocator<uint32_t>>::runScaling(m_logger.get(),"IteratablePool",maxThreads);
+				invariantViolations += ConcurrentAllocatorStress<core::LinearAddressAllocator<uint32_t>>::runScaling(m_logger.get(),"Linear",maxThreads);
+				invariantViolations += ConcurrentAllocatorStress<core::GeneralpurposeAddressAllocator<uint32_t>>::runScaling(m_logger.get(),"General",maxThreads);
+				if (invariantViolations)
+					return logFail("Concurrent stress test found %llu invariant violations!",invariantViolations);
+				return true;
+			}
+
 			// Allocator test
 			{
 				{
@@ -372,6 +1044,39 @@ class AllocatorTestApp final : public nbl::examples::MonoSystemMonoLoggerApplica
 
 	protected:
 		virtual core::bitflag<system::ILogger::E_LOG_LEVEL> getLogLevelMask() {return ILogger::ELL_ALL;}
+
+	private:
+		inline bool hasOption(const std::string_view option) const
+		{
+			return std::find(argv.begin(),argv.end(),option)!=argv.end();
+		}
+
+		// the argument right after `option`, nullptr if there's none or its another option
+		inline const std::string* getOptionValue(const std::string_view option) const
+		{
+			auto found = std::find(argv.begin(),argv.end(),option);
+			if (found==argv.end() || (++found)==argv.end() || found->empty() || found->front()=='-')
+				return nullptr;
+			return &(*found);
+		}
+
+		bool loadTrace(const system::path& path, SAllocationTrace& outTrace)
+		{
+			ISystem::future_t<smart_refctd_ptr<IFile>> future;
+			m_system->createFile(future, path, bitflag(IFile::ECF_READ)|IFile::ECF_MAPPABLE);
+			if (auto pFile = future.acquire(); pFile && pFile->get())
+			{
+				const IFile* file = pFile->get();
+				const auto* data = reinterpret_cast<const uint8_t*>(file->getMappedPointer());
+				if (data && deserializeAllocationTrace(data,file->getSize(),outTrace))
+				{
+					m_logger->log("Loaded trace \"%s\" with %zu ops and %u allocations from \"%s\"", ILogger::ELL_INFO, outTrace.name.c_str(), outTrace.ops.size(), outTrace.getAllocCount(), path.string().c_str());
+					return true;
+				}
+				return logFail("\"%s\" is not a valid allocation trace!", path.string().c_str());
+			}
+			return logFail("Could not open allocation trace \"%s\"!", path.string().c_str());
+		}
 };
 
 NBL_MAIN_FUNC(AllocatorTestApp)
@@ -0,0 +1,234 @@
+// Copyright (C) 2018-2023 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+#ifndef _LRU_CACHE_TEST_COMPACT_LRU_CACHE_H_INCLUDED_
+#define _LRU_CACHE_TEST_COMPACT_LRU_CACHE_H_INCLUDED_
+
+#include "nabla.h"
+
+#include "HashMixing.h"
+
+
+// Drop-in for `core::LRUCache` meant for 10^7+ entries with small keys and values.
+// Nodes live in one pooled array and link to each other with 32bit indices, the lookup is an open addressing (linear probing)
+// table of node indices, so there is no per-entry heap allocation. The overhead is 8 bytes of links in every node plus 4 bytes per table slot,
+// the table is a power of two at most 3/4 full so that's ~5.3 to ~10.7 bytes per entry. For example 50M `<int,char>` entries take 16 byte nodes
+// and a 2^27 slot (537 MB) table, about 27 bytes per entry.
+template<typename Key, typename Value, typename MapHash=std::hash<Key>, typename MapEquals=std::equal_to<Key>>
+class CompactLRUCache
+{
+		static inline constexpr uint32_t InvalidIndex = ~0u;
+
+	public:
+		CompactLRUCache(const uint32_t capacity, MapHash&& _hash=MapHash(), MapEquals&& _equals=MapEquals())
+			: m_hash(std::move(_hash)), m_equals(std::move(_equals)), m_capacity(capacity)
+		{
+			assert(capacity>0u && capacity<InvalidIndex);
+			// keep load factor under 3/4
+			const uint32_t tableSize = nbl::core::roundUpToPoT<uint64_t>(uint64_t(capacity)+(capacity/3u)+1u);
+			m_tableMask = tableSize-1u;
+			m_table = std::make_unique<uint32_t[]>(tableSize);
+			std::fill_n(m_table.get(),tableSize,InvalidIndex);
+			// only reserves virtual memory, pages get committed as the cache fills
+			m_nodes.reserve(capacity);
+		}
+
+		inline uint32_t getSize() const {return m_size;}
+		inline uint32_t getCapacity() const {return m_capacity;}
+
+		// memory actually owned by the cache (not counting any heap memory owned by keys or values)
+		inline size_t getByteSize() const {return sizeof(*this)+m_nodes.capacity()*sizeof(SNode)+(size_t(m_tableMask)+1u)*sizeof(uint32_t);}
+
+		template<typename K, typename V>
+		inline Value* insert(K&& k, V&& v)
+		{
+			return insert(std::forward<K>(k),std::forward<V>(v),[](const Key&, Value&)->void{});
+		}
+		// `evictionCallback(const Key&, Value&)` gets called on the least recently used entry right before it gets overwritten
+		template<typename K, typename V, typename EvictionCallback>
+		inline Value* insert(K&& k, V&& v, EvictionCallback&& evictionCallback)
+		{
+			uint32_t slot = findSlot(k);
+			if (m_table[slot]!=InvalidIndex)
+			{
+				const uint32_t nodeIx = m_table[slot];
+				m_nodes[nodeIx].value = std::forward<V>(v);
+				moveToFront(nodeIx);
+				return &m_nodes[nodeIx].value;
+			}
+
+			uint32_t nodeIx;
+			if (m_size==m_capacity)
+			{
+				// evict the least recently used node and reuse it in-place
+				nodeIx = m_tail;
+				evictionCallback(std::as_const(m_nodes[nodeIx].key),m_nodes[nodeIx].value);
+				eraseSlot(findSlot(m_nodes[nodeIx].key));
+				unlink(nodeIx);
+				m_nodes[nodeIx].key = std::forward<K>(k);
+				m_nodes[nodeIx].value = std::forward<V>(v);
+				// backward shift deletion could have moved the empty slot we found
+				slot = findSlot(m_nodes[nodeIx].key);
+			}
+			else
+			{
+				if (m_freeList!=InvalidIndex)
+				{
+					nodeIx = m_freeList;
+					m_freeList = m_nodes[nodeIx].next;
+					m_nodes[nodeIx].key = std::forward<K>(k);
+					m_nodes[nodeIx].value = std::forward<V>(v);
+				}
+				else
+				{
+					nodeIx = static_cast<uint32_t>(m_nodes.size());
+					m_nodes.push_back({Key(std::forward<K>(k)),Value(std::forward<V>(v)),InvalidIndex,InvalidIndex});
+				}
+				m_size++;
+			}
+			m_table[slot] = nodeIx;
+			linkFront(nodeIx);
+			return &m_nodes[nodeIx].value;
+		}
+
+		// marks the entry as most recently used
+		inline Value* get(const Key& key)
+		{
+			const uint32_t nodeIx = m_table[findSlot(key)];
+			if (nodeIx==InvalidIndex)
+				return nullptr;
+			moveToFront(nodeIx);
+			return &m_nodes[nodeIx].value;
+		}
+
+		// doesn't touch the recency order
+		inline Value* peek(const Key& key)
+		{
+			const uint32_t nodeIx = m_table[findSlot(key)];
+			return nodeIx!=InvalidIndex ? (&m_nodes[nodeIx].value):nullptr;
+		}
+
+		inline void erase(const Key& key)
+		{
+			const uint32_t slot = findSlot(key);
+			const uint32_t nodeIx = m_table[slot];
+			if (nodeIx==InvalidIndex)
+				return;
+			eraseNode(slot,nodeIx);
+		}
+
+		// returns false if the cache was empty
+		template<typename EvictionCallback>
+		inline bool evictLeastRecentlyUsed(EvictionCallback&& evictionCallback)
+		{
+			if (m_tail==InvalidIndex)
+				return false;
+			const uint32_t nodeIx = m_tail;
+			evictionCallback(std::as_const(m_nodes[nodeIx].key),m_nodes[nodeIx].value);
+			eraseNode(findSlot(m_nodes[nodeIx].key),nodeIx);
+			return true;
+		}
+
+		inline void print(nbl::core::smart_refctd_ptr<nbl::system::ILogger> logger)
+		{
+			logger->log("Printing LRU cache contents");
+			for (uint32_t nodeIx=m_head; nodeIx!=InvalidIndex; nodeIx=m_nodes[nodeIx].next)
+				logger->log("Key: " + std::to_string(m_nodes[nodeIx].key) + ", Value: " + std::to_string(m_nodes[nodeIx].value));
+		}
+
+	private:
+		struct SNode
+		{
+			Key key;
+			Value value;
+			uint32_t prev;
+			// also links the free list
+			uint32_t next;
+		};
+
+		inline uint32_t homeSlot(const Key& key) const
+		{
+			return static_cast<uint32_t>(mixHash(m_hash(key))>>32u)&m_tableMask;
+		}
+
+		// either the slot holding `key` or the empty slot where it would go
+		inline uint32_t findSlot(const Key& key) const
+		{
+			uint32_t slot = homeSlot(key);
+			for (; m_table[slot]!=InvalidIndex; slot=(slot+1u)&m_tableMask)
+			if (m_equals(m_nodes[m_table[slot]].key,key))
+				break;
+			return slot;
+		}
+
+		inline void eraseNode(const uint32_t slot, const uint32_t nodeIx)
+		{
+			eraseSlot(slot);
+			unlink(nodeIx);
+			m_nodes[nodeIx].next = m_freeList;
+			m_freeList = nodeIx;
+			m_size--;
+		}
+
+		// backward shift deletion, keeps probe sequences intact without tombstones
+		inline void eraseSlot(uint32_t slot)
+		{
+			for (uint32_t next=(slot+1u)&m_tableMask; m_table[next]!=InvalidIndex; next=(next+1u)&m_tableMask)
+			{
+				const uint32_t home = homeSlot(m_nodes[m_table[next]].key);
+				// can only move the entry back if its home isn't cyclically in (slot,next]
+				const bool homeInRange = slot<=next ? (slot<home && home<=next):(slot<home || home<=next);
+				if (homeInRange)
+					continue;
+				m_table[slot] = m_table[next];
+				slot = next;
+			}
+			m_table[slot] = InvalidIndex;
+		}
+
+		inline void unlink(const uint32_t nodeIx)
+		{
+			SNode& node = m_nodes[nodeIx];
+			if (node.prev!=InvalidIndex)
+				m_nodes[node.prev].next = node.next;
+			else
+				m_head = node.next;
+			if (node.next!=InvalidIndex)
+				m_nodes[node.next].prev = node.prev;
+			else
+				m_tail = node.prev;
+		}
+
+		inline void linkFront(const uint32_t nodeIx)
+		{
+			SNode& node = m_nodes[nodeIx];
+			node.prev = InvalidIndex;
+			node.next = m_head;
+			if (m_head!=InvalidIndex)
+				m_nodes[m_head].prev = nodeIx;
+			else
+				m_tail = nodeIx;
+			m_head = nodeIx;
+		}
+
+		inline void moveToFront(const uint32_t nodeIx)
+		{
+			if (nodeIx==m_head)
+				return;
+			unlink(nodeIx);
+			linkFront(nodeIx);
+		}
+
+		MapHash m_hash;
+		MapEquals m_equals;
+		const uint32_t m_capacity;
+		uint32_t m_size = 0u;
+		uint32_t m_head = InvalidIndex;
+		uint32_t m_tail = InvalidIndex;
+		uint32_t m_freeList = InvalidIndex;
+		uint32_t m_tableMask;
+		std::unique_ptr<uint32_t[]> m_table;
+		nbl::core::vector<SNode> m_nodes;
+};
+
+#endif
@@ -0,0 +1,102 @@
+// Copyright (C) 2018-2023 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+#ifndef _LRU_CACHE_TEST_COST_AWARE_LRU_CACHE_H_INCLUDED_
+#define _LRU_CACHE_TEST_COST_AWARE_LRU_CACHE_H_INCLUDED_
+
+#include "CompactLRUCache.h"
+
+#include <functional>
+
+
+// LRU cache where every entry carries a cost (usually its size in bytes) and eviction keeps the total cost under a budget,
+// meant for values which vary from bytes to hundreds of megabytes where a count based capacity is meaningless.
+// The optional eviction callback runs right before an entry leaves the cache due to the budget or entry count, so it can release GPU memory,
+// it does NOT run for `erase` or when `insert` replaces the value of an existing key since the caller already knows about those.
+template<typename Key, typename Value, typename MapHash=std::hash<Key>, typename MapEquals=std::equal_to<Key>>
+class CostAwareLRUCache
+{
+	public:
+		using cost_t = uint64_t;
+		using eviction_callback_t = std::function<void(const Key&,Value&,const cost_t)>;
+
+		// `maxEntries` is a hard cap on the entry count on top of the budget, it sizes the lookup table
+		CostAwareLRUCache(const cost_t budget, const uint32_t maxEntries, eviction_callback_t&& evictionCallback={}, MapHash&& _hash=MapHash(), MapEquals&& _equals=MapEquals())
+			: m_cache(maxEntries,std::move(_hash),std::move(_equals)), m_evictionCallback(std::move(evictionCallback)), m_budget(budget) {}
+
+		inline cost_t getBudget() const {return m_budget;}
+		inline cost_t getTotalCost() const {return m_totalCost;}
+		inline uint32_t getSize() const {return m_cache.getSize();}
+
+		// returns nullptr without inserting if `cost` alone exceeds the budget
+		template<typename K, typename V>
+		inline Value* insert(K&& k, V&& v, const cost_t cost)
+		{
+			if (cost>m_budget)
+				return nullptr;
+
+			// replacing drops the old cost first, so the entry can't evict itself
+			if (const SEntry* existing=m_cache.peek(k); existing)
+			{
+				m_totalCost -= existing->cost;
+				m_cache.erase(k);
+			}
+
+			auto onEvict = [this](const Key& key, SEntry& entry) -> void {onEvicted(key,entry);};
+			while (m_totalCost+cost>m_budget)
+				m_cache.evictLeastRecentlyUsed(onEvict);
+
+			m_totalCost += cost;
+			return &m_cache.insert(std::forward<K>(k),SEntry{Value(std::forward<V>(v)),cost},onEvict)->value;
+		}
+
+		inline Value* get(const Key& key)
+		{
+			SEntry* entry = m_cache.get(key);
+			return entry ? (&entry->value):nullptr;
+		}
+
+		inline Value* peek(const Key& key)
+		{
+			SEntry* entry = m_cache.peek(key);
+			return entry ? (&entry->value):nullptr;
+		}
+
+		inline void erase(const Key& key)
+		{
+			if (const SEntry* entry=m_cache.peek(key); entry)
+			{
+				m_totalCost -= entry->cost;
+				m_cache.erase(key);
+			}
+		}
+
+		// lowering the budget evicts right away
+		inline void setBudget(const cost_t budget)
+		{
+			m_budget = budget;
+			while (m_totalCost>m_budget)
+				m_cache.evictLeastRecentlyUsed([this](const Key& key, SEntry& entry) -> void {onEvicted(key,entry);});
+		}
+
+	private:
+		struct SEntry
+		{
+			Value value;
+			cost_t cost;
+		};
+
+		inline void onEvicted(const Key& key, SEntry& entry)
+		{
+			m_totalCost -= entry.cost;
+			if (m_evictionCallback)
+				m_evictionCallback(key,entry.value,entry.cost);
+		}
+
+		CompactLRUCache<Key,SEntry,MapHash,MapEquals> m_cache;
+		eviction_callback_t m_evictionCallback;
+		cost_t m_budget;
+		cost_t m_totalCost = 0ull;
+};
+
+#endif
@@ -0,0 +1,23 @@
+// Copyright (C) 2018-2023 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+#ifndef _LRU_CACHE_TEST_HASH_MIXING_H_INCLUDED_
+#define _LRU_CACHE_TEST_HASH_MIXING_H_INCLUDED_
+
+#include <cstdint>
+
+
+// `std::hash` of integers is usually the identity, so anything picking shards or table slots from a hash must mix the bits first.
+// Fibonacci hashing, the high bits of the result depend on all the bits of the input so take those and not the low ones.
+inline uint64_t mixHash(const uint64_t hash)
+{
+	return hash*0x9E3779B97F4A7C15ull;
+}
+
+// the top `bitCount` bits of the mixed hash, `bitCount` of 0 is allowed and always gives 0
+inline uint64_t mixedHashTopBits(const uint64_t hash, const uint32_t bitCount)
+{
+	return bitCount ? (mixHash(hash)>>(64u-bitCount)):0ull;
+}
+
+#endif
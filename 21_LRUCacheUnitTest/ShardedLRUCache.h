@@ -0,0 +1,109 @@
+// Copyright (C) 2018-2023 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+#ifndef _LRU_CACHE_TEST_SHARDED_LRU_CACHE_H_INCLUDED_
+#define _LRU_CACHE_TEST_SHARDED_LRU_CACHE_H_INCLUDED_
+
+#include "nabla.h"
+
+#include "HashMixing.h"
+
+#include <mutex>
+#include <optional>
+
+
+// Thread-safe `core::LRUCache` made out of independently locked shards, keys are distributed over shards by hash
+// so lookups of different keys mostly don't contend on the same lock.
+// NOTE: recency is tracked per shard, so eviction is only approximately LRU with respect to the whole cache.
+// `ShardCache` can be any cache with the `core::LRUCache` interface, such as `CompactLRUCache`.
+template<typename Key, typename Value, typename MapHash=std::hash<Key>, typename MapEquals=std::equal_to<Key>, class ShardCache=nbl::core::LRUCache<Key,Value,MapHash,MapEquals>>
+class ShardedLRUCache
+{
+		using shard_cache_t = ShardCache;
+
+	public:
+		// `shardCount` gets rounded up to a power of two, the capacity is split evenly between the shards
+		ShardedLRUCache(const uint32_t capacity, const uint32_t shardCount, const MapHash& _hash=MapHash(), const MapEquals& _equals=MapEquals())
+			: m_hash(_hash), m_shardCountLog2(nbl::core::findMSB(nbl::core::roundUpToPoT(std::max(shardCount,1u))))
+		{
+			const uint32_t count = 0x1u<<m_shardCountLog2;
+			const uint32_t shardCapacity = std::max((capacity+count-1u)/count,1u);
+			m_shards.reserve(count);
+			for (uint32_t i=0u; i<count; i++)
+				m_shards.push_back(std::make_unique<SShard>(shardCapacity,_hash,_equals));
+		}
+
+		inline uint32_t getShardCount() const {return static_cast<uint32_t>(m_shards.size());}
+
+		template<typename K, typename V>
+		inline void insert(K&& k, V&& v)
+		{
+			auto& shard = getShard(k);
+			std::unique_lock lock(shard.mutex);
+			shard.cache.insert(std::forward<K>(k),std::forward<V>(v));
+		}
+
+		// Unlike `LRUCache::get` and `LRUCache::peek` we have to return a copy, another thread could evict the entry as soon as the shard unlocks
+		inline std::optional<Value> get(const Key& key)
+		{
+			auto& shard = getShard(key);
+			std::unique_lock lock(shard.mutex);
+			if (const Value* found=shard.cache.get(key); found)
+				return *found;
+			return std::nullopt;
+		}
+		inline std::optional<Value> peek(const Key& key)
+		{
+			auto& shard = getShard(key);
+			std::unique_lock lock(shard.mutex);
+			if (const Value* found=shard.cache.peek(key); found)
+				return *found;
+			return std::nullopt;
+		}
+
+		// for when `Value` is expensive to copy, `f` gets called with a `Value*` (nullptr on a miss) while the shard is still locked
+		template<typename F>
+		inline decltype(auto) get(const Key& key, F&& f)
+		{
+			auto& shard = getShard(key);
+			std::unique_lock lock(shard.mutex);
+			return std::forward<F>(f)(shard.cache.get(key));
+		}
+
+		inline void erase(const Key& key)
+		{
+			auto& shard = getShard(key);
+			std::unique_lock lock(shard.mutex);
+			shard.cache.erase(key);
+		}
+
+		inline void print(nbl::core::smart_refctd_ptr<nbl::system::ILogger> logger)
+		{
+			for (auto& shard : m_shards)
+			{
+				std::unique_lock lock(shard->mutex);
+				shard->cache.print(logger);
+			}
+		}
+
+	private:
+		// own cacheline so that locking one shard doesn't invalidate the neighbours
+		struct alignas(64) SShard
+		{
+			SShard(const uint32_t capacity, const MapHash& _hash, const MapEquals& _equals) : cache(capacity,MapHash(_hash),MapEquals(_equals)) {}
+
+			std::mutex mutex;
+			shard_cache_t cache;
+		};
+
+		inline SShard& getShard(const Key& key)
+		{
+			return *m_shards[mixedHashTopBits(m_hash(key),m_shardCountLog2)];
+		}
+
+		MapHash m_hash;
+		uint32_t m_shardCountLog2;
+		nbl::core::vector<std::unique_ptr<SShard>> m_shards;
+};
+
+#endif
@@ -5,6 +5,17 @@
 
 // I've moved out a tiny part of this example into a shared header for reuse, please open and read it.
 #include "../common/MonoSystemMonoLoggerApplication.hpp"
+#include "../common/ResidentMemory.hpp"
+
+#include "CompactLRUCache.h"
+#include "CostAwareLRUCache.h"
+#include "ShardedLRUCache.h"
+
+#include <chrono>
+#include <numeric>
+#include <random>
+#include <thread>
+
 
 using namespace nbl;
 using namespace core;
@@ -13,6 +24,40 @@ using namespace asset;
 using namespace video;
 
 
+// Zipf distributed keys in [0,keyRange), scattered over the range so the popular keys aren't neighbours
+core::vector<int> generateZipfianKeys(const uint32_t keyRange, const size_t count, const double exponent, const uint32_t seed)
+{
+	core::vector<double> cdf(keyRange);
+	double sum = 0.0;
+	for (uint32_t rank = 0u; rank < keyRange; rank++)
+		cdf[rank] = (sum += 1.0 / std::pow(double(rank + 1u), exponent));
+
+	std::mt19937 mt(seed);
+	std::uniform_real_distribution<double> dist(0.0, sum);
+	core::vector<uint32_t> rankToKey(keyRange);
+	std::iota(rankToKey.begin(), rankToKey.end(), 0u);
+	std::shuffle(rankToKey.begin(), rankToKey.end(), mt);
+
+	core::vector<int> keys(count);
+	for (auto& key : keys)
+	{
+		const auto rank = std::min<size_t>(std::distance(cdf.begin(), std::lower_bound(cdf.begin(), cdf.end(), dist(mt))), keyRange - 1u);
+		key = static_cast<int>(rankToKey[rank]);
+	}
+	return keys;
+}
+
+core::vector<int> generateUniformKeys(const uint32_t keyRange, const size_t count, const uint32_t seed)
+{
+	std::mt19937 mt(seed);
+	std::uniform_int_distribution<uint32_t> dist(0u, keyRange - 1u);
+	core::vector<int> keys(count);
+	for (auto& key : keys)
+		key = static_cast<int>(dist(mt));
+	return keys;
+}
+
+
 class LRUCacheTestApp final : public nbl::examples::MonoSystemMonoLoggerApplication
 {
 		using base_t = examples::MonoSystemMonoLoggerApplication;
@@ -32,6 +77,13 @@ class LRUCacheTestApp final : public nbl::examples::MonoSystemMonoLoggerApplicat
 			hugeCache.insert(0, '0');
 			hugeCache.print(m_logger);
 
+			// large capacities of the compact cache are covered by `-footprint_benchmark`
+			m_logger->log("Testing compact cache...");
+			CompactLRUCache<int, char> compactCache(4u);
+			for (int k = 0; k < 5; k++)
+				compactCache.insert(k, static_cast<char>('0' + k));
+			assert(!compactCache.peek(0) && *compactCache.peek(4) == '4');
+
 
 			LRUCache<int, char> cache(5u);
 
@@ -103,14 +155,297 @@ class LRUCacheTestApp final : public nbl::examples::MonoSystemMonoLoggerApplicat
 		#ifdef _NBL_DEBUG
 			cache2.print(m_logger);
 		#endif
+
+			m_logger->log("Testing sharded cache...");
+			{
+				ShardedLRUCache<int, std::string> shardedCache(8u, 4u);
+				assert(shardedCache.getShardCount() == 4u);
+
+				shardedCache.insert(10, "ten");
+				shardedCache.insert(11, "eleven");
+				assert(shardedCache.get(10).value() == "ten");
+				assert(shardedCache.peek(11).value() == "eleven");
+				assert(shardedCache.get(11, [](const std::string* val) { return val && *val == "eleven"; }));
+
+				shardedCache.insert(10, "ten again");
+				assert(shardedCache.get(10).value() == "ten again");
+
+				shardedCache.erase(10);
+				shardedCache.erase(520);
+				assert(!shardedCache.get(10).has_value());
+				assert(!shardedCache.peek(10).has_value());
+
+				// every shard should evict on its own when full
+				for (int k = 0; k < 1000; k++)
+					shardedCache.insert(k, std::to_string(k));
+				uint32_t survivors = 0u;
+				for (int k = 0; k < 1000; k++)
+					survivors += shardedCache.peek(k).has_value();
+				assert(survivors <= 8u);
+				assert(shardedCache.get(999).value() == "999");
+			}
+
+			m_logger->log("Testing compact cache...");
+			{
+				CompactLRUCache<int, std::string> compactCache(5u);
+				for (int k = 0; k < 5; k++)
+					compactCache.insert(k, std::to_string(k));
+				assert(compactCache.getSize() == 5u);
+
+				// touch 0 so 1 becomes the least recently used
+				assert(*compactCache.get(0) == "0");
+				compactCache.insert(5, "5");
+				assert(compactCache.peek(1) == nullptr);
+				assert(*compactCache.peek(0) == "0");
+
+				compactCache.insert(5, "five");
+				assert(*compactCache.get(5) == "five");
+				assert(compactCache.getSize() == 5u);
+
+				compactCache.erase(520);
+				compactCache.erase(3);
+				assert(compactCache.get(3) == nullptr);
+				assert(compactCache.getSize() == 4u);
+
+				// erased node gets reused, nothing should get evicted
+				compactCache.insert(6, "6");
+				for (const int k : { 0,2,4,5,6 })
+					assert(compactCache.peek(k) != nullptr);
+
+				// hammer the probing and backward shift deletion
+				CompactLRUCache<int, int> churnCache(1000u);
+				for (int k = 0; k < 100000; k++)
+				{
+					churnCache.insert(k, k);
+					if (k % 3 == 0)
+						churnCache.erase(k - 500);
+				}
+				for (int k = 99000; k < 100000; k++)
+				{
+					const int* val = churnCache.peek(k);
+					assert(!val || *val == k);
+				}
+				assert(*churnCache.peek(99999) == 99999);
+
+				ShardedLRUCache<int, std::string, std::hash<int>, std::equal_to<int>, CompactLRUCache<int, std::string>> shardedCompactCache(8u, 4u);
+				shardedCompactCache.insert(10, "ten");
+				assert(shardedCompactCache.get(10).value() == "ten");
+			}
+
+			m_logger->log("Testing cost aware cache...");
+			{
+				const std::string small(8u, 's'), medium(24u, 'm'), large(48u, 'l'), huge(100u, 'h');
+
+				uint64_t evictedCost = 0ull;
+				core::vector<int> evictedKeys;
+				CostAwareLRUCache<int, std::string> costCache(64u, 16u, [&](const int& key, std::string& val, const uint64_t cost)
+					{
+						assert(val.size() == cost);
+						evictedKeys.push_back(key);
+						evictedCost += cost;
+					}
+				);
+
+				// 8+24 fits
+				costCache.insert(0, small, small.size());
+				costCache.insert(1, medium, medium.size());
+				assert(costCache.getTotalCost() == 32u);
+				assert(evictedKeys.empty());
+
+				// 32+48 doesn't, the least recently used entry has to go, the small one survives because we touched it
+				assert(*costCache.get(0) == small);
+				costCache.insert(2, large, large.size());
+				assert(costCache.getTotalCost() == 56u);
+				assert(evictedKeys.size() == 1u && evictedKeys[0] == 1);
+				assert(costCache.peek(1) == nullptr);
+
+				// more expensive than the whole budget, gets refused and nothing gets evicted
+				assert(costCache.insert(3, huge, huge.size()) == nullptr);
+				assert(costCache.getTotalCost() == 56u && costCache.getSize() == 2u);
+
+				// replacing a value only counts the new cost and the old value isn't reported as evicted, but 48+24 still evicts the large one
+				costCache.insert(0, medium, medium.size());
+				assert(costCache.getTotalCost() == 24u);
+				assert(evictedKeys.size() == 2u && evictedKeys[1] == 2);
+
+				costCache.erase(0);
+				assert(costCache.getTotalCost() == 0u && costCache.getSize() == 0u);
+				assert(evictedKeys.size() == 2u);
+
+				// entry count cap still applies for tiny values, and still reports costs
+				for (int k = 0; k < 32; k++)
+					costCache.insert(100 + k, std::string(1u, 'c'), 1u);
+				assert(costCache.getSize() == 16u && costCache.getTotalCost() == 16u);
+				assert(evictedCost == 24u + 48u + 16u);
+
+				costCache.setBudget(4u);
+				assert(costCache.getSize() == 4u && costCache.getTotalCost() == 4u);
+				assert(*costCache.peek(131) == "c");
+			}
+
 			m_logger->log("all good");
 
+			if (std::find(argv.begin(), argv.end(), "-benchmark") != argv.end())
+				benchmarkShardedCache();
+			if (std::find(argv.begin(), argv.end(), "-footprint_benchmark") != argv.end())
+			{
+				benchmarkFootprint<LRUCache<int, char>>("LRUCache");
+				benchmarkFootprint<CompactLRUCache<int, char>>("CompactLRUCache");
+				benchmarkKeyStreams<LRUCache<int, char>>("LRUCache");
+				benchmarkKeyStreams<CompactLRUCache<int, char>>("CompactLRUCache");
+			}
+
 			return true;
 		}
 
 		void workLoopBody() override {}
 
 		bool keepRunning() override { return false; }
+
+	private:
+		// Construction time and resident memory per entry of a completely filled cache
+		template<class Cache>
+		void benchmarkFootprint(const char* cacheName)
+		{
+			for (const uint32_t capacity : { 1000000u,10000000u,50000000u })
+			{
+				const size_t residentBefore = examples::getResidentBytes();
+				const auto start = std::chrono::steady_clock::now();
+				auto cache = std::make_unique<Cache>(capacity);
+				const auto constructed = std::chrono::steady_clock::now();
+				for (uint32_t k = 0u; k < capacity; k++)
+					cache->insert(static_cast<int>(k), static_cast<char>(k));
+				const auto filled = std::chrono::steady_clock::now();
+				const size_t residentAfter = examples::getResidentBytes();
+
+				m_logger->log(
+					"%s with %u entries: construction %.2f ms, fill %.2f ms, %.1f bytes per entry", ILogger::ELL_PERFORMANCE, cacheName, capacity,
+					std::chrono::duration<double, std::milli>(constructed - start).count(), std::chrono::duration<double, std::milli>(filled - constructed).count(),
+					double(residentAfter > residentBefore ? residentAfter - residentBefore : 0ull) / double(capacity)
+				);
+			}
+		}
+
+		// Cost of `get` hits, of `insert` into a full cache (always evicts) and of a get-or-insert mix, under uniform and Zipfian key streams
+		template<class Cache>
+		void benchmarkKeyStreams(const char* cacheName)
+		{
+			constexpr uint32_t Capacity = 1u << 21u;
+			constexpr size_t StreamLength = 1ull << 24u;
+			constexpr double ZipfExponent = 0.99;
+
+			struct SStream
+			{
+				const char* name;
+				// keys in [0,Capacity) so every lookup hits after filling
+				core::vector<int> hitKeys;
+				// 4x larger key range than capacity
+				core::vector<int> mixedKeys;
+			};
+			const SStream streams[] = {
+				{"uniform", generateUniformKeys(Capacity, StreamLength, 1u), generateUniformKeys(Capacity * 4u, StreamLength, 2u)},
+				{"zipfian", generateZipfianKeys(Capacity, StreamLength, ZipfExponent, 3u), generateZipfianKeys(Capacity * 4u, StreamLength, ZipfExponent, 4u)}
+			};
+
+			using clock_type = std::chrono::steady_clock;
+			auto nsPerOp = [](const clock_type::time_point start, const size_t opCount) -> double
+			{
+				return std::chrono::duration<double, std::nano>(clock_type::now() - start).count() / double(opCount);
+			};
+			for (const auto& stream : streams)
+			{
+				Cache cache(Capacity);
+				for (uint32_t k = 0u; k < Capacity; k++)
+					cache.insert(static_cast<int>(k), static_cast<char>(k));
+
+				// accumulate something so the lookups can't be optimized out
+				uint64_t checksum = 0ull;
+				auto start = clock_type::now();
+				for (const int key : stream.hitKeys)
+					checksum += *cache.get(key);
+				const double getNs = nsPerOp(start, stream.hitKeys.size());
+
+				start = clock_type::now();
+				for (uint32_t k = 0u; k < Capacity; k++)
+					cache.insert(static_cast<int>(Capacity + k), static_cast<char>(k));
+				const double evictNs = nsPerOp(start, Capacity);
+
+				uint64_t hits = 0ull;
+				start = clock_type::now();
+				for (const int key : stream.mixedKeys)
+				{
+					if (const char* val = cache.get(key))
+					{
+						checksum += *val;
+						hits++;
+					}
+					else
+						cache.insert(key, static_cast<char>(key));
+				}
+				const double mixedNs = nsPerOp(start, stream.mixedKeys.size());
+
+				m_logger->log(
+					"%s %s keys: get hit %.1f ns, insert with eviction %.1f ns, get-or-insert %.1f ns at %.1f%% hit rate (checksum %llu)", ILogger::ELL_PERFORMANCE,
+					cacheName, stream.name, getNs, evictNs, mixedNs, double(hits) / double(stream.mixedKeys.size()) * 100.0, checksum
+				);
+			}
+		}
+
+		// Every thread does a `get` of a uniformly random key and an `insert` on a miss, key range is a bit larger than capacity so hit rate stays around 80%
+		void benchmarkShardedCache()
+		{
+			constexpr uint32_t Capacity = 1u << 20u;
+			constexpr uint32_t KeyRange = Capacity + (Capacity >> 2u);
+			constexpr uint32_t OpsPerThread = 1u << 20u;
+			const uint32_t maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+			core::vector<uint32_t> threadCounts;
+			for (uint32_t threadCount = 1u; threadCount < maxThreads; threadCount <<= 1u)
+				threadCounts.push_back(threadCount);
+			threadCounts.push_back(maxThreads);
+
+			m_logger->log("Sharded cache benchmark, capacity %u, %u ops per thread", ILogger::ELL_PERFORMANCE, Capacity, OpsPerThread);
+			for (const uint32_t shardCount : { 1u,4u,16u,64u,256u })
+			for (const uint32_t threadCount : threadCounts)
+			{
+				ShardedLRUCache<uint32_t, uint64_t> cache(Capacity, shardCount);
+				for (uint32_t k = 0u; k < Capacity; k++)
+					cache.insert(k, uint64_t(k));
+
+				core::vector<uint64_t> hits(threadCount, 0ull);
+				core::vector<std::thread> threads;
+				threads.reserve(threadCount);
+				const auto start = std::chrono::steady_clock::now();
+				for (uint32_t t = 0u; t < threadCount; t++)
+					threads.emplace_back([&cache, &hits, t]() -> void
+					{
+						std::mt19937 mt(t);
+						std::uniform_int_distribution<uint32_t> keyDist(0u, KeyRange - 1u);
+						uint64_t localHits = 0ull;
+						for (uint32_t i = 0u; i < OpsPerThread; i++)
+						{
+							const uint32_t key = keyDist(mt);
+							if (cache.get(key))
+								localHits++;
+							else
+								cache.insert(key, uint64_t(key));
+						}
+						hits[t] = localHits;
+					});
+				for (auto& thread : threads)
+					thread.join();
+				const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+				uint64_t totalHits = 0ull;
+				for (const auto localHits : hits)
+					totalHits += localHits;
+				const double totalOps = double(OpsPerThread) * double(threadCount);
+				m_logger->log(
+					"%3u shards, %3u threads: %.2f M hits/s, %.2f M lookups/s, hit rate %.1f%%", ILogger::ELL_PERFORMANCE,
+					shardCount, threadCount, double(totalHits) / seconds * 1e-6, totalOps / seconds * 1e-6, double(totalHits) / totalOps * 100.0
+				);
+			}
+		}
 };
 
 NBL_MAIN_FUNC(LRUCacheTestApp)
\ No newline at end of file
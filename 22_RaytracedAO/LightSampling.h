@@ -0,0 +1,111 @@
+#ifndef _LIGHT_SAMPLING_INCLUDED_
+#define _LIGHT_SAMPLING_INCLUDED_
+
+#include "nabla.h"
+
+#include <numeric>
+
+
+// The two representations of the light selection distribution, both quantize probabilities to 32bit fixed point
+// and pick a light from a single 32bit random number. Kept free of any driver objects so they can be tested on the CPU.
+namespace light_sampling
+{
+	static inline constexpr double FixedPointOne = double(0x1ull<<32ull);
+
+	// `weights` and `outCDF` may alias, every weight is read before its CDF value is written
+	inline void buildCDF(const float* weights, const uint32_t count, uint32_t* outCDF)
+	{
+		const double weightSum = std::accumulate(weights,weights+count,0.0);
+		assert(weightSum>FLT_MIN);
+
+		const double weightSumRcp = FixedPointOne/weightSum;
+
+		double partialSum = 0.0;
+		for (uint32_t i=0u; i<count; i++)
+		{
+			partialSum += double(weights[i]);
+			const double exactCDF = weightSumRcp*partialSum+double(FLT_MIN);
+			if (exactCDF<FixedPointOne)
+				outCDF[i] = static_cast<uint32_t>(exactCDF);
+			else
+			{
+				assert(exactCDF<FixedPointOne+1.0);
+				outCDF[i] = 0xdeadbeefu;
+			}
+		}
+	}
+
+	// the last CDF value is implicitly 1.0, so it doesn't matter that it can't be represented
+	inline uint32_t sampleCDF(const uint32_t* cdf, const uint32_t count, const uint32_t xi)
+	{
+		return static_cast<uint32_t>(std::upper_bound(cdf,cdf+count-1u,xi)-cdf);
+	}
+
+	// Walker's alias method, the random number picks a bin uniformly and its leftover fraction decides between the bin's light and its alias
+	struct SAliasTableEntry
+	{
+		uint32_t threshold; // probability of keeping the bin's own light in 32bit fixed point
+		uint32_t alias;
+	};
+
+	// Vose's construction, the scaling and the split into under and over-full bins run in parallel, only the O(count) pairing is serial.
+	// The output only depends on the weights.
+	inline void buildAliasTable(const float* weights, const uint32_t count, nbl::core::vector<SAliasTableEntry>& outTable)
+	{
+		// sum per chunk in parallel, the chunk sums get added in order so the rounding doesn't depend on the scheduling
+		constexpr uint32_t ChunkSize = 0x1u<<14;
+		nbl::core::vector<uint32_t> chunks((count+ChunkSize-1u)/ChunkSize);
+		std::iota(chunks.begin(),chunks.end(),0u);
+		nbl::core::vector<double> chunkSums(chunks.size());
+		std::for_each(nbl::core::execution::par,chunks.begin(),chunks.end(),[&](const uint32_t chunk) -> void
+		{
+			const uint32_t begin = chunk*ChunkSize;
+			chunkSums[chunk] = std::accumulate(weights+begin,weights+nbl::core::min(begin+ChunkSize,count),0.0);
+		});
+		const double weightSum = std::accumulate(chunkSums.begin(),chunkSums.end(),0.0);
+		assert(weightSum>FLT_MIN);
+
+		// probabilities times the bin count, so a light which exactly fills its own bin gets 1.0
+		nbl::core::vector<double> scaled(count);
+		const double scale = double(count)/weightSum;
+		std::transform(nbl::core::execution::par_unseq,weights,weights+count,scaled.begin(),[scale](const float weight) -> double {return double(weight)*scale;});
+
+		nbl::core::vector<uint32_t> bins(count);
+		std::iota(bins.begin(),bins.end(),0u);
+		const auto firstOverfull = std::stable_partition(nbl::core::execution::par,bins.begin(),bins.end(),[&scaled](const uint32_t bin) -> bool {return scaled[bin]<1.0;});
+		nbl::core::vector<uint32_t> underfull(bins.begin(),firstOverfull);
+		nbl::core::vector<uint32_t> overfull(firstOverfull,bins.end());
+
+		// every under-full bin gets topped up by an over-full one, which may become under-full itself
+		outTable.resize(count);
+		while (!underfull.empty() && !overfull.empty())
+		{
+			const uint32_t bin = underfull.back();
+			underfull.pop_back();
+			const uint32_t donor = overfull.back();
+			outTable[bin] = {static_cast<uint32_t>(scaled[bin]*FixedPointOne),donor};
+			scaled[donor] -= 1.0-scaled[bin];
+			if (scaled[donor]<1.0)
+			{
+				overfull.pop_back();
+				underfull.push_back(donor);
+			}
+		}
+		// whatever is left is full up to rounding
+		for (const uint32_t bin : underfull)
+			outTable[bin] = {0xffffffffu,bin};
+		for (const uint32_t bin : overfull)
+			outTable[bin] = {0xffffffffu,bin};
+	}
+
+	inline uint32_t sampleAliasTable(const SAliasTableEntry* table, const uint32_t count, const uint32_t xi)
+	{
+		// high bits of the product are the bin, the low bits are the uniformly distributed position within it
+		const uint64_t scaledXi = uint64_t(xi)*uint64_t(count);
+		const uint32_t bin = static_cast<uint32_t>(scaledXi>>32ull);
+		const SAliasTableEntry entry = table[bin];
+		return static_cast<uint32_t>(scaledXi)<entry.threshold ? bin:entry.alias;
+	}
+}
+
+#endif
@@ -2,6 +2,7 @@
 #include <filesystem>
 
 #include "Renderer.h"
+#include "SampleSequenceGenerator.h"
 
 #include "nbl/ext/ScreenShot/ScreenShot.h"
 #include "nbl/ext/FullScreenTriangle/FullScreenTriangle.h"
@@ -9,6 +10,20 @@
 #include "../source/Nabla/COpenCLHandler.h"
 #include "COpenGLDriver.h"
 
+#include "../common/StreamingImageWriter.hpp"
+
+#ifdef _NBL_PLATFORM_WINDOWS_
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 
 #ifndef _NBL_BUILD_OPTIX_
 	#define __C_CUDA_HANDLER_H__ // don't want CUDA declarations and defines to pollute here
@@ -793,36 +808,10 @@ void Renderer::finalizeScene(Renderer::InitializationData& initData)
 		return;
 	m_staticViewData.lightCount = initData.lights.size();
 
-	const double weightSum = std::accumulate(initData.lightPDF.begin(),initData.lightPDF.end(),0.0);
-	assert(weightSum>FLT_MIN);
-
-	constexpr double UINT_MAX_DOUBLE = double(0x1ull<<32ull);
-	const double weightSumRcp = UINT_MAX_DOUBLE/weightSum;
-
-	auto outCDF = initData.lightCDF.begin();
-
-	auto inPDF = initData.lightPDF.begin();
-	double partialSum = *inPDF;
-
-	auto computeCDF = [UINT_MAX_DOUBLE,weightSumRcp,&partialSum,&outCDF](uint32_t prevCDF) -> void
-	{
-		const double exactCDF = weightSumRcp*partialSum+double(FLT_MIN);
-		if (exactCDF<UINT_MAX_DOUBLE)
-			*outCDF = static_cast<uint32_t>(exactCDF);
-		else
-		{
-			assert(exactCDF<UINT_MAX_DOUBLE+1.0);
-			*outCDF = 0xdeadbeefu;
-		}
-	};
-
-	computeCDF(0u);
-	for (auto prevCDF=outCDF++; outCDF!=initData.lightCDF.end(); prevCDF=outCDF++)
-	{
-		partialSum += double(*(++inPDF));
-
-		computeCDF(*prevCDF);
-	}
+	// before the PDF gets overwritten by the CDF
+	if constexpr (BuildLightAliasTable)
+		light_sampling::buildAliasTable(initData.lightPDF.data(),initData.lights.size(),initData.lightAliasTable);
+	light_sampling::buildCDF(initData.lightPDF.data(),initData.lights.size(),initData.lightCDF.data());
 }
 
 core::smart_refctd_ptr<IGPUImageView> Renderer::createScreenSizedTexture(E_FORMAT format, uint32_t layers)
@@ -866,34 +855,154 @@ void Renderer::SampleSequence::createBufferView(IVideoDriver* driver, core::smar
 	auto gpubuf = driver->createFilledDeviceLocalBufferOnDedMem(buff->getSize(),buff->getPointer());
 	bufferView = driver->createBufferView(gpubuf.get(),asset::EF_R32G32_UINT);
 }
-core::smart_refctd_ptr<ICPUBuffer> Renderer::SampleSequence::createBufferView(IVideoDriver* driver, uint32_t quantizedDimensions, uint32_t sampleCount)
+void Renderer::SampleSequence::createBufferView(IVideoDriver* driver, const void* data, size_t bytesize)
 {
-	constexpr auto DimensionsPerQuanta = 3u;
-	const auto dimensions = quantizedDimensions*DimensionsPerQuanta;
-	core::OwenSampler sampler(dimensions,0xdeadbeefu);
+	auto gpubuf = driver->createFilledDeviceLocalBufferOnDedMem(bytesize,data);
+	bufferView = driver->createBufferView(gpubuf.get(),asset::EF_R32G32_UINT);
+}
 
-	// Memory Order: 3 Dimensions, then multiple of sampling stragies per vertex, then depth, then sample ID
-	auto buff = createCPUBuffer(quantizedDimensions,sampleCount);
-	uint32_t(&pout)[][2] = *reinterpret_cast<uint32_t(*)[][2]>(buff->getPointer());
-	// the horrible order of iteration over output memory is caused by the fact that certain samplers like the 
-	// Owen Scramble sampler, have a large cache which needs to be generated separately for each dimension.
-	for (auto metadim=0u; metadim<quantizedDimensions; metadim++)
-	{
-		const auto trudim = metadim*DimensionsPerQuanta;
-		for (uint32_t i=0; i<sampleCount; i++)
-			pout[i*quantizedDimensions+metadim][0] = sampler.sample(trudim+0u,i);
-		for (uint32_t i=0; i<sampleCount; i++)
-			pout[i*quantizedDimensions+metadim][1] = sampler.sample(trudim+1u,i);
-		for (uint32_t i=0; i<sampleCount; i++)
+namespace
+{
+// read-only view of a whole file, the sample cache can be hundreds of megabytes and only a prefix of it might be needed
+class MappedCacheFile
+{
+	public:
+		MappedCacheFile(const char* path)
 		{
-			const auto sample = sampler.sample(trudim+2u,i);
-			const auto out = pout[i*quantizedDimensions+metadim];
-			out[0] &= 0xFFFFF800u;
-			out[0] |= sample>>21;
-			out[1] &= 0xFFFFF800u;
-			out[1] |= (sample>>10)&0x07FFu;
+		#ifdef _NBL_PLATFORM_WINDOWS_
+			file = CreateFileA(path,GENERIC_READ,FILE_SHARE_READ,nullptr,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,nullptr);
+			if (file==INVALID_HANDLE_VALUE)
+				return;
+			LARGE_INTEGER fileSize;
+			if (!GetFileSizeEx(file,&fileSize) || fileSize.QuadPart==0)
+				return;
+			mapping = CreateFileMappingA(file,nullptr,PAGE_READONLY,0,0,nullptr);
+			if (!mapping)
+				return;
+			data = MapViewOfFile(mapping,FILE_MAP_READ,0,0,0);
+			if (data)
+				size = fileSize.QuadPart;
+		#else
+			const int fd = open(path,O_RDONLY);
+			if (fd<0)
+				return;
+			struct stat fileStat;
+			if (fstat(fd,&fileStat)==0 && fileStat.st_size>0)
+			{
+				void* mapped = mmap(nullptr,fileStat.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+				if (mapped!=MAP_FAILED)
+				{
+					data = mapped;
+					size = fileStat.st_size;
+				}
+			}
+			// the mapping stays valid after closing
+			close(fd);
+		#endif
 		}
+		MappedCacheFile(const MappedCacheFile&) = delete;
+		~MappedCacheFile()
+		{
+		#ifdef _NBL_PLATFORM_WINDOWS_
+			if (data)
+				UnmapViewOfFile(data);
+			if (mapping)
+				CloseHandle(mapping);
+			if (file!=INVALID_HANDLE_VALUE)
+				CloseHandle(file);
+		#else
+			if (data)
+				munmap(data,size);
+		#endif
+		}
+
+		const void* getData() const {return data;}
+		size_t getSize() const {return size;}
+
+	private:
+	#ifdef _NBL_PLATFORM_WINDOWS_
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = nullptr;
+	#endif
+		void* data = nullptr;
+		size_t size = 0ull;
+};
+
+// FNV-1a over whole quantized samples, the payload is always a multiple of 8 bytes
+uint64_t hashSampleSequence(const void* data, size_t bytesize)
+{
+	const auto* samples = reinterpret_cast<const uint64_t*>(data);
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (size_t i=0u; i<bytesize/sizeof(uint64_t); i++)
+		hash = (hash^samples[i])*0x100000001b3ull;
+	return hash;
+}
+}
+
+bool Renderer::SampleSequence::createBufferViewFromCache(IVideoDriver* driver, const io::path& cachePath, uint32_t quantizedDimensions, uint32_t sampleCount)
+{
+	MappedCacheFile cacheFile(cachePath.c_str());
+	if (cacheFile.getSize()<sizeof(SCacheHeader))
+		return false;
+
+	SCacheHeader header;
+	memcpy(&header,cacheFile.getData(),sizeof(SCacheHeader));
+	if (header.magic!=SCacheHeader::Magic || header.version!=SCacheHeader::Version || header.seed!=OwenSamplerSeed)
+	{
+		printf("[INFO] Sample Sequence Cache has an outdated format, discarding it.\n");
+		return false;
+	}
+	// a sample only depends on the seed, its dimension and index, so a bigger cache contains the smaller sequence
+	if (header.quantizedDimensions<quantizedDimensions || header.sampleCount<sampleCount)
+		return false;
+	const size_t payloadSize = QuantizedDimensionsBytesize*header.quantizedDimensions*header.sampleCount;
+	if (cacheFile.getSize()!=sizeof(SCacheHeader)+payloadSize)
+		return false;
+
+	const auto* payload = reinterpret_cast<const uint8_t*>(cacheFile.getData())+sizeof(SCacheHeader);
+	if (hashSampleSequence(payload,payloadSize)!=header.checksum)
+	{
+		printf("[WARNING] Sample Sequence Cache is corrupted, regenerating.\n");
+		return false;
 	}
+
+	if (header.quantizedDimensions==quantizedDimensions)
+		createBufferView(driver,payload,QuantizedDimensionsBytesize*quantizedDimensions*sampleCount);
+	else
+	{
+		// the shader's stride is the requested dimension count, so every sample needs its leading dimensions compacted
+		auto buff = createCPUBuffer(quantizedDimensions,sampleCount);
+		const size_t sampleSize = QuantizedDimensionsBytesize*quantizedDimensions;
+		const size_t cachedSampleSize = QuantizedDimensionsBytesize*header.quantizedDimensions;
+		auto* out = reinterpret_cast<uint8_t*>(buff->getPointer());
+		for (uint32_t i=0u; i<sampleCount; i++)
+			memcpy(out+i*sampleSize,payload+i*cachedSampleSize,sampleSize);
+		createBufferView(driver,std::move(buff));
+	}
+	return true;
+}
+
+void Renderer::SampleSequence::writeCache(io::IFileSystem* filesystem, const io::path& cachePath, const ICPUBuffer* buff, uint32_t quantizedDimensions, uint32_t sampleCount)
+{
+	io::IWriteFile* cacheFile = filesystem->createAndWriteFile(cachePath);
+	if (!cacheFile)
+		return;
+
+	SCacheHeader header = {};
+	header.magic = SCacheHeader::Magic;
+	header.version = SCacheHeader::Version;
+	header.seed = OwenSamplerSeed;
+	header.quantizedDimensions = quantizedDimensions;
+	header.sampleCount = sampleCount;
+	header.checksum = hashSampleSequence(buff->getPointer(),buff->getSize());
+	cacheFile->write(&header,sizeof(header));
+	cacheFile->write(buff->getPointer(),buff->getSize());
+	cacheFile->drop();
+}
+core::smart_refctd_ptr<ICPUBuffer> Renderer::SampleSequence::createBufferView(IVideoDriver* driver, uint32_t quantizedDimensions, uint32_t sampleCount)
+{
+	auto buff = createCPUBuffer(quantizedDimensions,sampleCount);
+	sample_sequence::generate(reinterpret_cast<uint32_t(*)[2]>(buff->getPointer()),quantizedDimensions,sampleCount,OwenSamplerSeed);
 	// upload sequence to GPU
 	createBufferView(driver,core::smart_refctd_ptr(buff));
 	// return for caching
@@ -1016,6 +1125,8 @@ void Renderer::initSceneResources(SAssetBundle& meshes, nbl::io::path&& _sampleS
 			std::cout << "\nScene Resources Initialized:" << std::endl;
 			std::cout << "\tlightCDF = " << lightCDF_BufferSize << " bytes" << std::endl;
 			std::cout << "\tlights = " << lights_BufferSize << " bytes" << std::endl;
+			if constexpr (BuildLightAliasTable)
+				std::cout << "\tlightAliasTable = " << initData.lightAliasTable.size()*sizeof(light_sampling::SAliasTableEntry) << " bytes" << std::endl;
 			std::cout << "\tindexBuffer = " << m_indexBuffer->getSize() << " bytes" << std::endl;
 			for (auto i=0u; i<2u; i++)
 				std::cout << "\tIndirect Draw Buffers[" << i << "] = " << m_indirectDrawBuffers[i]->getSize() << " bytes" << std::endl;
@@ -1023,24 +1134,7 @@ void Renderer::initSceneResources(SAssetBundle& meshes, nbl::io::path&& _sampleS
 		
 		// load sample cache
 		{
-			core::smart_refctd_ptr<ICPUBuffer> cachebuff;
-			uint32_t cachedQuantizedDimensions=0u,cachedSampleCount=0u;
-			{
-				sampleSequenceCachePath = std::move(_sampleSequenceCachePath);
-				io::IReadFile* cacheFile = m_assetManager->getFileSystem()->createAndOpenFile(sampleSequenceCachePath);
-				if (cacheFile)
-				{
-					cacheFile->read(&cachedQuantizedDimensions,sizeof(cachedQuantizedDimensions));
-					if (cachedQuantizedDimensions)
-					{
-						cachedSampleCount = (cacheFile->getSize()-cacheFile->getPos())/(cachedQuantizedDimensions*SampleSequence::QuantizedDimensionsBytesize);
-						cachebuff = sampleSequence.createCPUBuffer(cachedQuantizedDimensions,cachedSampleCount);
-						if (cachebuff)
-							cacheFile->read(cachebuff->getPointer(),cachebuff->getSize());
-					}
-					cacheFile->drop();
-				}
-			}
+			sampleSequenceCachePath = std::move(_sampleSequenceCachePath);
 			// lets keep path length within bounds of sanity
 			constexpr auto MaxPathDepth = 255u;
 			if (pathDepth==0)
@@ -1059,20 +1153,12 @@ void Renderer::initSceneResources(SAssetBundle& meshes, nbl::io::path&& _sampleS
 			// near 1.0 with exponent -1 after the sample count passes 2^24 elements.
 			// Another limiting factor is our encoding of sample sequences, we only use 21bits per channel, so no duplicates till 2^21 samples.
 			maxSensorSamples = core::min(0x1<<21,maxSensorSamples);
-			if (cachedQuantizedDimensions>=quantizedDimensions && cachedSampleCount>=maxSensorSamples)
-				sampleSequence.createBufferView(m_driver,std::move(cachebuff));
-			else
+			if (!sampleSequence.createBufferViewFromCache(m_driver,sampleSequenceCachePath,quantizedDimensions,maxSensorSamples))
 			{
 				printf("[INFO] Generating Low Discrepancy Sample Sequence Cache, please wait...\n");
-				cachebuff = sampleSequence.createBufferView(m_driver,quantizedDimensions,maxSensorSamples);
+				auto cachebuff = sampleSequence.createBufferView(m_driver,quantizedDimensions,maxSensorSamples);
 				// save sequence
-				io::IWriteFile* cacheFile = m_assetManager->getFileSystem()->createAndWriteFile(sampleSequenceCachePath);
-				if (cacheFile)
-				{
-					cacheFile->write(&quantizedDimensions,sizeof(quantizedDimensions));
-					cacheFile->write(cachebuff->getPointer(),cachebuff->getSize());
-					cacheFile->drop();
-				}
+				SampleSequence::writeCache(m_assetManager->getFileSystem(),sampleSequenceCachePath,cachebuff.get(),quantizedDimensions,maxSensorSamples);
 			}
 			std::cout << "\tpathDepth = " << pathDepth << std::endl;
 			std::cout << "\tnoRussianRouletteDepth = " << noRussianRouletteDepth << std::endl;
@@ -1484,6 +1570,88 @@ void Renderer::resetSampleAndFrameCounters()
 	m_prevCamTform = nbl::core::matrix4x3();
 }
 
+// Downloads a screen sized texture once and streams it into a ZIP compressed half float RGBA EXR, bands of rows get decoded
+// and deflated on all cores instead of converting the whole image on one thread before the writer sees it.
+// Returns false for texel formats it can't decode, so the caller can fall back to `ext::ScreenShot`.
+static bool streamScreenShotToEXR(IVideoDriver* driver, IGPUImageView* imageView, const std::filesystem::path& path)
+{
+	auto* image = imageView->getCreationParameters().image.get();
+	const auto& imageParams = image->getCreationParameters();
+	const E_FORMAT format = imageParams.format;
+	if (format!=EF_R16G16B16A16_SFLOAT && format!=EF_A2B10G10R10_UNORM_PACK32)
+		return false;
+
+	const uint32_t width = imageParams.extent.width;
+	const uint32_t height = imageParams.extent.height;
+	const size_t texelBytes = getTexelOrBlockBytesize(format);
+	const size_t downloadSize = texelBytes*width*height;
+
+	IDeviceMemoryBacked::SDeviceMemoryRequirements reqs;
+	reqs.vulkanReqs.size = downloadSize;
+	reqs.vulkanReqs.alignment = alignof(uint64_t);
+	reqs.vulkanReqs.memoryTypeBits = ~0u;
+	reqs.memoryHeapLocation = IDeviceMemoryAllocation::ESMT_NOT_DEVICE_LOCAL;
+	reqs.mappingCapability = IDeviceMemoryAllocation::EMCF_COHERENT|IDeviceMemoryAllocation::EMCF_CAN_MAP_FOR_READ;
+	reqs.prefersDedicatedAllocation = 0u;
+	reqs.requiresDedicatedAllocation = 0u;
+	auto downloadBuffer = driver->createGPUBufferOnDedMem(reqs);
+	if (!downloadBuffer)
+		return false;
+
+	IGPUImage::SBufferCopy region = {};
+	region.imageSubresource.baseArrayLayer = 0u;
+	region.imageSubresource.layerCount = 1u;
+	region.imageExtent = {width,height,1u};
+	driver->copyImageToBuffer(image,downloadBuffer.get(),1u,&region);
+	glFinish();
+
+	const auto* texels = reinterpret_cast<const uint8_t*>(downloadBuffer->getBoundMemory()->mapMemoryRange(
+		IDeviceMemoryAllocation::EMCAF_READ,
+		IDeviceMemoryAllocation::MemoryRange(0u,downloadSize)
+	));
+	if (!texels)
+		return false;
+
+	examples::CStreamingEXRWriter writer(path,width,height,4u,examples::CStreamingEXRWriter::EPT_HALF,examples::openexr_codec::EC_ZIP);
+	bool success = writer.isValid();
+	if (success)
+	{
+		const uint32_t rowsPerBand = writer.getRowsPerBlock()*4u;
+		core::vector<uint32_t> bands((height+rowsPerBand-1u)/rowsPerBand);
+		std::iota(bands.begin(),bands.end(),0u);
+		std::atomic_bool bandsWritten = true;
+		std::for_each(core::execution::par,bands.begin(),bands.end(),[&](const uint32_t band) -> void
+			{
+				const uint32_t firstRow = band*rowsPerBand;
+				const uint32_t rowCount = std::min(rowsPerBand,height-firstRow);
+				core::vector<float> decoded(size_t(rowCount)*width*4u);
+				const uint8_t* in = texels+texelBytes*width*firstRow;
+				for (size_t i=0u; i<decoded.size(); i+=4u, in+=texelBytes)
+				{
+					if (format==EF_R16G16B16A16_SFLOAT)
+					{
+						const auto* halves = reinterpret_cast<const uint16_t*>(in);
+						for (auto c=0u; c<4u; c++)
+							decoded[i+c] = core::Float16Compressor::decompress(halves[c]);
+					}
+					else
+					{
+						const uint32_t packed = *reinterpret_cast<const uint32_t*>(in);
+						for (auto c=0u; c<3u; c++)
+							decoded[i+c] = float((packed>>(c*10u))&0x3ffu)/1023.f;
+						decoded[i+3u] = float(packed>>30u)/3.f;
+					}
+				}
+				if (!writer.writeRows(firstRow,rowCount,decoded.data(),width*4u))
+					bandsWritten = false;
+			}
+		);
+		success = writer.finish() && bandsWritten;
+	}
+	downloadBuffer->getBoundMemory()->unmapMemory();
+	return success;
+}
+
 void Renderer::takeAndSaveScreenShot(const std::filesystem::path& screenshotFilePath, bool denoise, const DenoiserArgs& denoiserArgs)
 {
 	auto commandQueue = m_rrManager->getCLCommandQueue();
@@ -1497,12 +1665,17 @@ void Renderer::takeAndSaveScreenShot(const std::filesystem::path& screenshotFile
 
 	auto filename_wo_ext = screenshotFilePath;
 	filename_wo_ext.replace_extension();
+	auto saveScreenShot = [&](IGPUImageView* imageView, const std::string& path) -> void
+	{
+		if (!streamScreenShotToEXR(m_driver,imageView,path))
+			ext::ScreenShot::createScreenShot(m_driver,m_assetManager,imageView,path,format);
+	};
 	if (m_tonemapOutput)
-		ext::ScreenShot::createScreenShot(m_driver,m_assetManager,m_tonemapOutput.get(),filename_wo_ext.string()+".exr",format);
+		saveScreenShot(m_tonemapOutput.get(),filename_wo_ext.string()+".exr");
 	if (m_albedoRslv)
-		ext::ScreenShot::createScreenShot(m_driver,m_assetManager,m_albedoRslv.get(),filename_wo_ext.string()+"_albedo.exr",format);
+		saveScreenShot(m_albedoRslv.get(),filename_wo_ext.string()+"_albedo.exr");
 	if (m_normalRslv)
-		ext::ScreenShot::createScreenShot(m_driver,m_assetManager,m_normalRslv.get(),filename_wo_ext.string()+"_normal.exr",format);
+		saveScreenShot(m_normalRslv.get(),filename_wo_ext.string()+"_normal.exr");
 
 	if(denoise)
 	{
@@ -8,6 +8,8 @@
 
 #include "nbl/ext/MitsubaLoader/CMitsubaLoader.h"
 
+#include "LightSampling.h"
+
 #include <ISceneManager.h>
 
 #ifdef _NBL_BUILD_OPTIX_
@@ -96,6 +98,8 @@ class Renderer : public nbl::core::IReferenceCounted, public nbl::core::Interfac
     protected:
         ~Renderer();
 
+		// O(1) light selection instead of a binary search over `lightCDF`, not consumed by the shaders yet
+		static inline constexpr bool BuildLightAliasTable = false;
 		struct InitializationData
 		{
 			InitializationData() : lights(),lightCDF() {}
@@ -109,10 +113,12 @@ class Renderer : public nbl::core::IReferenceCounted, public nbl::core::Interfac
 			{
 				lights = std::move(other.lights);
 				lightCDF = std::move(other.lightCDF);
+				lightAliasTable = std::move(other.lightAliasTable);
 				return *this;
 			}
 
 			nbl::core::vector<SLight> lights;
+			nbl::core::vector<light_sampling::SAliasTableEntry> lightAliasTable;
 			union
 			{
 				nbl::core::vector<float> lightPDF;
@@ -168,15 +174,35 @@ class Renderer : public nbl::core::IReferenceCounted, public nbl::core::Interfac
 		struct SampleSequence
 		{
 			public:
-				static inline constexpr auto QuantizedDimensionsBytesize = sizeof(uint64_t);
+				static inline constexpr auto QuantizedDimensionsBytesize = sizeof(uint64_t); // same as `sample_sequence::QuantizedDimensionsBytesize`
+				static inline constexpr uint32_t OwenSamplerSeed = 0xdeadbeefu;
 				SampleSequence() : bufferView() {}
 
+				// cache file layout, followed by `sampleCount*quantizedDimensions` quantized samples in the same memory order as the GPU buffer
+				struct SCacheHeader
+				{
+					static inline constexpr uint32_t Magic = 0x51455342u; // "BSEQ"
+					static inline constexpr uint32_t Version = 1u;
+
+					uint32_t magic;
+					uint32_t version;
+					uint32_t seed;
+					uint32_t quantizedDimensions;
+					uint32_t sampleCount;
+					uint32_t padding;
+					uint64_t checksum; // of the payload
+				};
+
 				// one less because first path vertex uses a different sequence 
 				static inline uint32_t computeQuantizedDimensions(uint32_t maxPathDepth) {return (maxPathDepth-1)*SAMPLING_STRATEGY_COUNT;}
 				nbl::core::smart_refctd_ptr<nbl::asset::ICPUBuffer> createCPUBuffer(uint32_t quantizedDimensions, uint32_t sampleCount);
 
 				// from cache
 				void createBufferView(nbl::video::IVideoDriver* driver, nbl::core::smart_refctd_ptr<nbl::asset::ICPUBuffer>&& buff);
+				void createBufferView(nbl::video::IVideoDriver* driver, const void* data, size_t bytesize);
+				// memory maps the cache, a cache with more samples or dimensions is used as a prefix, returns false if it had to be regenerated
+				bool createBufferViewFromCache(nbl::video::IVideoDriver* driver, const nbl::io::path& cachePath, uint32_t quantizedDimensions, uint32_t sampleCount);
+				static void writeCache(nbl::io::IFileSystem* filesystem, const nbl::io::path& cachePath, const nbl::asset::ICPUBuffer* buff, uint32_t quantizedDimensions, uint32_t sampleCount);
 				// regenerate
 				nbl::core::smart_refctd_ptr<nbl::asset::ICPUBuffer> createBufferView(nbl::video::IVideoDriver* driver, uint32_t quantizedDimensions, uint32_t sampleCount);
 
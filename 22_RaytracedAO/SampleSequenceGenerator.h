@@ -0,0 +1,82 @@
+#ifndef _SAMPLE_SEQUENCE_GENERATOR_INCLUDED_
+#define _SAMPLE_SEQUENCE_GENERATOR_INCLUDED_
+
+#include "nabla.h"
+
+#include <cstring>
+
+
+// Quantized Owen scrambled sequence used by the path tracer, kept free of any driver objects so it can be benchmarked on its own.
+// Memory Order: 3 Dimensions, then multiple of sampling stragies per vertex, then depth, then sample ID
+namespace sample_sequence
+{
+	static inline constexpr size_t QuantizedDimensionsBytesize = sizeof(uint64_t);
+	static inline constexpr uint32_t DimensionsPerQuanta = 3u;
+
+	// first two dimensions keep their top 21 bits, the third gets split between the low 11 bits of both
+	inline void quantize(uint32_t (&out)[2], const uint32_t first, const uint32_t second, const uint32_t third)
+	{
+		out[0] = (first&0xFFFFF800u)|(third>>21);
+		out[1] = (second&0xFFFFF800u)|((third>>10)&0x07FFu);
+	}
+
+	// One sampler going through all the dimensions, the horrible order of iteration over output memory is caused by the fact that certain samplers like the
+	// Owen Scramble sampler, have a large cache which needs to be generated separately for each dimension.
+	inline void generateSerial(uint32_t (*pout)[2], const uint32_t quantizedDimensions, const uint32_t sampleCount, const uint32_t seed)
+	{
+		nbl::core::OwenSampler sampler(quantizedDimensions*DimensionsPerQuanta,seed);
+		for (auto metadim=0u; metadim<quantizedDimensions; metadim++)
+		{
+			const auto trudim = metadim*DimensionsPerQuanta;
+			for (uint32_t i=0; i<sampleCount; i++)
+				pout[i*quantizedDimensions+metadim][0] = sampler.sample(trudim+0u,i);
+			for (uint32_t i=0; i<sampleCount; i++)
+				pout[i*quantizedDimensions+metadim][1] = sampler.sample(trudim+1u,i);
+			for (uint32_t i=0; i<sampleCount; i++)
+			{
+				auto& out = pout[i*quantizedDimensions+metadim];
+				quantize(out,out[0],out[1],sampler.sample(trudim+2u,i));
+			}
+		}
+	}
+
+	// Same output as `generateSerial`, the quantized dimensions get split into runs of adjacent ones which are generated in parallel, each with its own sampler
+	// (a sampler can only step forward through the dimensions). A run generates all of its quanta into its own buffer laid out like the output,
+	// then copies every sample's block out in one go, so the output gets written once and contiguously instead of with a stride per dimension.
+	// Runs are a cache line of quanta wide: narrower ones would make neighbouring threads write the same lines of every sample, wider ones only
+	// grow the buffers. Unless a sample's row is a whole number of cache lines, neighbouring runs still share the one line straddling their boundary.
+	inline void generate(uint32_t (*pout)[2], const uint32_t quantizedDimensions, const uint32_t sampleCount, const uint32_t seed)
+	{
+		constexpr uint32_t QuantaPerRun = 64u/QuantizedDimensionsBytesize;
+
+		nbl::core::vector<uint32_t> runs;
+		for (uint32_t metadim=0u; metadim<quantizedDimensions; metadim+=QuantaPerRun)
+			runs.push_back(metadim);
+		std::for_each(nbl::core::execution::par,runs.begin(),runs.end(),[&](const uint32_t firstMetadim) -> void
+		{
+			const uint32_t lastMetadim = nbl::core::min(firstMetadim+QuantaPerRun,quantizedDimensions);
+			const uint32_t runWidth = lastMetadim-firstMetadim;
+			nbl::core::OwenSampler sampler(lastMetadim*DimensionsPerQuanta,seed);
+			nbl::core::vector<uint32_t> runStorage(size_t(sampleCount)*runWidth*2u);
+			auto* const run = reinterpret_cast<uint32_t(*)[2]>(runStorage.data());
+			for (auto metadim=firstMetadim; metadim<lastMetadim; metadim++)
+			{
+				const auto trudim = metadim*DimensionsPerQuanta;
+				auto* const quanta = run+(metadim-firstMetadim);
+				for (uint32_t i=0; i<sampleCount; i++)
+					quanta[i*runWidth][0] = sampler.sample(trudim+0u,i);
+				for (uint32_t i=0; i<sampleCount; i++)
+					quanta[i*runWidth][1] = sampler.sample(trudim+1u,i);
+				for (uint32_t i=0; i<sampleCount; i++)
+				{
+					auto& out = quanta[i*runWidth];
+					quantize(out,out[0],out[1],sampler.sample(trudim+2u,i));
+				}
+			}
+			for (uint32_t i=0; i<sampleCount; i++)
+				memcpy(pout+size_t(i)*quantizedDimensions+firstMetadim,run+size_t(i)*runWidth,runWidth*QuantizedDimensionsBytesize);
+		});
+	}
+}
+
+#endif
@@ -0,0 +1,220 @@
+// Copyright (C) 2018-2023 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+#ifndef _EXR_SPLIT_STREAMING_EXR_READER_H_INCLUDED_
+#define _EXR_SPLIT_STREAMING_EXR_READER_H_INCLUDED_
+
+#include "nabla.h"
+
+#include "../common/StreamingImageWriter.hpp"
+
+#include <filesystem>
+#include <fstream>
+
+
+// Reads the headers and chunk offset tables of a single or multi-part scanline OpenEXR file up front, then decodes any block of scanlines
+// on demand, so a file can be processed a band of rows at a time from many threads instead of decoding every part into memory at once.
+// Only handles what `nbl::examples::openexr_codec` can decode, `isValid` is false for tiled, deep or subsampled parts and other codecs.
+class CStreamingEXRReader
+{
+	public:
+		using E_COMPRESSION = nbl::examples::openexr_codec::E_COMPRESSION;
+		using E_PIXEL_TYPE = nbl::examples::CStreamingEXRWriter::E_PIXEL_TYPE;
+
+		struct SChannel
+		{
+			std::string name;
+			E_PIXEL_TYPE pixelType;
+			// where this channel's values start within a decoded scanline
+			size_t rowByteOffset;
+		};
+		struct SPart
+		{
+			inline uint32_t getBlockCount() const {return (height+rowsPerBlock-1u)/rowsPerBlock;}
+
+			// empty for single part files
+			std::string name;
+			// sorted by name, the same order the file stores the values of a scanline in
+			nbl::core::vector<SChannel> channels;
+			int32_t minY = 0;
+			uint32_t width = 0u, height = 0u;
+			E_COMPRESSION compression = nbl::examples::openexr_codec::EC_NONE;
+			uint32_t rowsPerBlock = 1u;
+			size_t rowByteSize = 0ull;
+			nbl::core::vector<uint64_t> blockOffsets;
+		};
+
+		CStreamingEXRReader(const std::filesystem::path& path) : m_path(path)
+		{
+			std::ifstream file(path,std::ios::binary);
+			m_valid = file && readHeaders(file);
+		}
+
+		inline bool isValid() const {return m_valid;}
+		inline const std::filesystem::path& getPath() const {return m_path;}
+		inline const nbl::core::vector<SPart>& getParts() const {return m_parts;}
+
+		// Decodes `rowCount` scanlines of `partIx` starting at `firstRow` (relative to the top of the data window) into `outLines`,
+		// laid out like the file stores them. The band has to start on a block boundary, `file` is the caller's own stream of `getPath()`
+		// so many threads can read at once.
+		bool readLines(std::ifstream& file, const uint32_t partIx, const uint32_t firstRow, const uint32_t rowCount, uint8_t* outLines) const
+		{
+			if (!m_valid || partIx>=m_parts.size())
+				return false;
+			const auto& part = m_parts[partIx];
+			if (rowCount==0u || firstRow%part.rowsPerBlock || firstRow+rowCount>part.height)
+				return false;
+
+			nbl::core::vector<uint8_t> data;
+			for (uint32_t blockRow=0u; blockRow<rowCount; blockRow+=part.rowsPerBlock)
+			{
+				const uint32_t blockIx = (firstRow+blockRow)/part.rowsPerBlock;
+				const uint32_t blockRowCount = std::min(part.rowsPerBlock,part.height-blockIx*part.rowsPerBlock);
+				// a band which ends inside a block can't be decoded without the rest of the block
+				if (blockRow+blockRowCount>rowCount)
+					return false;
+				const size_t rawSize = part.rowByteSize*blockRowCount;
+
+				file.clear();
+				file.seekg(part.blockOffsets[blockIx]);
+				if (m_multiPart && readLE<uint32_t>(file)!=partIx)
+					return false;
+				const int32_t y = static_cast<int32_t>(readLE<uint32_t>(file));
+				const uint32_t dataSize = readLE<uint32_t>(file);
+				// the codecs only ever store a block raw when they can't make it smaller
+				if (!file || y!=part.minY+static_cast<int32_t>(blockIx*part.rowsPerBlock) || dataSize>rawSize)
+					return false;
+
+				data.resize(dataSize);
+				if (!file.read(reinterpret_cast<char*>(data.data()),dataSize))
+					return false;
+				if (!nbl::examples::openexr_codec::decompress(part.compression,data.data(),dataSize,outLines+part.rowByteSize*blockRow,rawSize))
+					return false;
+			}
+			return true;
+		}
+
+	private:
+		static inline constexpr uint32_t TiledFlag = 0x200u;
+		static inline constexpr uint32_t NonImageFlag = 0x800u;
+		static inline constexpr uint32_t MultiPartFlag = 0x1000u;
+
+		template<typename T>
+		static inline T readLE(std::istream& in)
+		{
+			uint8_t bytes[sizeof(T)] = {};
+			in.read(reinterpret_cast<char*>(bytes),sizeof(T));
+			uint64_t value = 0ull;
+			for (uint32_t i=0u; i<sizeof(T); i++)
+				value |= uint64_t(bytes[i])<<(i*8u);
+			return static_cast<T>(value);
+		}
+		static inline std::string readString(std::istream& in)
+		{
+			std::string str;
+			std::getline(in,str,'\0');
+			return str;
+		}
+
+		bool readHeaders(std::ifstream& file)
+		{
+			if (readLE<uint32_t>(file)!=20000630u)
+				return false;
+			const uint32_t version = readLE<uint32_t>(file);
+			if ((version&0xffu)!=2u || (version&(TiledFlag|NonImageFlag)))
+				return false;
+			m_multiPart = version&MultiPartFlag;
+
+			// multi-part files have a header per part and an empty header after the last one
+			do
+			{
+				auto& part = m_parts.emplace_back();
+				if (!readHeader(file,part))
+					return false;
+			} while (m_multiPart && file.peek()!=0);
+			if (m_multiPart)
+				file.get();
+
+			for (auto& part : m_parts)
+			{
+				part.blockOffsets.resize(part.getBlockCount());
+				for (auto& offset : part.blockOffsets)
+					offset = readLE<uint64_t>(file);
+			}
+			return bool(file);
+		}
+
+		bool readHeader(std::ifstream& file, SPart& part)
+		{
+			bool hasChannels = false, hasCompression = false, hasDataWindow = false;
+			for (std::string name=readString(file); file && !name.empty(); name=readString(file))
+			{
+				const std::string type = readString(file);
+				const uint32_t size = readLE<uint32_t>(file);
+				const auto valueEnd = file.tellg()+std::streamoff(size);
+				if (name=="channels" && type=="chlist")
+				{
+					for (std::string channelName=readString(file); file && !channelName.empty(); channelName=readString(file))
+					{
+						const uint32_t pixelType = readLE<uint32_t>(file);
+						readLE<uint32_t>(file); // pLinear and reserved
+						const uint32_t xSampling = readLE<uint32_t>(file);
+						const uint32_t ySampling = readLE<uint32_t>(file);
+						if (pixelType>nbl::examples::CStreamingEXRWriter::EPT_FLOAT || xSampling!=1u || ySampling!=1u)
+							return false;
+						part.channels.push_back({channelName,static_cast<E_PIXEL_TYPE>(pixelType),0ull});
+					}
+					hasChannels = !part.channels.empty();
+				}
+				else if (name=="compression" && type=="compression")
+				{
+					part.compression = static_cast<E_COMPRESSION>(file.get());
+					hasCompression = true;
+				}
+				else if (name=="dataWindow" && type=="box2i")
+				{
+					const int32_t minX = static_cast<int32_t>(readLE<uint32_t>(file));
+					const int32_t minY = static_cast<int32_t>(readLE<uint32_t>(file));
+					const int32_t maxX = static_cast<int32_t>(readLE<uint32_t>(file));
+					const int32_t maxY = static_cast<int32_t>(readLE<uint32_t>(file));
+					if (maxX<minX || maxY<minY)
+						return false;
+					part.minY = minY;
+					part.width = static_cast<uint32_t>(int64_t(maxX)-minX+1);
+					part.height = static_cast<uint32_t>(int64_t(maxY)-minY+1);
+					hasDataWindow = true;
+				}
+				else if (name=="name" && type=="string")
+				{
+					part.name.resize(size);
+					file.read(part.name.data(),size);
+				}
+				else if (name=="type" && type=="string")
+				{
+					std::string partType(size,'\0');
+					file.read(partType.data(),size);
+					if (partType!="scanlineimage")
+						return false;
+				}
+				file.seekg(valueEnd);
+			}
+			if (!file || !hasChannels || !hasCompression || !hasDataWindow || !nbl::examples::openexr_codec::isSupported(part.compression))
+				return false;
+
+			part.rowsPerBlock = nbl::examples::openexr_codec::getRowsPerBlock(part.compression);
+			// the file keeps the channels sorted already, the values of a scanline are one channel after the other
+			for (auto& channel : part.channels)
+			{
+				channel.rowByteOffset = part.rowByteSize;
+				part.rowByteSize += size_t(part.width)*(channel.pixelType==nbl::examples::CStreamingEXRWriter::EPT_HALF ? sizeof(uint16_t):sizeof(uint32_t));
+			}
+			return true;
+		}
+
+		const std::filesystem::path m_path;
+		nbl::core::vector<SPart> m_parts;
+		bool m_multiPart = false;
+		bool m_valid = false;
+};
+
+#endif
@@ -3,12 +3,41 @@
 // For conditions of distribution and use, see copyright notice in nabla.h
 
 #include "../common/MonoSystemMonoLoggerApplication.hpp"
+#include "../common/ResidentMemory.hpp"
+#include "../common/StreamingImageWriter.hpp"
+#include "StreamingEXRReader.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <regex>
+#include <sstream>
+#include <thread>
 
 using namespace nbl;
 using namespace core;
 using namespace asset;
 using namespace system;
 
+// Runs `func(index)` for every index in [0,count) on up to `threadCount` threads (including the calling one)
+template<typename F>
+void parallelFor(const uint32_t count, const uint32_t threadCount, F&& func)
+{
+	std::atomic_uint32_t next = 0u;
+	auto worker = [&]() -> void
+	{
+		for (uint32_t i = next++; i < count; i = next++)
+			func(i);
+	};
+	core::vector<std::thread> workers;
+	for (uint32_t i = 1u; i < std::min(threadCount, count); i++)
+		workers.emplace_back(worker);
+	worker();
+	for (auto& thread : workers)
+		thread.join();
+}
+
 // instead of defining our own `int main()` we derive from `nbl::system::IApplicationFramework` to play "nice" wil all platofmrs
 class HelloComputeApp final : public nbl::examples::MonoSystemMonoLoggerApplication
 {
@@ -16,6 +45,12 @@ class HelloComputeApp final : public nbl::examples::MonoSystemMonoLoggerApplicat
 public:
 	using base_t::base_t;
 
+	// Usage: EXRSplit [options] <file|directory|glob>...
+	//	-layers <name,name,...>		only extract the channel layers with these names (`COpenEXRMetadata::CImage::m_name`)
+	//	-compression <none|zip|piz|dwaa>	OpenEXR codec of the written layers, defaults to none (piz and dwaa aren't implemented yet)
+	//	-jobs <N>					how many files to process at once, defaults to the hardware concurrency
+	//	-output <directory>			where to write the layers, defaults to CWD
+	//	-benchmark_writer			compare writing a synthetic panorama whole against streaming it in row bands, then exit
 	bool onAppInitialized(smart_refctd_ptr<ISystem>&& system) override
 	{
 		if (!base_t::onAppInitialized(std::move(system)))
@@ -23,94 +58,708 @@ public:
 
 		constexpr std::string_view defaultImagePath = "../../media/noises/spp_benchmark_4k_512.exr";
 
-		const auto targetFilePath = [&]() -> std::string_view
+		SSplitOptions options;
+		uint32_t jobCount = std::max(std::thread::hardware_concurrency(), 1u);
+		core::vector<std::string> targetFilePaths;
+		bool benchmarkWriter = false;
+		for (auto it = std::next(argv.begin()); it != argv.end(); it++)
 		{
-			const auto argc = argv.size();
-			const bool isDefaultImageRequested = argc == 1;
-
-			if (isDefaultImageRequested)
+			const bool hasValue = std::next(it) != argv.end();
+			if (*it == "-layers" && hasValue)
 			{
-				m_logger->log("No image specified, loading default \"%s\" OpenEXR image from media directory!", ILogger::ELL_INFO, defaultImagePath.data());
-				return defaultImagePath;
+				std::stringstream names(*(++it));
+				for (std::string name; std::getline(names, name, ',');)
+					options.layerFilter.insert(name);
 			}
-			else if (argc == 2)
+			else if (*it == "-compression" && hasValue)
 			{
-				const std::string_view target(argv[1]);
-				m_logger->log("Requested \"%s\"", ILogger::ELL_INFO, target.data());
-				return { target };
+				const std::string& name = *(++it);
+				if (!parseCompression(name, options.compression))
+					return logFail("Unknown compression \"%s\", expected none, zip, piz or dwaa!", name.c_str());
+				if (!examples::openexr_codec::isSupported(options.compression))
+					return logFail("Compression \"%s\" is not supported by the streaming OpenEXR writer yet, use none or zip!", name.c_str());
 			}
-			else
+			else if (*it == "-jobs" && hasValue)
+				jobCount = std::max(std::atoi((++it)->c_str()), 1);
+			else if (*it == "-output" && hasValue)
+				options.outputDirectory = *(++it);
+			else if (*it == "-benchmark_writer")
+				benchmarkWriter = true;
+			else if (!expandInput(*it, targetFilePaths))
+				return logFail("\"%s\" matched no files!", it->c_str());
+		}
+		if (benchmarkWriter)
+			return benchmarkStreamingWriter(options.outputDirectory);
+		if (targetFilePaths.empty())
+		{
+			m_logger->log("No image specified, loading default \"%s\" OpenEXR image from media directory!", ILogger::ELL_INFO, defaultImagePath.data());
+			targetFilePaths.emplace_back(defaultImagePath);
+		}
+		jobCount = std::min<uint32_t>(jobCount, targetFilePaths.size());
+		// files already keep the cores busy, so don't oversubscribe with per-layer threads
+		options.writerThreads = std::max(std::thread::hardware_concurrency() / jobCount, 1u);
+
+		auto assetManager = make_smart_refctd_ptr<nbl::asset::IAssetManager>(smart_refctd_ptr(m_system));
+		const auto outputStems = getOutputStems(targetFilePaths);
+
+		core::vector<SSplitStats> allStats(targetFilePaths.size());
+		const auto start = std::chrono::steady_clock::now();
+		parallelFor(static_cast<uint32_t>(targetFilePaths.size()), jobCount, [&](const uint32_t i) -> void
 			{
-				m_logger->log("To many arguments! Pass a single filename to an OpenEXR image w.r.t CWD.", ILogger::ELL_ERROR);
-				return {};
+				m_logger->log("Requested \"%s\"", ILogger::ELL_INFO, targetFilePaths[i].c_str());
+				allStats[i].success = splitFile(assetManager.get(), targetFilePaths[i], outputStems[i], options, allStats[i]);
+				logStats(targetFilePaths[i].c_str(), allStats[i]);
 			}
-		}();
+		);
+		const double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		if (targetFilePaths.size() > 1u)
+		{
+			// slowest files first, those are the ones worth looking at
+			core::vector<uint32_t> order(targetFilePaths.size());
+			std::iota(order.begin(), order.end(), 0u);
+			std::sort(order.begin(), order.end(), [&](const uint32_t lhs, const uint32_t rhs) { return allStats[lhs].getSeconds() > allStats[rhs].getSeconds(); });
+
+			SSplitStats totalStats = {};
+			uint32_t failedCount = 0u;
+			m_logger->log("Per-file summary:", ILogger::ELL_PERFORMANCE);
+			for (const auto i : order)
+			{
+				const auto& stats = allStats[i];
+				m_logger->log(
+					"\t%8.3f s (load %8.3f s, write %8.3f s) %3u layers %s \"%s\"", ILogger::ELL_PERFORMANCE,
+					stats.getSeconds(), stats.loadSeconds, stats.writeSeconds, stats.layerCount, stats.success ? "ok    " : "FAILED", targetFilePaths[i].c_str()
+				);
+				totalStats.inputBytes += stats.inputBytes;
+				totalStats.outputBytes += stats.outputBytes;
+				totalStats.layerCount += stats.layerCount;
+				totalStats.loadSeconds += stats.loadSeconds;
+				totalStats.writeSeconds += stats.writeSeconds;
+				failedCount += !stats.success;
+			}
+			logStats("all inputs", totalStats);
+			m_logger->log(
+				"Processed %zu files (%u failed) with %u jobs in %.2f s, %.1f MB/s read, %.1f MB/s written", ILogger::ELL_PERFORMANCE, targetFilePaths.size(), failedCount, jobCount,
+				wallSeconds, getMegabytesPerSecond(totalStats.inputBytes, wallSeconds), getMegabytesPerSecond(totalStats.outputBytes, wallSeconds)
+			);
+		}
+
+		return std::all_of(allStats.begin(), allStats.end(), [](const SSplitStats& stats) { return stats.success; });
+	}
+
+	void workLoopBody() override {}
+
+	bool keepRunning() override { return false; }
+
+private:
+	struct SSplitOptions
+	{
+		// empty means all layers
+		core::unordered_set<std::string> layerFilter;
+		std::filesystem::path outputDirectory;
+		examples::openexr_codec::E_COMPRESSION compression = examples::openexr_codec::EC_NONE;
+		uint32_t writerThreads = 1u;
+	};
+
+	// when a file gets streamed `loadSeconds` only covers its headers, reading and decoding the bands overlaps the writes and counts towards `writeSeconds`
+	struct SSplitStats
+	{
+		inline double getSeconds() const { return loadSeconds + writeSeconds; }
+
+		uint64_t inputBytes = 0ull;
+		uint64_t outputBytes = 0ull;
+		uint32_t layerCount = 0u;
+		double loadSeconds = 0.0;
+		double writeSeconds = 0.0;
+		bool success = false;
+	};
 
-		if (targetFilePath.empty())
+	// knows every name `-compression` documents, whether the writer implements the codec is checked separately
+	static bool parseCompression(const std::string& name, examples::openexr_codec::E_COMPRESSION& outCompression)
+	{
+		using namespace examples::openexr_codec;
+		if (name == "none")
+			outCompression = EC_NONE;
+		else if (name == "zip")
+			outCompression = EC_ZIP;
+		else if (name == "piz")
+			outCompression = EC_PIZ;
+		else if (name == "dwaa")
+			outCompression = EC_DWAA;
+		else
 			return false;
-			
-		auto assetManager = make_smart_refctd_ptr<nbl::asset::IAssetManager>(smart_refctd_ptr(m_system));
+		return true;
+	}
 
-		nbl::asset::IAssetLoader::SAssetLoadParams lp;
-		const asset::COpenEXRMetadata* meta;
+	// an input can be a file, a directory (all the .exr files directly inside) or a glob with `*` and `?` in the filename
+	static bool expandInput(const std::string& input, core::vector<std::string>& outPaths)
+	{
+		const std::filesystem::path path(input);
+		std::error_code ec;
+		if (std::filesystem::is_regular_file(path, ec))
+		{
+			outPaths.push_back(input);
+			return true;
+		}
 
-		auto image_bundle = assetManager->getAsset(targetFilePath.data(), lp);
-		auto contents = image_bundle.getContents();
+		std::filesystem::path directory = path;
+		std::regex pattern(".*\\.[eE][xX][rR]");
+		if (!std::filesystem::is_directory(path, ec))
 		{
-			if (contents.empty())
-			{
-				m_logger->log("Could not load \"%s\"", ILogger::ELL_ERROR, targetFilePath.data());
+			const std::string filenamePattern = path.filename().string();
+			if (filenamePattern.find_first_of("*?") == std::string::npos)
 				return false;
+			directory = path.has_parent_path() ? path.parent_path() : std::filesystem::path(".");
+
+			std::string regex;
+			for (const char c : filenamePattern)
+			{
+				if (c == '*')
+					regex += ".*";
+				else if (c == '?')
+					regex += '.';
+				else if (std::strchr("\\^$.|+()[]{}", c))
+					regex += std::string("\\") + c;
+				else
+					regex += c;
 			}
+			pattern = std::regex(regex);
+		}
 
-			meta = image_bundle.getMetadata()->selfCast<const COpenEXRMetadata>();
+		const size_t oldCount = outPaths.size();
+		for (const auto& entry : std::filesystem::directory_iterator(directory, ec))
+		if (entry.is_regular_file(ec) && std::regex_match(entry.path().filename().string(), pattern))
+			outPaths.push_back(entry.path().string());
+		// directory iteration order is unspecified, keep runs reproducible
+		std::sort(outPaths.begin() + oldCount, outPaths.end());
+		return outPaths.size() != oldCount;
+	}
 
-			if (!meta)
+	// Output files are named after their input, inputs sharing a file name (from different directories) get their parent directory's name
+	// as a prefix so they don't overwrite each other's layers, or their position among the inputs if even that isn't unique
+	static core::vector<std::string> getOutputStems(const core::vector<std::string>& paths)
+	{
+		core::vector<std::string> stems;
+		core::unordered_map<std::string, uint32_t> counts;
+		for (const auto& path : paths)
+			counts[stems.emplace_back(std::filesystem::path(path).stem().string())]++;
+		for (size_t i = 0u; i < paths.size(); i++)
+		if (counts[stems[i]] > 1u)
+			stems[i] = std::filesystem::path(paths[i]).parent_path().filename().string() + "_" + stems[i];
+
+		counts.clear();
+		for (const auto& stem : stems)
+			counts[stem]++;
+		for (size_t i = 0u; i < paths.size(); i++)
+		if (counts[stems[i]] > 1u)
+			stems[i] = std::to_string(i) + "_" + stems[i];
+		return stems;
+	}
+
+	static double getMegabytesPerSecond(const uint64_t bytes, const double seconds)
+	{
+		return seconds > 0.0 ? double(bytes) / seconds * 1e-6 : 0.0;
+	}
+
+	static uint64_t getFileSize(const std::filesystem::path& path)
+	{
+		std::error_code ec;
+		const auto size = std::filesystem::file_size(path, ec);
+		return ec ? 0ull : size;
+	}
+
+	void logStats(const char* name, const SSplitStats& stats)
+	{
+		m_logger->log(
+			"\"%s\": %u layers, load %.2f s (%.1f MB/s), write %.2f s (%.1f MB/s)", ILogger::ELL_PERFORMANCE, name, stats.layerCount,
+			stats.loadSeconds, getMegabytesPerSecond(stats.inputBytes, stats.loadSeconds), stats.writeSeconds, getMegabytesPerSecond(stats.outputBytes, stats.writeSeconds)
+		);
+	}
+
+	// Writes a synthetic 16K panorama, produced in bands of rows like a renderer would, once by filling a whole `ICPUImage` for `writeAsset`
+	// and then through the streaming writers (uncompressed and ZIP OpenEXR, PNG), reporting time to disk and how much the resident memory grew for each.
+	// The streamed OpenEXR files get loaded back and compared.
+	bool benchmarkStreamingWriter(const std::filesystem::path& outputDirectory)
+	{
+		constexpr uint32_t Width = 16384u;
+		constexpr uint32_t Height = 8192u;
+		constexpr uint32_t ChannelCount = 4u;
+		constexpr uint32_t BandHeight = 64u;
+		constexpr uint32_t BandCount = (Height + BandHeight - 1u) / BandHeight;
+		const uint32_t threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+		// cheap stand-in for rendering, every value is a multiple of 1/32 below 32 so it survives the conversion to half exactly
+		auto getTexel = [](const uint32_t x, const uint32_t y, const uint32_t c) -> float { return float((x + y * 3u + c * 5u) & 0x3ffu) * (1.f / 32.f); };
+		auto produceBand = [&](const uint32_t band, core::vector<float>& out) -> uint32_t
+		{
+			const uint32_t firstRow = band * BandHeight;
+			const uint32_t rowCount = std::min(BandHeight, Height - firstRow);
+			out.resize(size_t(rowCount) * Width * ChannelCount);
+			for (uint32_t y = 0u; y < rowCount; y++)
+			for (uint32_t x = 0u; x < Width; x++)
+			for (uint32_t c = 0u; c < ChannelCount; c++)
+				out[(size_t(y) * Width + x) * ChannelCount + c] = getTexel(x, firstRow + y, c);
+			return rowCount;
+		};
+
+		auto assetManager = make_smart_refctd_ptr<nbl::asset::IAssetManager>(smart_refctd_ptr(m_system));
+		const auto wholeImagePath = outputDirectory / "streaming_benchmark_whole_image.exr";
+		// the outputs are big and only there to be timed, so each gets deleted once it's been measured
+		std::error_code ec;
+
+		size_t wholeImagePeakBytes = 0ull;
+		bool wholeImageWritten = false;
+		const double wholeImageSeconds = runAndSampleResidentMemory(wholeImagePeakBytes, [&]() -> void
 			{
-				m_logger->log("Could not selfCast \"%s\" asset's metadata to COpenEXRMetadata, the tool expects valid OpenEXR input image, terminating!", ILogger::ELL_ERROR, targetFilePath.data());
-				return false;
+				IImage::SCreationParams params = {};
+				params.flags = static_cast<IImage::E_CREATE_FLAGS>(0u);
+				params.type = IImage::ET_2D;
+				params.format = EF_R16G16B16A16_SFLOAT;
+				params.extent = { Width, Height, 1u };
+				params.mipLevels = 1u;
+				params.arrayLayers = 1u;
+				params.samples = ICPUImage::ESCF_1_BIT;
+
+				auto regions = core::make_refctd_dynamic_array<core::smart_refctd_dynamic_array<ICPUImage::SBufferCopy>>(1ull);
+				auto& region = (*regions)[0];
+				region.bufferOffset = 0ull;
+				region.bufferRowLength = Width;
+				region.bufferImageHeight = 0u;
+				region.imageSubresource = {};
+				region.imageSubresource.layerCount = 1u;
+				region.imageOffset = { 0u, 0u, 0u };
+				region.imageExtent = { Width, Height, 1u };
+
+				auto buffer = make_smart_refctd_ptr<ICPUBuffer>(size_t(Width) * Height * ChannelCount * sizeof(uint16_t));
+				uint16_t* const texels = reinterpret_cast<uint16_t*>(buffer->getPointer());
+				parallelFor(BandCount, threadCount, [&](const uint32_t band) -> void
+					{
+						core::vector<float> produced;
+						const size_t count = size_t(produceBand(band, produced)) * Width * ChannelCount;
+						uint16_t* out = texels + size_t(band) * BandHeight * Width * ChannelCount;
+						for (size_t i = 0u; i < count; i++)
+							out[i] = core::Float16Compressor::compress(produced[i]);
+					}
+				);
+				auto image = ICPUImage::create(std::move(params));
+				image->setBufferAndRegions(std::move(buffer), regions);
+
+				ICPUImageView::SCreationParams viewParams;
+				viewParams.flags = static_cast<ICPUImageView::E_CREATE_FLAGS>(0u);
+				viewParams.image = std::move(image);
+				viewParams.format = EF_R16G16B16A16_SFLOAT;
+				viewParams.viewType = ICPUImageView::ET_2D;
+				viewParams.subresourceRange = { static_cast<IImage::E_ASPECT_FLAGS>(0u),0u,1u,0u,1u };
+				auto imageView = ICPUImageView::create(std::move(viewParams));
+				wholeImageWritten = assetManager->writeAsset(wholeImagePath.string(), IAssetWriter::SAssetWriteParams(imageView.get(), EWF_BINARY, 0.f));
 			}
-		}
+		);
+		if (!wholeImageWritten)
+			m_logger->log("Could not save \"%s\"!", ILogger::ELL_ERROR, wholeImagePath.string().c_str());
 
-		uint32_t i = 0u;
-		for (auto asset : contents)
+		// the loader has to agree with the writer about every texel
+		auto loadsBackIdentical = [&](const std::filesystem::path& path) -> bool
 		{
-			auto image = IAsset::castDown<ICPUImage>(asset);
-			const auto* metadata = static_cast<const COpenEXRMetadata::CImage*>(meta->getAssetSpecificMetadata(image.get()));
+			constexpr auto cachingFlags = static_cast<IAssetLoader::E_CACHING_FLAGS>(IAssetLoader::ECF_DONT_CACHE_REFERENCES | IAssetLoader::ECF_DONT_CACHE_TOP_LEVEL);
+			auto bundle = assetManager->getAsset(path.string(), IAssetLoader::SAssetLoadParams(0ull, nullptr, cachingFlags));
+			auto contents = bundle.getContents();
+			if (contents.empty())
+				return false;
+			auto image = IAsset::castDown<ICPUImage>(*contents.begin());
+			const auto& params = image->getCreationParameters();
+			if (params.format != EF_R16G16B16A16_SFLOAT || params.extent.width != Width || params.extent.height != Height)
+				return false;
 
-			ICPUImageView::SCreationParams imgViewParams;
-			imgViewParams.flags = static_cast<ICPUImageView::E_CREATE_FLAGS>(0u);
-			imgViewParams.image = std::move(image);
-			imgViewParams.format = imgViewParams.image->getCreationParameters().format;
-			imgViewParams.viewType = ICPUImageView::ET_2D;
-			imgViewParams.subresourceRange = { static_cast<IImage::E_ASPECT_FLAGS>(0u),0u,1u,0u,1u };
+			const uint16_t* texels = reinterpret_cast<const uint16_t*>(image->getBuffer()->getPointer());
+			std::atomic_bool mismatch = false;
+			parallelFor(Height, threadCount, [&](const uint32_t y) -> void
+				{
+					for (uint32_t x = 0u; x < Width; x++)
+					for (uint32_t c = 0u; c < ChannelCount; c++)
+						if (texels[(size_t(y) * Width + x) * ChannelCount + c] != core::Float16Compressor::compress(getTexel(x, y, c)))
+							mismatch = true;
+				}
+			);
+			return !mismatch;
+		};
 
-			auto imageView = ICPUImageView::create(std::move(imgViewParams));
-			auto channelsName = metadata->m_name;
+		bool success = wholeImageWritten;
+		m_logger->log(
+			"%ux%u RGBA16F whole image + writeAsset: %.2f s to disk, +%.1f MB resident, %.1f MB file", ILogger::ELL_PERFORMANCE,
+			Width, Height, wholeImageSeconds, double(wholeImagePeakBytes) * 1e-6, double(getFileSize(wholeImagePath)) * 1e-6
+		);
+		std::filesystem::remove(wholeImagePath, ec);
 
-			std::filesystem::path filename, extension;
-			core::splitFilename(targetFilePath.data(), nullptr, &filename, &extension);
+		// bands get produced and encoded on all threads, with ZIP the encode is most of the work
+		for (const auto compression : { examples::openexr_codec::EC_NONE, examples::openexr_codec::EC_ZIP })
+		{
+			const auto streamedPath = outputDirectory / "streaming_benchmark_streamed.exr";
+			size_t streamedPeakBytes = 0ull;
+			bool streamed = false;
+			const double streamedSeconds = runAndSampleResidentMemory(streamedPeakBytes, [&]() -> void
+				{
+					examples::CStreamingEXRWriter writer(streamedPath, Width, Height, ChannelCount, examples::CStreamingEXRWriter::EPT_HALF, compression);
+					if (!writer.isValid())
+						return;
+					std::atomic_bool failed = false;
+					parallelFor(BandCount, threadCount, [&](const uint32_t band) -> void
+						{
+							core::vector<float> produced;
+							const uint32_t rowCount = produceBand(band, produced);
+							if (!writer.writeRows(band * BandHeight, rowCount, produced.data(), size_t(Width) * ChannelCount))
+								failed = true;
+						}
+					);
+					streamed = writer.finish() && !failed;
+				}
+			);
 
-			const std::string finalFileNameWithExtension = filename.string() + extension.string();
-			const std::string finalOutputPath = channelsName.empty() ? (filename.string() + "_" + std::to_string(i++) + extension.string()) : (filename.string() + "_" + channelsName + extension.string());
+			const char* compressionName = compression == examples::openexr_codec::EC_NONE ? "uncompressed" : "ZIP";
+			if (!streamed)
+				m_logger->log("Could not stream \"%s\" %s!", ILogger::ELL_ERROR, streamedPath.string().c_str(), compressionName);
+			else if (!loadsBackIdentical(streamedPath))
+				m_logger->log("%s \"%s\" doesn't load back as the texels that were streamed!", ILogger::ELL_ERROR, compressionName, streamedPath.string().c_str());
+			else
+				m_logger->log(
+					"%ux%u RGBA16F streamed %s in %u row bands: %.2f s to disk, +%.1f MB resident, %.1f MB file", ILogger::ELL_PERFORMANCE,
+					Width, Height, compressionName, BandHeight, streamedSeconds, double(streamedPeakBytes) * 1e-6, double(getFileSize(streamedPath)) * 1e-6
+				);
+			success = success && streamed;
+			std::filesystem::remove(streamedPath, ec);
+		}
 
-			const auto writeParams = IAssetWriter::SAssetWriteParams(imageView.get(), EWF_BINARY);
-			if (assetManager->writeAsset(finalOutputPath, writeParams))
-				m_logger->log("Saved \"%s\"!", ILogger::ELL_INFO, finalOutputPath.c_str());
+		// tonemapped 8 bit output of the same panorama, like a screenshot would be
+		{
+			const auto pngPath = outputDirectory / "streaming_benchmark_streamed.png";
+			size_t pngPeakBytes = 0ull;
+			bool streamed = false;
+			const double pngSeconds = runAndSampleResidentMemory(pngPeakBytes, [&]() -> void
+				{
+					examples::CStreamingPNGWriter writer(pngPath, Width, Height, ChannelCount);
+					if (!writer.isValid())
+						return;
+					std::atomic_bool failed = false;
+					parallelFor(BandCount, threadCount, [&](const uint32_t band) -> void
+						{
+							core::vector<float> produced;
+							const uint32_t rowCount = produceBand(band, produced);
+							core::vector<uint8_t> tonemapped(produced.size());
+							for (size_t i = 0u; i < produced.size(); i++)
+								tonemapped[i] = static_cast<uint8_t>(std::min(produced[i] / (1.f + produced[i]), 1.f) * 255.f + 0.5f);
+							if (!writer.writeRows(band * BandHeight, rowCount, tonemapped.data(), size_t(Width) * ChannelCount))
+								failed = true;
+						}
+					);
+					streamed = writer.finish() && !failed;
+				}
+			);
+			if (streamed)
+				m_logger->log(
+					"%ux%u RGBA8 PNG streamed in %u row bands: %.2f s to disk, +%.1f MB resident, %.1f MB file", ILogger::ELL_PERFORMANCE,
+					Width, Height, BandHeight, pngSeconds, double(pngPeakBytes) * 1e-6, double(getFileSize(pngPath)) * 1e-6
+				);
 			else
-			{
-				m_logger->log("Could not save \"%s\", terminating!", ILogger::ELL_ERROR, finalOutputPath.c_str());
+				m_logger->log("Could not stream \"%s\"!", ILogger::ELL_ERROR, pngPath.string().c_str());
+			success = success && streamed;
+			std::filesystem::remove(pngPath, ec);
+		}
+		return success;
+	}
+
+	// returns the seconds `func` took
+	template<typename F>
+	static double runAndSampleResidentMemory(size_t& outPeakGrowthBytes, F&& func)
+	{
+		examples::CResidentMemorySampler sampler;
+		const auto start = std::chrono::steady_clock::now();
+		func();
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		sampler.stop();
+		outPeakGrowthBytes = sampler.getPeakGrowth();
+		return seconds;
+	}
+
+	// Streams one decoded layer into `outputPath`, the texels get copied into the file layout and encoded a block of rows at a time
+	static bool writeLayer(const ICPUImage* image, const std::filesystem::path& outputPath, const examples::openexr_codec::E_COMPRESSION compression)
+	{
+		using writer_t = examples::CStreamingEXRWriter;
+		const auto& params = image->getCreationParameters();
+		const uint32_t channelCount = getFormatChannelCount(params.format);
+		if (channelCount == 0u || channelCount > 4u || isBlockCompressionFormat(params.format) || image->getRegions().size() != 1u)
+			return false;
+		const size_t texelBytes = getTexelOrBlockBytesize(params.format);
+		const size_t channelBytes = texelBytes / channelCount;
+
+		writer_t::E_PIXEL_TYPE pixelType;
+		if (isIntegerFormat(params.format) && channelBytes == sizeof(uint32_t))
+			pixelType = writer_t::EPT_UINT;
+		else if (isFloatingPointFormat(params.format) && channelBytes == sizeof(uint16_t))
+			pixelType = writer_t::EPT_HALF;
+		else if (isFloatingPointFormat(params.format) && channelBytes == sizeof(float))
+			pixelType = writer_t::EPT_FLOAT;
+		else
+			return false;
+
+		const uint32_t width = params.extent.width;
+		const uint32_t height = params.extent.height;
+		writer_t writer(outputPath, width, height, channelCount, pixelType, compression);
+		if (!writer.isValid())
+			return false;
+
+		const auto& region = image->getRegions().begin()[0];
+		const size_t rowPitch = size_t(region.bufferRowLength ? region.bufferRowLength : width) * texelBytes;
+		const auto* texels = reinterpret_cast<const uint8_t*>(image->getBuffer()->getPointer()) + region.bufferOffset;
+		const uint32_t rowsPerBlock = writer.getRowsPerBlock();
+		core::vector<uint8_t> lines(writer.getRowByteSize() * rowsPerBlock);
+		for (uint32_t firstRow = 0u; firstRow < height; firstRow += rowsPerBlock)
+		{
+			const uint32_t rowCount = std::min(rowsPerBlock, height - firstRow);
+			uint8_t* out = lines.data();
+			for (uint32_t y = firstRow; y < firstRow + rowCount; y++)
+			// the channels are named R, G, B and A and the file sorts them by name, which is the reverse order
+			for (uint32_t c = channelCount; c-- > 0u;)
+			for (uint32_t x = 0u; x < width; x++, out += channelBytes)
+				memcpy(out, texels + y * rowPitch + x * texelBytes + c * channelBytes, channelBytes);
+			if (!writer.writeLines(firstRow, rowCount, lines.data()))
 				return false;
-			}		
 		}
+		return writer.finish();
+	}
+
+	// Writes every requested channel layer of one EXR into its own file
+	bool splitFile(IAssetManager* assetManager, const std::string& targetFilePath, const std::string& outputStem, const SSplitOptions& options, SSplitStats& stats)
+	{
+		const auto loadStart = std::chrono::steady_clock::now();
+		CStreamingEXRReader reader(targetFilePath);
+		if (reader.isValid())
+			return streamSplitFile(reader, loadStart, outputStem, options, stats);
+		m_logger->log("\"%s\" has parts the streaming reader can't decode, loading it whole", ILogger::ELL_INFO, targetFilePath.c_str());
+		return loadAndSplitFile(assetManager, targetFilePath, outputStem, options, stats);
+	}
+
+	// Reads the file a band of rows at a time on `options.writerThreads` threads and hands every band to all the layers it contains,
+	// so besides the headers only the bands in flight are ever in memory instead of every decoded part.
+	bool streamSplitFile(const CStreamingEXRReader& reader, const std::chrono::steady_clock::time_point loadStart, const std::string& outputStem, const SSplitOptions& options, SSplitStats& stats)
+	{
+		using writer_t = examples::CStreamingEXRWriter;
+		// a multiple of every codec's block height, so bands never split a block of the input or of the output
+		constexpr uint32_t BandHeight = 64u;
+
+		struct SLayer
+		{
+			uint32_t partIx;
+			// into the part's channels, sorted by name like the file stores them
+			core::vector<uint32_t> channels;
+			std::string outputPath;
+			std::unique_ptr<writer_t> writer;
+		};
+		core::vector<SLayer> layers;
+
+		const std::string targetFilePath = reader.getPath().string();
+		const auto extension = reader.getPath().extension().string();
+		const auto& parts = reader.getParts();
+		uint32_t unnamedCount = 0u;
+		for (uint32_t partIx = 0u; partIx < parts.size(); partIx++)
+		{
+			const auto& part = parts[partIx];
+			// channels named "layer.channel" belong to "layer", the rest to the part (which has a name in multi-part files)
+			core::map<std::string, core::vector<uint32_t>> layerChannels;
+			for (uint32_t channelIx = 0u; channelIx < part.channels.size(); channelIx++)
+			{
+				const auto& name = part.channels[channelIx].name;
+				const auto separator = name.rfind('.');
+				layerChannels[separator != std::string::npos ? name.substr(0u, separator) : part.name].push_back(channelIx);
+			}
+
+			for (auto& [layerName, channels] : layerChannels)
+			{
+				const std::string layerSuffix = layerName.empty() ? std::to_string(unnamedCount++) : layerName;
+				if (!options.layerFilter.empty() && options.layerFilter.find(layerName) == options.layerFilter.end())
+					continue;
+
+				core::vector<writer_t::SChannel> outputChannels;
+				for (const auto channelIx : channels)
+				{
+					const auto& channel = part.channels[channelIx];
+					const auto separator = channel.name.rfind('.');
+					outputChannels.push_back({ separator != std::string::npos ? channel.name.substr(separator + 1u) : channel.name, channel.pixelType });
+				}
+
+				auto& layer = layers.emplace_back();
+				layer.partIx = partIx;
+				layer.channels = std::move(channels);
+				layer.outputPath = (options.outputDirectory / (outputStem + "_" + layerSuffix + extension)).string();
+				layer.writer = std::make_unique<writer_t>(layer.outputPath, part.width, part.height, std::move(outputChannels), options.compression);
+				if (!layer.writer->isValid())
+				{
+					m_logger->log("Could not open \"%s\" for writing, terminating!", ILogger::ELL_ERROR, layer.outputPath.c_str());
+					return false;
+				}
+			}
+		}
+		stats.loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+		stats.layerCount = static_cast<uint32_t>(layers.size());
+		stats.inputBytes = getFileSize(targetFilePath);
+		if (layers.empty())
+			m_logger->log("\"%s\" has none of the requested layers", ILogger::ELL_WARNING, targetFilePath.c_str());
+
+		struct SBand
+		{
+			uint32_t partIx;
+			uint32_t firstRow;
+		};
+		core::vector<SBand> bands;
+		for (uint32_t partIx = 0u; partIx < parts.size(); partIx++)
+		if (std::any_of(layers.begin(), layers.end(), [partIx](const SLayer& layer) { return layer.partIx == partIx; }))
+		for (uint32_t firstRow = 0u; firstRow < parts[partIx].height; firstRow += BandHeight)
+			bands.push_back({ partIx,firstRow });
+
+		// bands get picked up roughly in order, so the writers never have to hold many finished blocks back
+		const auto writeStart = std::chrono::steady_clock::now();
+		std::atomic_bool failed = false;
+		parallelFor(static_cast<uint32_t>(bands.size()), options.writerThreads, [&](const uint32_t bandIx) -> void
+			{
+				if (failed)
+					return;
+				const auto& band = bands[bandIx];
+				const auto& part = parts[band.partIx];
+				const uint32_t rowCount = std::min(BandHeight, part.height - band.firstRow);
+
+				std::ifstream file(reader.getPath(), std::ios::binary);
+				core::vector<uint8_t> lines(part.rowByteSize * rowCount);
+				if (!file || !reader.readLines(file, band.partIx, band.firstRow, rowCount, lines.data()))
+				{
+					m_logger->log("Could not decode rows %u to %u of \"%s\", terminating!", ILogger::ELL_ERROR, band.firstRow, band.firstRow + rowCount, targetFilePath.c_str());
+					failed = true;
+					return;
+				}
+
+				core::vector<uint8_t> layerLines;
+				for (auto& layer : layers)
+				{
+					if (layer.partIx != band.partIx)
+						continue;
+					layerLines.resize(layer.writer->getRowByteSize() * rowCount);
+					uint8_t* out = layerLines.data();
+					for (uint32_t row = 0u; row < rowCount; row++)
+					for (const auto channelIx : layer.channels)
+					{
+						const auto& channel = part.channels[channelIx];
+						const size_t byteSize = size_t(part.width) * (channel.pixelType == writer_t::EPT_HALF ? sizeof(uint16_t) : sizeof(uint32_t));
+						memcpy(out, lines.data() + part.rowByteSize * row + channel.rowByteOffset, byteSize);
+						out += byteSize;
+					}
+					if (!layer.writer->writeLines(band.firstRow, rowCount, layerLines.data()))
+					{
+						m_logger->log("Could not write \"%s\", terminating!", ILogger::ELL_ERROR, layer.outputPath.c_str());
+						failed = true;
+					}
+				}
+			}
+		);
+		for (auto& layer : layers)
+		{
+			if (failed || !layer.writer->finish())
+			{
+				m_logger->log("Could not save \"%s\"!", ILogger::ELL_ERROR, layer.outputPath.c_str());
+				failed = true;
+			}
+			else
+				m_logger->log("Saved \"%s\"!", ILogger::ELL_INFO, layer.outputPath.c_str());
+		}
+		stats.writeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - writeStart).count();
+		if (failed)
+			return false;
 
+		for (const auto& layer : layers)
+			stats.outputBytes += getFileSize(layer.outputPath);
 		return true;
 	}
 
-	void workLoopBody() override {}
+	// Fallback for what the streaming reader can't decode (tiled or deep parts, other codecs), the loader decodes all parts at once
+	// so peak memory is the whole file, the layers get written in parallel and each is freed as soon as its written
+	bool loadAndSplitFile(IAssetManager* assetManager, const std::string& targetFilePath, const std::string& outputStem, const SSplitOptions& options, SSplitStats& stats)
+	{
+		struct SLayer
+		{
+			smart_refctd_ptr<ICPUImage> image;
+			std::string outputPath;
+		};
+		core::vector<SLayer> layers;
 
-	bool keepRunning() override { return false; }
+		const auto loadStart = std::chrono::steady_clock::now();
+		{
+			// don't let the asset manager keep any of the images alive, we want to free each layer as soon as its written
+			constexpr auto cachingFlags = static_cast<IAssetLoader::E_CACHING_FLAGS>(IAssetLoader::ECF_DONT_CACHE_REFERENCES | IAssetLoader::ECF_DONT_CACHE_TOP_LEVEL);
+			const IAssetLoader::SAssetLoadParams lp(0ull, nullptr, cachingFlags);
 
+			auto image_bundle = assetManager->getAsset(targetFilePath, lp);
+			auto contents = image_bundle.getContents();
+			if (contents.empty())
+			{
+				m_logger->log("Could not load \"%s\"", ILogger::ELL_ERROR, targetFilePath.c_str());
+				return false;
+			}
+
+			const auto* meta = image_bundle.getMetadata() ? image_bundle.getMetadata()->selfCast<const COpenEXRMetadata>() : nullptr;
+			if (!meta)
+			{
+				m_logger->log("Could not selfCast \"%s\" asset's metadata to COpenEXRMetadata, the tool expects valid OpenEXR input image, terminating!", ILogger::ELL_ERROR, targetFilePath.c_str());
+				return false;
+			}
+
+			const auto extension = std::filesystem::path(targetFilePath).extension().string();
+
+			uint32_t i = 0u;
+			for (auto asset : contents)
+			{
+				auto image = IAsset::castDown<ICPUImage>(asset);
+				const auto* metadata = static_cast<const COpenEXRMetadata::CImage*>(meta->getAssetSpecificMetadata(image.get()));
+
+				const auto& channelsName = metadata->m_name;
+				const std::string layerSuffix = channelsName.empty() ? std::to_string(i++) : channelsName;
+				if (!options.layerFilter.empty() && options.layerFilter.find(channelsName) == options.layerFilter.end())
+					continue;
+
+				auto& layer = layers.emplace_back();
+				layer.image = std::move(image);
+				layer.outputPath = (options.outputDirectory / (outputStem + "_" + layerSuffix + extension)).string();
+			}
+			// the bundle and its metadata die here, `layers` holds the only references to the images now
+		}
+		stats.loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+		stats.layerCount = static_cast<uint32_t>(layers.size());
+		stats.inputBytes = getFileSize(targetFilePath);
+		if (layers.empty())
+			m_logger->log("\"%s\" has none of the requested layers", ILogger::ELL_WARNING, targetFilePath.c_str());
+
+		const auto writeStart = std::chrono::steady_clock::now();
+		std::atomic_bool failed = false;
+		parallelFor(static_cast<uint32_t>(layers.size()), options.writerThreads, [&](const uint32_t layerIx) -> void
+			{
+				if (failed)
+					return;
+				auto& layer = layers[layerIx];
+
+				// drop the layer as soon as its written
+				const auto image = std::move(layer.image);
+				if (writeLayer(image.get(), layer.outputPath, options.compression))
+					m_logger->log("Saved \"%s\"!", ILogger::ELL_INFO, layer.outputPath.c_str());
+				else
+				{
+					m_logger->log("Could not save \"%s\", terminating!", ILogger::ELL_ERROR, layer.outputPath.c_str());
+					failed = true;
+				}
+			}
+		);
+		stats.writeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - writeStart).count();
+		if (failed)
+			return false;
+
+		for (const auto& layer : layers)
+			stats.outputBytes += getFileSize(layer.outputPath);
+		return true;
+	}
 };
 
-NBL_MAIN_FUNC(HelloComputeApp)
\ No newline at end of file
+NBL_MAIN_FUNC(HelloComputeApp)
@@ -8,6 +8,10 @@
 #include "nbl/ext/ScreenShot/ScreenShot.h"
 #include "../common/CommonAPI.h"
 
+#include <chrono>
+#include <numeric>
+#include <thread>
+
 using namespace nbl;
 using namespace core;
 using namespace asset;
@@ -31,6 +35,7 @@ using namespace video;
 constexpr bool EXCLUSIVE_SUM = true;
 constexpr auto MIPMAP_IMAGE_VIEW = 2u;		// feel free to change the mipmap
 constexpr auto MIPMAP_IMAGE = 0u;			// ordinary image used in the example has only 0-th mipmap
+constexpr bool BENCHMARK_SAT = false;		// takes a while and needs a few GB of memory, so it's off by default
 
 /*
 	Discrete convolution for getting input image after SAT calculations
@@ -60,6 +65,200 @@ class CDiscreteConvolutionFilterKernel : public CFloatingPointSeparableImageFilt
 		}
 };
 
+/*
+	Throughput of the SAT filter on synthetic 2D images, every axis combination, format and size with `seq` and `par_unseq`.
+	The filter has to read the input and write the output at least once, so GB/s counts both and gets compared
+	against memcpy of the same amount of data, single threaded for `seq` and split over all threads for `par_unseq`.
+*/
+
+class CSummedAreaTableBenchmark
+{
+	using clock_type = std::chrono::steady_clock;
+	using SUM_FILTER = CSummedAreaTableImageFilter<EXCLUSIVE_SUM>;
+
+public:
+	CSummedAreaTableBenchmark(system::ILogger* logger) : m_logger(logger) {}
+
+	void run()
+	{
+		// 8K RGBA32F is 1GB per image, and there's an input plus an output for each policy
+		constexpr uint32_t Sizes[] = { 1024u, 4096u, 8192u };
+		constexpr std::pair<E_FORMAT, const char*> Formats[] = {
+			{ EF_R32_SFLOAT, "R32_SFLOAT" },
+			{ EF_R32G32B32A32_SFLOAT, "R32G32B32A32_SFLOAT" },
+			{ EF_R64_SFLOAT, "R64_SFLOAT" }
+		};
+		constexpr std::pair<uint8_t, const char*> AxisMasks[] = {
+			{ 0b001u, "X" },
+			{ 0b010u, "Y" },
+			{ 0b011u, "XY" }
+		};
+
+		m_logger->log("CSummedAreaTableImageFilter benchmark, %u hardware threads", system::ILogger::ELL_PERFORMANCE, std::thread::hardware_concurrency());
+
+		for (const auto& [format, formatName] : Formats)
+		for (const auto size : Sizes)
+		{
+			auto inImage = createImage(size, format);
+			auto seqOutImage = createImage(size, format);
+			auto parOutImage = createImage(size, format);
+			fillWithTestData(inImage.get());
+
+			const size_t imageBytes = inImage->getBuffer()->getSize();
+			const double gigabytesMoved = 2.0 * double(imageBytes) * 1e-9;
+			const double seqRoofline = gigabytesMoved / timeMemcpy(core::execution::seq, seqOutImage->getBuffer()->getPointer(), inImage->getBuffer()->getPointer(), imageBytes);
+			const double parRoofline = gigabytesMoved / timeMemcpy(core::execution::par, parOutImage->getBuffer()->getPointer(), inImage->getBuffer()->getPointer(), imageBytes);
+			m_logger->log("%ux%u %s: memcpy seq %.2f GB/s, par %.2f GB/s", system::ILogger::ELL_PERFORMANCE, size, size, formatName, seqRoofline, parRoofline);
+
+			for (const auto& [axesToSum, axesName] : AxisMasks)
+			{
+				const double seqSeconds = timeSum(core::execution::seq, inImage.get(), seqOutImage.get(), axesToSum);
+				const double parSeconds = timeSum(core::execution::par_unseq, inImage.get(), parOutImage.get(), axesToSum);
+				if (seqSeconds < 0.0 || parSeconds < 0.0)
+				{
+					m_logger->log("%ux%u %s sum over %s failed!", system::ILogger::ELL_ERROR, size, size, formatName, axesName);
+					continue;
+				}
+
+				// lines are independent so the policy shouldn't change the summation order, but nothing requires it to
+				if (memcmp(seqOutImage->getBuffer()->getPointer(), parOutImage->getBuffer()->getPointer(), imageBytes) != 0)
+					m_logger->log("%ux%u %s sum over %s differs between seq and par_unseq", system::ILogger::ELL_WARNING, size, size, formatName, axesName);
+
+				m_logger->log("\t%s: seq %.2f GB/s (%.0f%% of memcpy), par_unseq %.2f GB/s (%.0f%% of memcpy), %.2fx", system::ILogger::ELL_PERFORMANCE,
+					axesName, gigabytesMoved / seqSeconds, 100.0 * gigabytesMoved / seqSeconds / seqRoofline,
+					gigabytesMoved / parSeconds, 100.0 * gigabytesMoved / parSeconds / parRoofline, seqSeconds / parSeconds);
+			}
+		}
+	}
+
+private:
+	static constexpr uint32_t MaxIterations = 5u;
+	static constexpr double MinTotalSeconds = 0.5;
+
+	static core::smart_refctd_ptr<ICPUImage> createImage(const uint32_t size, const E_FORMAT format)
+	{
+		IImage::SCreationParams params = {};
+		params.flags = static_cast<IImage::E_CREATE_FLAGS>(0u);
+		params.type = IImage::ET_2D;
+		params.format = format;
+		params.extent = { size, size, 1u };
+		params.mipLevels = 1u;
+		params.arrayLayers = 1u;
+		params.samples = ICPUImage::ESCF_1_BIT;
+
+		auto regions = core::make_refctd_dynamic_array<core::smart_refctd_dynamic_array<ICPUImage::SBufferCopy>>(1ull);
+		auto& region = (*regions)[0];
+		region.bufferOffset = 0ull;
+		region.bufferRowLength = size;
+		region.bufferImageHeight = 0u;
+		region.imageSubresource = {};
+		region.imageSubresource.layerCount = 1u;
+		region.imageOffset = { 0u, 0u, 0u };
+		region.imageExtent = { size, size, 1u };
+
+		auto buffer = core::make_smart_refctd_ptr<ICPUBuffer>(size_t(size) * size * getTexelOrBlockBytesize(format));
+		auto image = ICPUImage::create(std::move(params));
+		image->setBufferAndRegions(std::move(buffer), regions);
+		return image;
+	}
+
+	// values in [0,1) from a hash of the element index, so filling the big images doesn't take longer than summing them
+	static void fillWithTestData(ICPUImage* image)
+	{
+		const bool isDouble = image->getCreationParameters().format == EF_R64_SFLOAT;
+		const size_t elementCount = image->getBuffer()->getSize() / (isDouble ? sizeof(double) : sizeof(float));
+		void* const data = image->getBuffer()->getPointer();
+
+		core::vector<size_t> chunks((elementCount + ChunkSize - 1u) / ChunkSize);
+		std::iota(chunks.begin(), chunks.end(), 0ull);
+		std::for_each(core::execution::par_unseq, chunks.begin(), chunks.end(), [&](const size_t chunk) -> void
+			{
+				const size_t end = core::min((chunk + 1u) * ChunkSize, elementCount);
+				for (size_t i = chunk * ChunkSize; i < end; i++)
+				{
+					uint32_t hash = static_cast<uint32_t>(i) * 0x9e3779b9u;
+					hash ^= hash >> 16u;
+					hash *= 0x85ebca6bu;
+					hash ^= hash >> 13u;
+					const double value = double(hash >> 8u) / double(0x1u << 24u);
+					if (isDouble)
+						reinterpret_cast<double*>(data)[i] = value;
+					else
+						reinterpret_cast<float*>(data)[i] = float(value);
+				}
+			}
+		);
+	}
+
+	// best of a few runs, or a single one when the image is big enough for that to take a while
+	template<typename ExecutionPolicy>
+	static double timeMemcpy(ExecutionPolicy&& policy, void* dst, const void* src, const size_t byteSize)
+	{
+		core::vector<size_t> chunks((byteSize + ChunkSize - 1u) / ChunkSize);
+		std::iota(chunks.begin(), chunks.end(), 0ull);
+
+		double best = std::numeric_limits<double>::max();
+		double total = 0.0;
+		for (uint32_t i = 0u; i < MaxIterations && total < MinTotalSeconds; i++)
+		{
+			const auto start = clock_type::now();
+			std::for_each(policy, chunks.begin(), chunks.end(), [&](const size_t chunk) -> void
+				{
+					const size_t offset = chunk * ChunkSize;
+					memcpy(reinterpret_cast<uint8_t*>(dst) + offset, reinterpret_cast<const uint8_t*>(src) + offset, core::min(ChunkSize, byteSize - offset));
+				}
+			);
+			const double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+			best = core::min(best, seconds);
+			total += seconds;
+		}
+		return best;
+	}
+
+	// negative on failure
+	template<typename ExecutionPolicy>
+	static double timeSum(ExecutionPolicy&& policy, ICPUImage* inImage, ICPUImage* outImage, const uint8_t axesToSum)
+	{
+		SUM_FILTER::state_type state;
+		state.inImage = inImage;
+		state.outImage = outImage;
+		state.inOffset = { 0, 0, 0 };
+		state.inBaseLayer = 0;
+		state.outOffset = { 0, 0, 0 };
+		state.outBaseLayer = 0;
+		state.extent = inImage->getCreationParameters().extent;
+		state.layerCount = 1u;
+		state.scratchMemoryByteSize = state.getRequiredScratchByteSize(state.inImage, state.extent);
+		state.scratchMemory = reinterpret_cast<uint8_t*>(_NBL_ALIGNED_MALLOC(state.scratchMemoryByteSize, 32));
+		state.axesToSum = axesToSum;
+		state.inMipLevel = 0;
+		state.outMipLevel = 0;
+
+		SUM_FILTER sumFilter;
+		double best = std::numeric_limits<double>::max();
+		double total = 0.0;
+		for (uint32_t i = 0u; i < MaxIterations && total < MinTotalSeconds; i++)
+		{
+			const auto start = clock_type::now();
+			if (!sumFilter.execute(policy, &state))
+			{
+				best = -1.0;
+				break;
+			}
+			const double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+			best = core::min(best, seconds);
+			total += seconds;
+		}
+
+		_NBL_ALIGNED_FREE(state.scratchMemory);
+		return best;
+	}
+
+	static constexpr size_t ChunkSize = 0x1ull << 20u;
+
+	system::ILogger* m_logger;
+};
+
 class SumAndCDFFilterSampleApp : public NonGraphicalApplicationBase
 {
 	core::smart_refctd_ptr<nbl::system::ISystem> system;
@@ -350,6 +549,9 @@ public:
 			asset::IAssetWriter::SAssetWriteParams wparams(cpuImageView.get());
 			assetManager->writeAsset(convolutedSatFilePath.string(), wparams);
 		}
+
+		if (BENCHMARK_SAT)
+			CSummedAreaTableBenchmark(logger.get()).run();
 	}
 
 	void onAppTerminated_impl() override
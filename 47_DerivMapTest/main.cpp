@@ -17,6 +17,12 @@
 #include "nbl/ext/ScreenShot/ScreenShot.h"
 #include "nbl/ext/FullScreenTriangle/FullScreenTriangle.h"
 
+#include "nbl/system/CStdoutLogger.h"
+
+#include <chrono>
+#include <fstream>
+#include <numeric>
+
 using namespace nbl;
 using namespace core;
 using namespace asset;
@@ -137,7 +143,7 @@ public:
 	}
 };
 
-static core::smart_refctd_ptr<asset::ICPUImage> createDerivMapFromHeightMap(asset::ICPUImage* _inImg, asset::ISampler::E_TEXTURE_CLAMP _uwrap, asset::ISampler::E_TEXTURE_CLAMP _vwrap, asset::ISampler::E_TEXTURE_BORDER_COLOR _borderColor)
+static core::smart_refctd_ptr<asset::ICPUImage> createDerivMapFromHeightMapMultiPass(asset::ICPUImage* _inImg, asset::ISampler::E_TEXTURE_CLAMP _uwrap, asset::ISampler::E_TEXTURE_CLAMP _vwrap, asset::ISampler::E_TEXTURE_BORDER_COLOR _borderColor)
 {
 	using namespace asset;
 
@@ -239,6 +245,359 @@ static core::smart_refctd_ptr<asset::ICPUImage> createDerivMapFromHeightMap(asse
 	return outImg;
 }
 
+// Texel coordinate after applying the sampler's wrap mode, -1 when it lands on the border
+static int32_t wrapTexelCoord(int32_t coord, const int32_t extent, const asset::ISampler::E_TEXTURE_CLAMP wrap)
+{
+	switch (wrap)
+	{
+		case asset::ISampler::ETC_REPEAT:
+			coord %= extent;
+			return coord < 0 ? coord + extent : coord;
+		case asset::ISampler::ETC_MIRROR:
+		{
+			const int32_t period = extent * 2;
+			coord %= period;
+			if (coord < 0)
+				coord += period;
+			return coord < extent ? coord : period - 1 - coord;
+		}
+		case asset::ISampler::ETC_MIRROR_CLAMP_TO_EDGE:
+			return core::min(coord < 0 ? -1 - coord : coord, extent - 1);
+		case asset::ISampler::ETC_MIRROR_CLAMP_TO_BORDER:
+			coord = coord < 0 ? -1 - coord : coord;
+			return coord < extent ? coord : -1;
+		case asset::ISampler::ETC_CLAMP_TO_BORDER:
+			return coord >= 0 && coord < extent ? coord : -1;
+		default:
+			return core::clamp(coord, 0, extent - 1);
+	}
+}
+
+// The filter taps of the multi-pass derivative map for a heightmap whose larger side is `maxExtent`.
+// They are measured by running the blit over an impulse along each axis, so they match its sign convention and weights exactly.
+struct SDerivMapTaps
+{
+	static inline constexpr int32_t MaxRadius = 16;
+
+	int32_t radius = 0;
+	float x[MaxRadius * 2 + 1] = {};
+	float y[MaxRadius * 2 + 1] = {};
+};
+
+static SDerivMapTaps computeDerivMapTaps(const uint32_t maxExtent)
+{
+	auto getImpulseResponse = [maxExtent](const bool alongY, float* outResponse) -> void
+	{
+		const uint32_t width = alongY ? 1u : maxExtent;
+		const uint32_t height = alongY ? maxExtent : 1u;
+
+		IImage::SCreationParams params = {};
+		params.flags = static_cast<IImage::E_CREATE_FLAGS>(0u);
+		params.type = IImage::ET_2D;
+		params.format = asset::EF_R32_SFLOAT;
+		params.extent = { width, height, 1u };
+		params.mipLevels = 1u;
+		params.arrayLayers = 1u;
+		params.samples = ICPUImage::ESCF_1_BIT;
+
+		ICPUImage::SBufferCopy region = {};
+		region.imageExtent = params.extent;
+		region.imageSubresource.aspectMask = asset::IImage::EAF_COLOR_BIT;
+		region.imageSubresource.layerCount = 1u;
+		region.bufferRowLength = width;
+
+		auto buffer = core::make_smart_refctd_ptr<asset::ICPUBuffer>(size_t(maxExtent) * sizeof(float));
+		std::fill_n(reinterpret_cast<float*>(buffer->getPointer()), maxExtent, 0.f);
+		reinterpret_cast<float*>(buffer->getPointer())[maxExtent / 2u] = 1.f;
+		auto impulse = asset::ICPUImage::create(std::move(params));
+		impulse->setBufferAndRegions(std::move(buffer), core::make_refctd_dynamic_array<core::smart_refctd_dynamic_array<IImage::SBufferCopy>>(1ull, region));
+
+		auto response = createDerivMapFromHeightMapMultiPass(impulse.get(), ISampler::ETC_CLAMP_TO_BORDER, ISampler::ETC_CLAMP_TO_BORDER, ISampler::ETBC_FLOAT_TRANSPARENT_BLACK);
+		const uint32_t rowLength = response->getRegions().begin()->bufferRowLength;
+		const float* texels = reinterpret_cast<const float*>(response->getBuffer()->getPointer());
+		for (uint32_t i = 0u; i < maxExtent; i++)
+			outResponse[i] = alongY ? texels[size_t(i) * rowLength * 2u + 1u] : texels[i * 2u];
+	};
+
+	core::vector<float> xResponse(maxExtent), yResponse(maxExtent);
+	getImpulseResponse(false, xResponse.data());
+	getImpulseResponse(true, yResponse.data());
+
+	// output at `c-i` of an impulse at `c` is the weight of the input at offset `+i`
+	SDerivMapTaps taps;
+	const int32_t center = static_cast<int32_t>(maxExtent / 2u);
+	const int32_t maxRadius = core::min(SDerivMapTaps::MaxRadius, core::min(center, static_cast<int32_t>(maxExtent) - 1 - center));
+	for (int32_t i = -maxRadius; i <= maxRadius; i++)
+	{
+		taps.x[SDerivMapTaps::MaxRadius + i] = xResponse[center - i];
+		taps.y[SDerivMapTaps::MaxRadius + i] = yResponse[center - i];
+		if (xResponse[center - i] != 0.f || yResponse[center - i] != 0.f)
+			taps.radius = core::max(taps.radius, std::abs(i));
+	}
+	return taps;
+}
+
+// Same output as `createDerivMapFromHeightMapMultiPass` in one pass over the heightmap. Bands of rows get decoded once with a halo of `radius` texels
+// (wrap modes already applied), then both derivatives of four texels at a time come out of SSE multiply-adds and get interleaved straight into the RG output.
+// Block compressed and 64bit heightmaps go through the multi-pass path.
+template<typename ExecutionPolicy>
+static core::smart_refctd_ptr<asset::ICPUImage> createDerivMapFromHeightMap(ExecutionPolicy&& policy, asset::ICPUImage* _inImg, asset::ISampler::E_TEXTURE_CLAMP _uwrap, asset::ISampler::E_TEXTURE_CLAMP _vwrap, asset::ISampler::E_TEXTURE_BORDER_COLOR _borderColor)
+{
+	const auto& inParams = _inImg->getCreationParameters();
+	const uint32_t bytesPerChannel = (getBytesPerPixel(inParams.format) * core::rational(1, getFormatChannelCount(inParams.format))).getIntegerApprox();
+	if (asset::isBlockCompressionFormat(inParams.format) || bytesPerChannel > 4u)
+		return createDerivMapFromHeightMapMultiPass(_inImg, _uwrap, _vwrap, _borderColor);
+
+	const int32_t width = static_cast<int32_t>(inParams.extent.width);
+	const int32_t height = static_cast<int32_t>(inParams.extent.height);
+	const SDerivMapTaps taps = computeDerivMapTaps(core::max(inParams.extent.width, inParams.extent.height));
+	const int32_t radius = taps.radius;
+	const float borderValue = _borderColor == ISampler::ETBC_FLOAT_OPAQUE_WHITE || _borderColor == ISampler::ETBC_INT_OPAQUE_WHITE ? 1.f : 0.f;
+
+	auto outParams = inParams;
+	outParams.format = asset::EF_R32G32_SFLOAT;
+	const uint32_t pitch = IImageAssetHandlerBase::calcPitchInBlocks(outParams.extent.width, asset::getTexelOrBlockBytesize(outParams.format));
+	auto buffer = core::make_smart_refctd_ptr<asset::ICPUBuffer>(asset::getTexelOrBlockBytesize(outParams.format) * pitch * outParams.extent.height);
+	asset::ICPUImage::SBufferCopy region;
+	region.imageOffset = { 0,0,0 };
+	region.imageExtent = outParams.extent;
+	region.imageSubresource.aspectMask = asset::IImage::EAF_COLOR_BIT;
+	region.imageSubresource.baseArrayLayer = 0u;
+	region.imageSubresource.layerCount = 1u;
+	region.imageSubresource.mipLevel = 0u;
+	region.bufferRowLength = pitch;
+	region.bufferImageHeight = 0u;
+	region.bufferOffset = 0u;
+	float* const outTexels = reinterpret_cast<float*>(buffer->getPointer());
+	auto outImg = asset::ICPUImage::create(std::move(outParams));
+	outImg->setBufferAndRegions(std::move(buffer), core::make_refctd_dynamic_array<core::smart_refctd_dynamic_array<IImage::SBufferCopy>>(1ull, region));
+
+	constexpr int32_t BandHeight = 32;
+	core::vector<int32_t> bands((height + BandHeight - 1) / BandHeight);
+	std::iota(bands.begin(), bands.end(), 0);
+	std::for_each(policy, bands.begin(), bands.end(), [&](const int32_t band) -> void
+		{
+			const int32_t firstRow = band * BandHeight;
+			const int32_t rowCount = core::min(BandHeight, height - firstRow);
+			const size_t stride = size_t(width) + radius * 2u;
+
+			// the R channel of every texel the band's filters touch, only the rows above and below the band and the columns left and right of it are ever read
+			core::vector<float> heights(stride * (rowCount + radius * 2u));
+			for (int32_t row = 0; row < rowCount + radius * 2; row++)
+			{
+				float* const out = heights.data() + stride * row;
+				const int32_t srcY = wrapTexelCoord(firstRow - radius + row, height, _vwrap);
+				if (srcY < 0)
+				{
+					std::fill_n(out, stride, borderValue);
+					continue;
+				}
+
+				core::vectorSIMDu32 blockCoord;
+				const uint8_t* src = reinterpret_cast<const uint8_t*>(_inImg->getTexelBlockData(0u, core::vectorSIMDu32(0u, srcY, 0u, 0u), blockCoord));
+				const uint32_t texelBytesize = asset::getTexelOrBlockBytesize(inParams.format);
+				if (inParams.format == asset::EF_R8_UNORM)
+				{
+					for (int32_t x = 0; x < width; x++)
+						out[radius + x] = static_cast<float>(src[x] / 255.0);
+				}
+				else for (int32_t x = 0; x < width; x++, src += texelBytesize)
+				{
+					double decoded[4];
+					const void* srcPix[] = { src, nullptr, nullptr, nullptr };
+					asset::decodePixelsRuntime(inParams.format, srcPix, decoded, 0u, 0u);
+					out[radius + x] = static_cast<float>(decoded[0]);
+				}
+				for (int32_t x = -radius; x < 0; x++)
+				{
+					const int32_t srcX = wrapTexelCoord(x, width, _uwrap);
+					out[radius + x] = srcX < 0 ? borderValue : out[radius + srcX];
+				}
+				for (int32_t x = width; x < width + radius; x++)
+				{
+					const int32_t srcX = wrapTexelCoord(x, width, _uwrap);
+					out[radius + x] = srcX < 0 ? borderValue : out[radius + srcX];
+				}
+			}
+
+			const float* const xTaps = taps.x + SDerivMapTaps::MaxRadius;
+			const float* const yTaps = taps.y + SDerivMapTaps::MaxRadius;
+			for (int32_t row = 0; row < rowCount; row++)
+			{
+				const float* const center = heights.data() + stride * (row + radius) + radius;
+				float* const out = outTexels + size_t(firstRow + row) * pitch * 2u;
+
+				int32_t x = 0;
+				for (; x + 4 <= width; x += 4)
+				{
+					__m128 dx = _mm_setzero_ps();
+					__m128 dy = _mm_setzero_ps();
+					for (int32_t i = -radius; i <= radius; i++)
+					{
+						dx = _mm_add_ps(dx, _mm_mul_ps(_mm_loadu_ps(center + x + i), _mm_set1_ps(xTaps[i])));
+						dy = _mm_add_ps(dy, _mm_mul_ps(_mm_loadu_ps(center + x + i * ptrdiff_t(stride)), _mm_set1_ps(yTaps[i])));
+					}
+					_mm_storeu_ps(out + x * 2, _mm_unpacklo_ps(dx, dy));
+					_mm_storeu_ps(out + x * 2 + 4, _mm_unpackhi_ps(dx, dy));
+				}
+				for (; x < width; x++)
+				{
+					float dx = 0.f, dy = 0.f;
+					for (int32_t i = -radius; i <= radius; i++)
+					{
+						dx += center[x + i] * xTaps[i];
+						dy += center[x + i * ptrdiff_t(stride)] * yTaps[i];
+					}
+					out[x * 2] = dx;
+					out[x * 2 + 1] = dy;
+				}
+			}
+		}
+	);
+
+	return outImg;
+}
+
+static core::smart_refctd_ptr<asset::ICPUImage> createDerivMapFromHeightMap(asset::ICPUImage* _inImg, asset::ISampler::E_TEXTURE_CLAMP _uwrap, asset::ISampler::E_TEXTURE_CLAMP _vwrap, asset::ISampler::E_TEXTURE_BORDER_COLOR _borderColor)
+{
+	return createDerivMapFromHeightMap(core::execution::par, _inImg, _uwrap, _vwrap, _borderColor);
+}
+
+// A heightmap with both smooth slopes and texel sized detail, so the derivatives have a large dynamic range
+static core::smart_refctd_ptr<asset::ICPUImage> createSyntheticHeightMap(const uint32_t size)
+{
+	IImage::SCreationParams params;
+	params.flags = static_cast<asset::IImage::E_CREATE_FLAGS>(0u);
+	params.type = IImage::ET_2D;
+	params.format = asset::EF_R8_UNORM;
+	params.extent = { size, size, 1u };
+	params.mipLevels = 1u;
+	params.arrayLayers = 1u;
+	params.samples = asset::ICPUImage::ESCF_1_BIT;
+
+	auto regions = core::make_refctd_dynamic_array<core::smart_refctd_dynamic_array<ICPUImage::SBufferCopy>>(1ull);
+	regions->begin()->bufferOffset = 0ull;
+	regions->begin()->bufferRowLength = size;
+	regions->begin()->bufferImageHeight = 0u;
+	regions->begin()->imageSubresource = {};
+	regions->begin()->imageSubresource.layerCount = 1u;
+	regions->begin()->imageOffset = { 0, 0, 0 };
+	regions->begin()->imageExtent = { size, size, 1u };
+
+	auto texels = core::make_smart_refctd_ptr<ICPUBuffer>(size_t(size) * size);
+	{
+		uint8_t* out = reinterpret_cast<uint8_t*>(texels->getPointer());
+		core::vector<uint32_t> rows(size);
+		std::iota(rows.begin(), rows.end(), 0u);
+		std::for_each(core::execution::par_unseq, rows.begin(), rows.end(), [&](const uint32_t y) -> void
+			{
+				const float v = (y + 0.5f) / size;
+				for (uint32_t x = 0; x < size; ++x)
+				{
+					const float u = (x + 0.5f) / size;
+					const float hills = 0.5f + 0.25f * std::sin(u * 25.f) * std::cos(v * 17.f);
+					const float noise = float((x * 7919u + y * 104729u) % 61u) / 61.f;
+					out[size_t(y) * size + x] = static_cast<uint8_t>(core::clamp(hills * 0.9f + noise * 0.1f, 0.f, 1.f) * 255.f);
+				}
+			}
+		);
+	}
+
+	auto image = ICPUImage::create(std::move(params));
+	image->setBufferAndRegions(std::move(texels), std::move(regions));
+	return image;
+}
+
+/*
+	Headless comparison of the multi-pass blit against the fused derivative map, sequential and parallel, on every image of the testing list
+	and a large synthetic heightmap. The fused output is checked texel for texel against the blit, the largest difference is reported
+	relative to the largest derivative since the blit accumulates in a different order, and both fused runs must match exactly.
+*/
+static void benchmarkDerivMap(system::ILogger* logger)
+{
+	using clock_type = std::chrono::steady_clock;
+	constexpr uint32_t Repetitions = 3u;
+	constexpr double MaxRelativeError = 1e-4;
+
+	auto system = system::IApplicationFramework::createSystem();
+	auto assetManager = core::make_smart_refctd_ptr<asset::IAssetManager>(core::smart_refctd_ptr(system));
+
+	core::vector<std::pair<std::string, core::smart_refctd_ptr<ICPUImage>>> heightMaps;
+	{
+		std::ifstream list(testingImagePathsFile.data());
+		for (std::string line; std::getline(list, line); )
+		{
+			if (line == "" || line[0] == ';')
+				continue;
+
+			constexpr auto cachingFlags = static_cast<IAssetLoader::E_CACHING_FLAGS>(IAssetLoader::ECF_DONT_CACHE_REFERENCES | IAssetLoader::ECF_DONT_CACHE_TOP_LEVEL);
+			IAssetLoader::SAssetLoadParams loadParams(0ull, nullptr, cachingFlags);
+			auto contents = assetManager->getAsset(line, loadParams).getContents();
+			if (contents.empty() || (*contents.begin())->getAssetType() != IAsset::ET_IMAGE)
+			{
+				logger->log("Could not load %s as an image, skipping it", system::ILogger::ELL_ERROR, line.c_str());
+				continue;
+			}
+			heightMaps.emplace_back(line, core::smart_refctd_ptr_static_cast<ICPUImage>(*contents.begin()));
+		}
+	}
+	heightMaps.emplace_back("synthetic 4096x4096", createSyntheticHeightMap(4096u));
+
+	auto timeBest = [](auto&& createDerivMap, core::smart_refctd_ptr<ICPUImage>& outImage) -> double
+	{
+		double best = std::numeric_limits<double>::max();
+		for (uint32_t i = 0u; i < Repetitions; i++)
+		{
+			const auto start = clock_type::now();
+			outImage = createDerivMap();
+			best = core::min(best, std::chrono::duration<double>(clock_type::now() - start).count());
+		}
+		return best;
+	};
+
+	for (auto& [name, heightMap] : heightMaps)
+	{
+		constexpr auto Wrap = ISampler::ETC_CLAMP_TO_EDGE;
+		constexpr auto BorderColor = ISampler::ETBC_FLOAT_OPAQUE_BLACK;
+
+		core::smart_refctd_ptr<ICPUImage> multiPass, fusedSeq, fusedPar;
+		const double multiPassSeconds = timeBest([&]() { return createDerivMapFromHeightMapMultiPass(heightMap.get(), Wrap, Wrap, BorderColor); }, multiPass);
+		const double fusedSeqSeconds = timeBest([&]() { return createDerivMapFromHeightMap(core::execution::seq, heightMap.get(), Wrap, Wrap, BorderColor); }, fusedSeq);
+		const double fusedParSeconds = timeBest([&]() { return createDerivMapFromHeightMap(core::execution::par, heightMap.get(), Wrap, Wrap, BorderColor); }, fusedPar);
+
+		const auto extent = heightMap->getCreationParameters().extent;
+		const double megaTexels = double(extent.width) * extent.height / 1000000.0;
+		logger->log("%s (%ux%u): multi-pass %.2f ms (%.1f MTexel/s), fused sequential %.2f ms (%.1fx), fused parallel %.2f ms (%.1fx)", system::ILogger::ELL_PERFORMANCE,
+			name.c_str(), extent.width, extent.height,
+			multiPassSeconds * 1000.0, megaTexels / multiPassSeconds, fusedSeqSeconds * 1000.0, multiPassSeconds / fusedSeqSeconds, fusedParSeconds * 1000.0, multiPassSeconds / fusedParSeconds);
+
+		if (multiPass->getCreationParameters().format != fusedSeq->getCreationParameters().format)
+		{
+			logger->log("%s: fused path fell back to the multi-pass blit, nothing to compare", system::ILogger::ELL_PERFORMANCE, name.c_str());
+			continue;
+		}
+
+		const size_t byteSize = multiPass->getBuffer()->getSize();
+		if (memcmp(fusedSeq->getBuffer()->getPointer(), fusedPar->getBuffer()->getPointer(), byteSize) != 0)
+			logger->log("%s: sequential and parallel fused derivative maps differ", system::ILogger::ELL_ERROR, name.c_str());
+
+		const uint32_t rowLength = multiPass->getRegions().begin()->bufferRowLength;
+		const float* reference = reinterpret_cast<const float*>(multiPass->getBuffer()->getPointer());
+		const float* fused = reinterpret_cast<const float*>(fusedSeq->getBuffer()->getPointer());
+		double maxMagnitude = 0.0, maxDifference = 0.0;
+		for (uint32_t y = 0u; y < extent.height; y++)
+		for (uint32_t x = 0u; x < extent.width * 2u; x++)
+		{
+			const size_t i = size_t(y) * rowLength * 2u + x;
+			maxMagnitude = core::max<double>(maxMagnitude, std::abs(reference[i]));
+			maxDifference = core::max<double>(maxDifference, std::abs(double(reference[i]) - double(fused[i])));
+		}
+		const double relativeError = maxMagnitude > 0.0 ? maxDifference / maxMagnitude : maxDifference;
+		logger->log("%s: max difference from the multi-pass blit %e (%e of the largest derivative)", relativeError > MaxRelativeError ? system::ILogger::ELL_ERROR : system::ILogger::ELL_PERFORMANCE,
+			name.c_str(), maxDifference, relativeError);
+	}
+}
+
 class DerivMapTestApp : public ApplicationBase
 {
 	static constexpr uint32_t NBL_WINDOW_WIDTH = 1280;
@@ -707,4 +1066,20 @@ public:
 	}
 };
 
-NBL_COMMON_API_MAIN(DerivMapTestApp, DerivMapTestApp::Nabla)
\ No newline at end of file
+#ifdef _NBL_PLATFORM_ANDROID_
+NBL_COMMON_API_MAIN(DerivMapTestApp)
+#else
+int main(int argc, char** argv) {
+	// CPU only benchmark, no window or device gets created
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::string_view(argv[i]) != "-benchmark_derivmap")
+			continue;
+
+		auto logger = core::make_smart_refctd_ptr<system::CStdoutLogger>(core::bitflag(system::ILogger::ELL_INFO) | system::ILogger::ELL_PERFORMANCE | system::ILogger::ELL_ERROR);
+		benchmarkDerivMap(logger.get());
+		return 0;
+	}
+	CommonAPI::main<DerivMapTestApp>(argc, argv);
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,333 @@
+// Copyright (C) 2018-2023 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+#ifndef _RGB18E7S3_BATCH_H_INCLUDED_
+#define _RGB18E7S3_BATCH_H_INCLUDED_
+
+#include "nabla.h"
+
+#include <immintrin.h>
+#include <numeric>
+
+// Span based conversions between tightly packed RGB 32bit float triplets and RGB18E7S3 texels, the float span has to be three times as long as the texel one.
+// The scalar versions call `rgb32f_to_rgb18e7s3` and `rgb18e7s3_to_rgb32f` and are the reference, the SIMD versions must match them bit for bit.
+// Layout of a texel: R, G and B mantissas in bits [0,18), [18,36) and [36,54), the shared exponent biased by 63 in [54,61), then the R, G and B signs.
+// Every power of two the SIMD versions scale by is a normal float, so the scaling is exact and the only rounding is the one to the nearest mantissa, with ties rounding up.
+namespace rgb18e7s3
+{
+	static inline constexpr uint32_t MantissaBits = 18u;
+	static inline constexpr uint32_t MantissaMask = (0x1u<<MantissaBits)-1u;
+	static inline constexpr int32_t ExponentBias = 63;
+	static inline constexpr uint32_t ExponentMask = 0x7fu;
+	// largest mantissa with the largest exponent, everything bigger gets clamped to it
+	static inline constexpr float MaxValue = float(MantissaMask)*float(0x1ull<<(ExponentMask-ExponentBias-MantissaBits));
+
+	using rgb_range_t = nbl::core::SRange<const float>;
+	using out_rgb_range_t = nbl::core::SRange<float>;
+	using texel_range_t = nbl::core::SRange<const uint64_t>;
+	using out_texel_range_t = nbl::core::SRange<uint64_t>;
+
+	namespace impl
+	{
+		inline size_t getTexelCount(const size_t rgbCount, const size_t texelCount)
+		{
+			assert(rgbCount==texelCount*3u);
+			return texelCount;
+		}
+
+		// 4 RGB triplets to one register per channel
+		inline void loadSoA(const float* rgb, __m128& r, __m128& g, __m128& b)
+		{
+			const __m128 a = _mm_loadu_ps(rgb);
+			const __m128 c = _mm_loadu_ps(rgb+4);
+			const __m128 d = _mm_loadu_ps(rgb+8);
+			r = _mm_shuffle_ps(a,_mm_shuffle_ps(c,d,_MM_SHUFFLE(1,1,2,2)),_MM_SHUFFLE(2,0,3,0));
+			g = _mm_shuffle_ps(_mm_shuffle_ps(a,c,_MM_SHUFFLE(0,0,1,1)),_mm_shuffle_ps(c,d,_MM_SHUFFLE(2,2,3,3)),_MM_SHUFFLE(2,0,2,0));
+			b = _mm_shuffle_ps(_mm_shuffle_ps(a,c,_MM_SHUFFLE(1,1,2,2)),d,_MM_SHUFFLE(3,0,2,0));
+		}
+
+		// the last triplet can't be written with a full register, it would run past the end of the span
+		inline void storeAoS(float* rgb, __m128 r, __m128 g, __m128 b)
+		{
+			__m128 a = _mm_setzero_ps();
+			_MM_TRANSPOSE4_PS(r,g,b,a);
+			_mm_storeu_ps(rgb,r);
+			_mm_storeu_ps(rgb+3,g);
+			_mm_storeu_ps(rgb+6,b);
+			_mm_storel_pi(reinterpret_cast<__m64*>(rgb+9),a);
+			_mm_store_ss(rgb+11,_mm_movehl_ps(a,a));
+		}
+
+		// floor(x+0.5) for non-negative x below 2^23, the addition itself would round when x is just under 0.5
+		inline __m128i roundHalfUp(const __m128 x)
+		{
+			const __m128i truncated = _mm_cvttps_epi32(x);
+			const __m128 fraction = _mm_sub_ps(x,_mm_cvtepi32_ps(truncated));
+			return _mm_sub_epi32(truncated,_mm_castps_si128(_mm_cmpge_ps(fraction,_mm_set1_ps(0.5f))));
+		}
+#ifdef __AVX2__
+		inline __m256i roundHalfUp(const __m256 x)
+		{
+			const __m256i truncated = _mm256_cvttps_epi32(x);
+			const __m256 fraction = _mm256_sub_ps(x,_mm256_cvtepi32_ps(truncated));
+			return _mm256_sub_epi32(truncated,_mm256_castps_si256(_mm256_cmp_ps(fraction,_mm256_set1_ps(0.5f),_CMP_GE_OQ)));
+		}
+#endif
+	}
+
+	inline void encodeScalar(const rgb_range_t& rgbRange, const out_texel_range_t& outRange)
+	{
+		const size_t count = impl::getTexelCount(rgbRange.size(),outRange.size());
+		const float* rgb = rgbRange.begin();
+		uint64_t* out = outRange.begin();
+		for (size_t i=0u; i<count; i++, rgb+=3)
+			out[i] = nbl::core::rgb32f_to_rgb18e7s3(rgb[0],rgb[1],rgb[2]);
+	}
+
+	inline void decodeScalar(const texel_range_t& encodedRange, const out_rgb_range_t& rgbRange)
+	{
+		const size_t count = impl::getTexelCount(rgbRange.size(),encodedRange.size());
+		const uint64_t* encoded = encodedRange.begin();
+		float* rgb = rgbRange.begin();
+		for (size_t i=0u; i<count; i++, rgb+=3)
+		{
+			const auto decoded = nbl::core::rgb18e7s3_to_rgb32f(encoded[i]);
+			rgb[0] = decoded.x;
+			rgb[1] = decoded.y;
+			rgb[2] = decoded.z;
+		}
+	}
+
+	// 4 texels per iteration
+	inline void encodeSSE(const rgb_range_t& rgbRange, const out_texel_range_t& outRange)
+	{
+		const size_t count = impl::getTexelCount(rgbRange.size(),outRange.size());
+		const float* rgb = rgbRange.begin();
+		uint64_t* out = outRange.begin();
+
+		const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+		const __m128 maxValue = _mm_set1_ps(MaxValue);
+		const __m128i mantissaMask = _mm_set1_epi32(MantissaMask);
+		const __m128i mantissaOverflow = _mm_set1_epi32(0x1<<MantissaBits);
+		const __m128i minExponent = _mm_set1_epi32(-ExponentBias-1);
+
+		size_t i = 0u;
+		for (; i+4u<=count; i+=4u, rgb+=12)
+		{
+			__m128 r, g, b;
+			impl::loadSoA(rgb,r,g,b);
+			const __m128 zero = _mm_setzero_ps();
+			const __m128i signs = _mm_or_si128(_mm_or_si128(
+				_mm_slli_epi32(_mm_srli_epi32(_mm_castps_si128(_mm_cmplt_ps(r,zero)),31),29),
+				_mm_slli_epi32(_mm_srli_epi32(_mm_castps_si128(_mm_cmplt_ps(g,zero)),31),30)),
+				_mm_slli_epi32(_mm_srli_epi32(_mm_castps_si128(_mm_cmplt_ps(b,zero)),31),31)
+			);
+			r = _mm_min_ps(_mm_and_ps(r,absMask),maxValue);
+			g = _mm_min_ps(_mm_and_ps(g,absMask),maxValue);
+			b = _mm_min_ps(_mm_and_ps(b,absMask),maxValue);
+
+			// floor(log2) of the largest channel straight from its exponent bits, denormals and zero clamp to the smallest shared exponent
+			const __m128 maxRGB = _mm_max_ps(_mm_max_ps(r,g),b);
+			const __m128i floorLog2 = _mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(maxRGB),23),_mm_set1_epi32(127));
+			__m128i sharedExponent = _mm_add_epi32(_mm_max_epi32(floorLog2,minExponent),_mm_set1_epi32(ExponentBias+1));
+			// 2^(MantissaBits+ExponentBias-sharedExponent) built from its bits
+			__m128i scaleBits = _mm_slli_epi32(_mm_sub_epi32(_mm_set1_epi32(MantissaBits+ExponentBias+127),sharedExponent),23);
+
+			// rounding the largest channel can carry into the next exponent
+			const __m128i overflow = _mm_cmpeq_epi32(impl::roundHalfUp(_mm_mul_ps(maxRGB,_mm_castsi128_ps(scaleBits))),mantissaOverflow);
+			sharedExponent = _mm_sub_epi32(sharedExponent,overflow);
+			scaleBits = _mm_add_epi32(scaleBits,_mm_slli_epi32(overflow,23));
+			const __m128 scale = _mm_castsi128_ps(scaleBits);
+
+			const __m128i mr = _mm_and_si128(impl::roundHalfUp(_mm_mul_ps(r,scale)),mantissaMask);
+			const __m128i mg = _mm_and_si128(impl::roundHalfUp(_mm_mul_ps(g,scale)),mantissaMask);
+			const __m128i mb = _mm_and_si128(impl::roundHalfUp(_mm_mul_ps(b,scale)),mantissaMask);
+
+			// low and high 32 bits of every texel, G straddles the two
+			const __m128i low = _mm_or_si128(mr,_mm_slli_epi32(mg,MantissaBits));
+			const __m128i high = _mm_or_si128(_mm_or_si128(_mm_srli_epi32(mg,32u-MantissaBits),_mm_slli_epi32(mb,MantissaBits*2u-32u)),
+				_mm_or_si128(_mm_slli_epi32(_mm_and_si128(sharedExponent,_mm_set1_epi32(ExponentMask)),MantissaBits*3u-32u),signs));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out+i),_mm_unpacklo_epi32(low,high));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out+i+2u),_mm_unpackhi_epi32(low,high));
+		}
+		encodeScalar(rgb_range_t(rgb,rgbRange.end()),out_texel_range_t(out+i,outRange.end()));
+	}
+
+	inline void decodeSSE(const texel_range_t& encodedRange, const out_rgb_range_t& rgbRange)
+	{
+		const size_t count = impl::getTexelCount(rgbRange.size(),encodedRange.size());
+		const uint64_t* encoded = encodedRange.begin();
+		float* rgb = rgbRange.begin();
+
+		const __m128i mantissaMask = _mm_set1_epi32(MantissaMask);
+		const __m128i one = _mm_set1_epi32(1);
+
+		size_t i = 0u;
+		for (; i+4u<=count; i+=4u, rgb+=12)
+		{
+			const __m128 first = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(encoded+i)));
+			const __m128 second = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(encoded+i+2u)));
+			const __m128i low = _mm_castps_si128(_mm_shuffle_ps(first,second,_MM_SHUFFLE(2,0,2,0)));
+			const __m128i high = _mm_castps_si128(_mm_shuffle_ps(first,second,_MM_SHUFFLE(3,1,3,1)));
+
+			const __m128i mr = _mm_and_si128(low,mantissaMask);
+			const __m128i mg = _mm_or_si128(_mm_srli_epi32(low,MantissaBits),_mm_and_si128(_mm_slli_epi32(high,32u-MantissaBits),mantissaMask));
+			const __m128i mb = _mm_and_si128(_mm_srli_epi32(high,MantissaBits*2u-32u),mantissaMask);
+			const __m128i sharedExponent = _mm_and_si128(_mm_srli_epi32(high,MantissaBits*3u-32u),_mm_set1_epi32(ExponentMask));
+			// 2^(sharedExponent-ExponentBias-MantissaBits)
+			const __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(sharedExponent,_mm_set1_epi32(127-ExponentBias-int32_t(MantissaBits))),23));
+
+			const __m128 r = _mm_or_ps(_mm_mul_ps(_mm_cvtepi32_ps(mr),scale),_mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(high,29),one),31)));
+			const __m128 g = _mm_or_ps(_mm_mul_ps(_mm_cvtepi32_ps(mg),scale),_mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(high,30),one),31)));
+			const __m128 b = _mm_or_ps(_mm_mul_ps(_mm_cvtepi32_ps(mb),scale),_mm_castsi128_ps(_mm_slli_epi32(_mm_srli_epi32(high,31),31)));
+			impl::storeAoS(rgb,r,g,b);
+		}
+		decodeScalar(texel_range_t(encoded+i,encodedRange.end()),out_rgb_range_t(rgb,rgbRange.end()));
+	}
+
+#ifdef __AVX2__
+	// 8 texels per iteration, same steps as `encodeSSE`
+	inline void encodeAVX2(const rgb_range_t& rgbRange, const out_texel_range_t& outRange)
+	{
+		const size_t count = impl::getTexelCount(rgbRange.size(),outRange.size());
+		const float* rgb = rgbRange.begin();
+		uint64_t* out = outRange.begin();
+
+		const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+		const __m256 maxValue = _mm256_set1_ps(MaxValue);
+		const __m256i mantissaMask = _mm256_set1_epi32(MantissaMask);
+		const __m256i mantissaOverflow = _mm256_set1_epi32(0x1<<MantissaBits);
+		const __m256i minExponent = _mm256_set1_epi32(-ExponentBias-1);
+
+		size_t i = 0u;
+		for (; i+8u<=count; i+=8u, rgb+=24)
+		{
+			__m128 r0, g0, b0, r1, g1, b1;
+			impl::loadSoA(rgb,r0,g0,b0);
+			impl::loadSoA(rgb+12,r1,g1,b1);
+			__m256 r = _mm256_insertf128_ps(_mm256_castps128_ps256(r0),r1,1);
+			__m256 g = _mm256_insertf128_ps(_mm256_castps128_ps256(g0),g1,1);
+			__m256 b = _mm256_insertf128_ps(_mm256_castps128_ps256(b0),b1,1);
+
+			const __m256 zero = _mm256_setzero_ps();
+			const __m256i signs = _mm256_or_si256(_mm256_or_si256(
+				_mm256_slli_epi32(_mm256_srli_epi32(_mm256_castps_si256(_mm256_cmp_ps(r,zero,_CMP_LT_OQ)),31),29),
+				_mm256_slli_epi32(_mm256_srli_epi32(_mm256_castps_si256(_mm256_cmp_ps(g,zero,_CMP_LT_OQ)),31),30)),
+				_mm256_slli_epi32(_mm256_srli_epi32(_mm256_castps_si256(_mm256_cmp_ps(b,zero,_CMP_LT_OQ)),31),31)
+			);
+			r = _mm256_min_ps(_mm256_and_ps(r,absMask),maxValue);
+			g = _mm256_min_ps(_mm256_and_ps(g,absMask),maxValue);
+			b = _mm256_min_ps(_mm256_and_ps(b,absMask),maxValue);
+
+			const __m256 maxRGB = _mm256_max_ps(_mm256_max_ps(r,g),b);
+			const __m256i floorLog2 = _mm256_sub_epi32(_mm256_srli_epi32(_mm256_castps_si256(maxRGB),23),_mm256_set1_epi32(127));
+			__m256i sharedExponent = _mm256_add_epi32(_mm256_max_epi32(floorLog2,minExponent),_mm256_set1_epi32(ExponentBias+1));
+			__m256i scaleBits = _mm256_slli_epi32(_mm256_sub_epi32(_mm256_set1_epi32(MantissaBits+ExponentBias+127),sharedExponent),23);
+
+			const __m256i overflow = _mm256_cmpeq_epi32(impl::roundHalfUp(_mm256_mul_ps(maxRGB,_mm256_castsi256_ps(scaleBits))),mantissaOverflow);
+			sharedExponent = _mm256_sub_epi32(sharedExponent,overflow);
+			scaleBits = _mm256_add_epi32(scaleBits,_mm256_slli_epi32(overflow,23));
+			const __m256 scale = _mm256_castsi256_ps(scaleBits);
+
+			const __m256i mr = _mm256_and_si256(impl::roundHalfUp(_mm256_mul_ps(r,scale)),mantissaMask);
+			const __m256i mg = _mm256_and_si256(impl::roundHalfUp(_mm256_mul_ps(g,scale)),mantissaMask);
+			const __m256i mb = _mm256_and_si256(impl::roundHalfUp(_mm256_mul_ps(b,scale)),mantissaMask);
+
+			const __m256i low = _mm256_or_si256(mr,_mm256_slli_epi32(mg,MantissaBits));
+			const __m256i high = _mm256_or_si256(_mm256_or_si256(_mm256_srli_epi32(mg,32u-MantissaBits),_mm256_slli_epi32(mb,MantissaBits*2u-32u)),
+				_mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(sharedExponent,_mm256_set1_epi32(ExponentMask)),MantissaBits*3u-32u),signs));
+			// the unpacks work within 128bit lanes, texels come out as 0,1,4,5 and 2,3,6,7
+			const __m256i first = _mm256_unpacklo_epi32(low,high);
+			const __m256i second = _mm256_unpackhi_epi32(low,high);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out+i),_mm256_permute2x128_si256(first,second,0x20));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out+i+4u),_mm256_permute2x128_si256(first,second,0x31));
+		}
+		encodeSSE(rgb_range_t(rgb,rgbRange.end()),out_texel_range_t(out+i,outRange.end()));
+	}
+
+	inline void decodeAVX2(const texel_range_t& encodedRange, const out_rgb_range_t& rgbRange)
+	{
+		const size_t count = impl::getTexelCount(rgbRange.size(),encodedRange.size());
+		const uint64_t* encoded = encodedRange.begin();
+		float* rgb = rgbRange.begin();
+
+		const __m256i mantissaMask = _mm256_set1_epi32(MantissaMask);
+		const __m256i one = _mm256_set1_epi32(1);
+
+		size_t i = 0u;
+		for (; i+8u<=count; i+=8u, rgb+=24)
+		{
+			const __m256 first = _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(encoded+i)));
+			const __m256 second = _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(encoded+i+4u)));
+			// the shuffles work within 128bit lanes, put the texels back in order 0 to 7
+			const __m256i low = _mm256_permute4x64_epi64(_mm256_castps_si256(_mm256_shuffle_ps(first,second,_MM_SHUFFLE(2,0,2,0))),_MM_SHUFFLE(3,1,2,0));
+			const __m256i high = _mm256_permute4x64_epi64(_mm256_castps_si256(_mm256_shuffle_ps(first,second,_MM_SHUFFLE(3,1,3,1))),_MM_SHUFFLE(3,1,2,0));
+
+			const __m256i mr = _mm256_and_si256(low,mantissaMask);
+			const __m256i mg = _mm256_or_si256(_mm256_srli_epi32(low,MantissaBits),_mm256_and_si256(_mm256_slli_epi32(high,32u-MantissaBits),mantissaMask));
+			const __m256i mb = _mm256_and_si256(_mm256_srli_epi32(high,MantissaBits*2u-32u),mantissaMask);
+			const __m256i sharedExponent = _mm256_and_si256(_mm256_srli_epi32(high,MantissaBits*3u-32u),_mm256_set1_epi32(ExponentMask));
+			const __m256 scale = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(sharedExponent,_mm256_set1_epi32(127-ExponentBias-int32_t(MantissaBits))),23));
+
+			const __m256 r = _mm256_or_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(mr),scale),_mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_srli_epi32(high,29),one),31)));
+			const __m256 g = _mm256_or_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(mg),scale),_mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_srli_epi32(high,30),one),31)));
+			const __m256 b = _mm256_or_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(mb),scale),_mm256_castsi256_ps(_mm256_slli_epi32(_mm256_srli_epi32(high,31),31)));
+			impl::storeAoS(rgb,_mm256_castps256_ps128(r),_mm256_castps256_ps128(g),_mm256_castps256_ps128(b));
+			impl::storeAoS(rgb+12,_mm256_extractf128_ps(r,1),_mm256_extractf128_ps(g,1),_mm256_extractf128_ps(b,1));
+		}
+		decodeSSE(texel_range_t(encoded+i,encodedRange.end()),out_rgb_range_t(rgb,rgbRange.end()));
+	}
+#endif
+
+	// widest path the build targets
+	inline void encode(const rgb_range_t& rgb, const out_texel_range_t& out)
+	{
+#ifdef __AVX2__
+		encodeAVX2(rgb,out);
+#else
+		encodeSSE(rgb,out);
+#endif
+	}
+
+	inline void decode(const texel_range_t& encoded, const out_rgb_range_t& rgb)
+	{
+#ifdef __AVX2__
+		decodeAVX2(encoded,rgb);
+#else
+		decodeSSE(encoded,rgb);
+#endif
+	}
+
+	// spans of hundreds of millions of texels, split into chunks converted under `policy`
+	static inline constexpr size_t ChunkSize = 0x1u<<16;
+
+	template<typename ExecutionPolicy>
+	inline void encode(ExecutionPolicy&& policy, const rgb_range_t& rgb, const out_texel_range_t& out)
+	{
+		const size_t count = impl::getTexelCount(rgb.size(),out.size());
+		nbl::core::vector<size_t> chunks((count+ChunkSize-1u)/ChunkSize);
+		std::iota(chunks.begin(),chunks.end(),0u);
+		std::for_each(policy,chunks.begin(),chunks.end(),[&](const size_t chunk) -> void
+		{
+			const size_t begin = chunk*ChunkSize;
+			const size_t end = nbl::core::min(begin+ChunkSize,count);
+			encode(rgb_range_t(rgb.begin()+begin*3u,rgb.begin()+end*3u),out_texel_range_t(out.begin()+begin,out.begin()+end));
+		});
+	}
+
+	template<typename ExecutionPolicy>
+	inline void decode(ExecutionPolicy&& policy, const texel_range_t& encoded, const out_rgb_range_t& rgb)
+	{
+		const size_t count = impl::getTexelCount(rgb.size(),encoded.size());
+		nbl::core::vector<size_t> chunks((count+ChunkSize-1u)/ChunkSize);
+		std::iota(chunks.begin(),chunks.end(),0u);
+		std::for_each(policy,chunks.begin(),chunks.end(),[&](const size_t chunk) -> void
+		{
+			const size_t begin = chunk*ChunkSize;
+			const size_t end = nbl::core::min(begin+ChunkSize,count);
+			decode(texel_range_t(encoded.begin()+begin,encoded.begin()+end),out_rgb_range_t(rgb.begin()+begin*3u,rgb.begin()+end*3u));
+		});
+	}
+}
+
+#endif
@@ -8,6 +8,14 @@
 #include <cstdio>
 
 #include "../common/CommonAPI.h"
+#include "nbl/system/CStdoutLogger.h"
+
+#include "RGB18E7S3Batch.h"
+
+#include <chrono>
+#include <functional>
+#include <random>
+#include <thread>
 
 using namespace nbl;
 using namespace core;
@@ -39,10 +47,429 @@ struct alignas(16) SShaderStorageBufferObject
 
 static_assert(sizeof(SShaderStorageBufferObject) == sizeof(SShaderStorageBufferObject::rgb) + sizeof(SShaderStorageBufferObject::rgb_cpp_encoded) + sizeof(SShaderStorageBufferObject::rgb_cpp_decoded) + sizeof(SShaderStorageBufferObject::rgb_glsl_encoded) + sizeof(SShaderStorageBufferObject::rgb_glsl_decoded), "There will be inproper alignment!");
 
-int main()
+/*
+    CPU side of the test, the batch conversions of `RGB18E7S3Batch.h` against `rgb32f_to_rgb18e7s3` and `rgb18e7s3_to_rgb32f` called one texel at a time.
+    Validation compares every path bit for bit on the edges of the format, with `-benchmark` the throughput of each path gets measured on a large span too.
+*/
+namespace batch_test
+{
+    using clock_type = std::chrono::steady_clock;
+
+    struct SEncoder
+    {
+        const char* name;
+        std::function<void(const rgb18e7s3::rgb_range_t&, const rgb18e7s3::out_texel_range_t&)> encode;
+        std::function<void(const rgb18e7s3::texel_range_t&, const rgb18e7s3::out_rgb_range_t&)> decode;
+    };
+
+    static core::vector<SEncoder> getEncoders()
+    {
+        core::vector<SEncoder> encoders;
+        encoders.push_back({ "scalar", rgb18e7s3::encodeScalar, rgb18e7s3::decodeScalar });
+        encoders.push_back({ "SSE", rgb18e7s3::encodeSSE, rgb18e7s3::decodeSSE });
+#ifdef __AVX2__
+        encoders.push_back({ "AVX2", rgb18e7s3::encodeAVX2, rgb18e7s3::decodeAVX2 });
+#endif
+        encoders.push_back({ "parallel",
+            [](const rgb18e7s3::rgb_range_t& rgb, const rgb18e7s3::out_texel_range_t& out) { rgb18e7s3::encode(core::execution::par, rgb, out); },
+            [](const rgb18e7s3::texel_range_t& encoded, const rgb18e7s3::out_rgb_range_t& rgb) { rgb18e7s3::decode(core::execution::par, encoded, rgb); }
+        });
+        return encoders;
+    }
+
+    //! zero, denormals, +-FLT_MIN, every power of two the format can tell apart with its neighbours and the values whose mantissa rounds up into the next exponent,
+    //! the whole range below 2^64 including the clamp to the largest representable value
+    static core::vector<float> getEdgeValues()
+    {
+        constexpr float Infinity = std::numeric_limits<float>::infinity();
+        const float twoTo64 = std::ldexp(1.f, 64);
+        core::vector<float> values = {
+            0.f,
+            std::numeric_limits<float>::denorm_min(),
+            std::nextafter(FLT_MIN, 0.f),
+            FLT_MIN,
+            std::nextafter(FLT_MIN, Infinity),
+            rgb18e7s3::MaxValue,
+            std::nextafter(rgb18e7s3::MaxValue, 0.f),
+            std::nextafter(rgb18e7s3::MaxValue, Infinity),
+            std::nextafter(twoTo64, 0.f)
+        };
+        for (int32_t exponent = -rgb18e7s3::ExponentBias - int32_t(rgb18e7s3::MantissaBits) - 2; exponent < 64; exponent++)
+        {
+            const float powerOfTwo = std::ldexp(1.f, exponent);
+            const float roundsUp = powerOfTwo * (1.f - std::ldexp(1.f, -int32_t(rgb18e7s3::MantissaBits) - 1));
+            for (const float value : { powerOfTwo, roundsUp })
+            {
+                values.push_back(value);
+                values.push_back(std::nextafter(value, 0.f));
+                values.push_back(std::nextafter(value, Infinity));
+            }
+        }
+        for (size_t i = 0u, count = values.size(); i < count; i++)
+            values.push_back(-values[i]);
+        return values;
+    }
+
+    //! any finite float below 2^64 in magnitude, denormals included
+    static float getRandomValue(std::mt19937& generator)
+    {
+        std::uniform_int_distribution<uint32_t> biasedExponent(0u, 127u + 63u);
+        const uint32_t bits = (generator() & 0x807fffffu) | (biasedExponent(generator) << 23u);
+        float value;
+        memcpy(&value, &bits, sizeof(float));
+        return value;
+    }
+
+    template<typename T>
+    static size_t findFirstMismatch(const T* reference, const T* tested, const size_t count)
+    {
+        for (size_t i = 0u; i < count; i++)
+            if (memcmp(reference + i, tested + i, sizeof(T)) != 0)
+                return i;
+        return count;
+    }
+
+    //! every path on the whole span and on one starting a texel later, so the SIMD loops get unaligned spans and remainders
+    static bool validate(system::ILogger* logger)
+    {
+        const auto edgeValues = getEdgeValues();
+        const size_t edgeCount = edgeValues.size();
+        std::mt19937 generator(0x52474231u);
+
+        // every pair of edge values in every two channels, then random ones
+        core::vector<float> rgb;
+        rgb.reserve((edgeCount * edgeCount * 3u + (0x1u << 22u)) * 3u);
+        for (size_t i = 0u; i < edgeCount; i++)
+        for (size_t j = 0u; j < edgeCount; j++)
+        {
+            const float a = edgeValues[i], b = edgeValues[j], c = edgeValues[(i * 31u + j) % edgeCount];
+            rgb.insert(rgb.end(), { a, b, c, c, a, b, b, c, a });
+        }
+        for (uint32_t i = 0u; i < (0x1u << 22u) * 3u; i++)
+            rgb.push_back(getRandomValue(generator));
+        const size_t texelCount = rgb.size() / 3u;
+
+        // every exponent and sign combination with the edge mantissas in every channel, then random bits, every 64bit word decodes to something
+        core::vector<uint64_t> encodedEdges;
+        {
+            constexpr uint64_t EdgeMantissas[] = { 0u, 1u, 2u, 0x15555u, 0x2aaaau, 0x1u << (rgb18e7s3::MantissaBits - 1u), rgb18e7s3::MantissaMask };
+            for (uint64_t exponentAndSigns = 0u; exponentAndSigns < 0x400u; exponentAndSigns++)
+            for (const uint64_t r : EdgeMantissas)
+            for (const uint64_t g : EdgeMantissas)
+            for (const uint64_t b : EdgeMantissas)
+                encodedEdges.push_back((exponentAndSigns << 54u) | (b << 36u) | (g << 18u) | r);
+            for (uint32_t i = 0u; i < (0x1u << 22u); i++)
+                encodedEdges.push_back((uint64_t(generator()) << 32u) | generator());
+        }
+        const size_t encodedCount = encodedEdges.size();
+
+        core::vector<uint64_t> referenceEncoded(texelCount), encoded(texelCount);
+        core::vector<float> referenceDecoded(encodedCount * 3u), decoded(encodedCount * 3u);
+        rgb18e7s3::encodeScalar({ rgb.data(), rgb.data() + rgb.size() }, { referenceEncoded.data(), referenceEncoded.data() + texelCount });
+        rgb18e7s3::decodeScalar({ encodedEdges.data(), encodedEdges.data() + encodedCount }, { referenceDecoded.data(), referenceDecoded.data() + referenceDecoded.size() });
+
+        bool success = true;
+        for (const auto& encoder : getEncoders())
+        for (const size_t first : { size_t(0u), size_t(1u) })
+        {
+            std::fill(encoded.begin(), encoded.end(), 0ull);
+            encoder.encode({ rgb.data() + first * 3u, rgb.data() + rgb.size() }, { encoded.data() + first, encoded.data() + texelCount });
+            const size_t encodeMismatch = findFirstMismatch(referenceEncoded.data() + first, encoded.data() + first, texelCount - first) + first;
+            if (encodeMismatch != texelCount)
+            {
+                const float* texel = rgb.data() + encodeMismatch * 3u;
+                logger->log("%s encode differs from rgb32f_to_rgb18e7s3 at texel %zu (%a, %a, %a): 0x%016llx instead of 0x%016llx", system::ILogger::ELL_ERROR,
+                    encoder.name, encodeMismatch, texel[0], texel[1], texel[2], static_cast<unsigned long long>(encoded[encodeMismatch]), static_cast<unsigned long long>(referenceEncoded[encodeMismatch]));
+                success = false;
+            }
+
+            std::fill(decoded.begin(), decoded.end(), 0.f);
+            encoder.decode({ encodedEdges.data() + first, encodedEdges.data() + encodedCount }, { decoded.data() + first * 3u, decoded.data() + decoded.size() });
+            const size_t decodeMismatch = (findFirstMismatch(referenceDecoded.data() + first * 3u, decoded.data() + first * 3u, (encodedCount - first) * 3u) + first * 3u) / 3u;
+            if (decodeMismatch != encodedCount)
+            {
+                const float* texel = decoded.data() + decodeMismatch * 3u;
+                const float* reference = referenceDecoded.data() + decodeMismatch * 3u;
+                logger->log("%s decode differs from rgb18e7s3_to_rgb32f for 0x%016llx: (%a, %a, %a) instead of (%a, %a, %a)", system::ILogger::ELL_ERROR,
+                    encoder.name, static_cast<unsigned long long>(encodedEdges[decodeMismatch]), texel[0], texel[1], texel[2], reference[0], reference[1], reference[2]);
+                success = false;
+            }
+        }
+
+        if (success)
+            logger->log("Batch RGB18E7S3 conversions match the scalar ones on %zu encoded and %zu decoded texels", system::ILogger::ELL_INFO, texelCount, encodedCount);
+        return success;
+    }
+
+    //! best of a few runs over a span much bigger than the caches, bandwidth counts both the floats and the encoded texels
+    static void benchmark(system::ILogger* logger)
+    {
+        constexpr size_t TexelCount = 0x1u << 24u;
+        constexpr uint32_t Repetitions = 5u;
+
+        core::vector<float> rgb(TexelCount * 3u);
+        {
+            std::mt19937 generator(0x45374533u);
+            for (auto& value : rgb)
+                value = getRandomValue(generator);
+        }
+        core::vector<uint64_t> encoded(TexelCount);
+        core::vector<float> decoded(TexelCount * 3u);
+
+        auto timeBest = [](auto&& function) -> double
+        {
+            double best = std::numeric_limits<double>::max();
+            for (uint32_t i = 0u; i < Repetitions; i++)
+            {
+                const auto start = clock_type::now();
+                function();
+                best = core::min(best, std::chrono::duration<double>(clock_type::now() - start).count());
+            }
+            return best;
+        };
+
+        constexpr double BytesMoved = double(TexelCount) * (sizeof(float) * 3u + sizeof(uint64_t));
+        for (const auto& encoder : getEncoders())
+        {
+            const double encodeSeconds = timeBest([&]() { encoder.encode({ rgb.data(), rgb.data() + rgb.size() }, { encoded.data(), encoded.data() + encoded.size() }); });
+            const double decodeSeconds = timeBest([&]() { encoder.decode({ encoded.data(), encoded.data() + encoded.size() }, { decoded.data(), decoded.data() + decoded.size() }); });
+            logger->log("%s: encode %.1f MTexel/s (%.2f GB/s), decode %.1f MTexel/s (%.2f GB/s)", system::ILogger::ELL_PERFORMANCE, encoder.name,
+                TexelCount / encodeSeconds / 1000000.0, BytesMoved / encodeSeconds / 1000000000.0, TexelCount / decodeSeconds / 1000000.0, BytesMoved / decodeSeconds / 1000000000.0);
+        }
+    }
+}
+
+/*
+    CPU only qualification of `rgb32f_to_rgb18e7s3` and `rgb18e7s3_to_rgb32f` that needs no reference implementation and no GPU.
+    Every combination of shared exponent and signs is a work item, all of them run in parallel over a deterministic sample of mantissas and check that
+    - every decoded texel is exactly representable, so it encodes to a texel which decodes to the very same floats
+    - encoding is within half a mantissa step of the input clamped to the largest representable value, keeps the signs and is idempotent
+    - encoding keeps the order of the channels' magnitudes and never decreases as a single channel increases
+*/
+namespace property_test
+{
+    constexpr uint32_t SignCombinations = 8u;
+    constexpr uint32_t ExponentCount = rgb18e7s3::ExponentMask + 1u;
+    constexpr uint32_t DecodedSamples = 0x1u << 14u;
+    constexpr uint32_t EncodedSamples = 0x1u << 14u;
+    constexpr uint32_t MonotonicSamples = 0x1u << 10u;
+    constexpr double TimeBudgetSeconds = 60.0;
+
+    //! what the encoding of a texel means in doubles
+    struct SDecodedTexel
+    {
+        double rgb[3];
+        double step; //! distance between two consecutive mantissas
+    };
+
+    static SDecodedTexel interpret(const uint64_t encoded)
+    {
+        SDecodedTexel retval;
+        const int32_t sharedExponent = static_cast<int32_t>((encoded >> (rgb18e7s3::MantissaBits * 3u)) & rgb18e7s3::ExponentMask);
+        retval.step = std::ldexp(1.0, sharedExponent - rgb18e7s3::ExponentBias - int32_t(rgb18e7s3::MantissaBits));
+        for (uint32_t c = 0u; c < 3u; c++)
+        {
+            const double mantissa = double((encoded >> (rgb18e7s3::MantissaBits * c)) & rgb18e7s3::MantissaMask);
+            const bool negative = (encoded >> (rgb18e7s3::MantissaBits * 3u + 7u + c)) & 0x1u;
+            retval.rgb[c] = (negative ? -mantissa : mantissa) * retval.step;
+        }
+        return retval;
+    }
+
+    static uint64_t encode(const float (&rgb)[3])
+    {
+        return core::rgb32f_to_rgb18e7s3(rgb[0], rgb[1], rgb[2]);
+    }
+
+    static void decode(const uint64_t encoded, float (&rgb)[3])
+    {
+        const auto decoded = core::rgb18e7s3_to_rgb32f(encoded);
+        rgb[0] = decoded.x;
+        rgb[1] = decoded.y;
+        rgb[2] = decoded.z;
+    }
+
+    //! by value, a zero mantissa may keep its sign bit or not and -0 equals 0
+    static bool equal(const float (&a)[3], const float (&b)[3])
+    {
+        return a[0] == b[0] && a[1] == b[1] && a[2] == b[2];
+    }
+
+    static std::string toString(const float (&rgb)[3])
+    {
+        char buffer[128];
+        snprintf(buffer, sizeof(buffer), "(%a, %a, %a)", rgb[0], rgb[1], rgb[2]);
+        return buffer;
+    }
+
+    static std::string toString(const uint64_t encoded)
+    {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "0x%016llx", static_cast<unsigned long long>(encoded));
+        return buffer;
+    }
+
+    //! a magnitude the encoder puts under `sharedExponent`, the smallest exponent takes everything below 2^-63 including denormals,
+    //! the largest one reaches past the clamp up to 2^64
+    static float getMagnitudeForExponent(std::mt19937& generator, const uint32_t sharedExponent)
+    {
+        uint32_t bits;
+        if (sharedExponent == 0u)
+            bits = std::uniform_int_distribution<uint32_t>(0u, ((127u - rgb18e7s3::ExponentBias) << 23u) - 1u)(generator);
+        else
+            bits = ((sharedExponent + 127u - rgb18e7s3::ExponentBias - 1u) << 23u) | (generator() & 0x7fffffu);
+        float value;
+        memcpy(&value, &bits, sizeof(float));
+        return value;
+    }
+
+    //! returns the description of the first broken property, empty when all of them hold
+    static std::string checkItem(const uint32_t sharedExponent, const uint32_t signs)
+    {
+        std::mt19937 generator(sharedExponent * SignCombinations + signs);
+        std::uniform_int_distribution<uint32_t> mantissa(0u, rgb18e7s3::MantissaMask);
+        std::uniform_real_distribution<float> fraction(0.f, 1.f);
+
+        for (uint32_t i = 0u; i < DecodedSamples; i++)
+        {
+            const uint64_t word = (uint64_t(signs) << (rgb18e7s3::MantissaBits * 3u + 7u)) | (uint64_t(sharedExponent) << (rgb18e7s3::MantissaBits * 3u)) |
+                (uint64_t(mantissa(generator)) << (rgb18e7s3::MantissaBits * 2u)) | (uint64_t(mantissa(generator)) << rgb18e7s3::MantissaBits) | mantissa(generator);
+            float decoded[3], redecoded[3];
+            decode(word, decoded);
+            const auto expected = interpret(word);
+            for (uint32_t c = 0u; c < 3u; c++)
+            if (double(decoded[c]) != expected.rgb[c])
+                return "decoding " + toString(word) + " gives " + toString(decoded) + " instead of mantissa times 2^(exponent-81)";
+
+            decode(encode(decoded), redecoded);
+            if (!equal(decoded, redecoded))
+                return "representable " + toString(decoded) + " from " + toString(word) + " comes back as " + toString(redecoded);
+        }
+
+        float previous[3] = { 0.f, 0.f, 0.f };
+        core::vector<float> ascending(MonotonicSamples);
+        for (auto& value : ascending)
+            value = getMagnitudeForExponent(generator, sharedExponent);
+        std::sort(ascending.begin(), ascending.end());
+        for (uint32_t i = 0u; i < EncodedSamples + MonotonicSamples; i++)
+        {
+            const bool monotonic = i >= EncodedSamples;
+            float rgb[3];
+            if (monotonic)
+            {
+                // only the channel picked by the signs gets swept, the other two stay zero
+                rgb[0] = rgb[1] = rgb[2] = 0.f;
+                rgb[signs % 3u] = ascending[i - EncodedSamples];
+            }
+            else
+            {
+                // one channel carries the exponent, the others are a fraction of it
+                const uint32_t largest = i % 3u;
+                const float magnitude = getMagnitudeForExponent(generator, sharedExponent);
+                for (uint32_t c = 0u; c < 3u; c++)
+                    rgb[c] = c == largest ? magnitude : magnitude * fraction(generator);
+            }
+            for (uint32_t c = 0u; c < 3u; c++)
+            if ((signs >> c) & 0x1u)
+                rgb[c] = -rgb[c];
+
+            const uint64_t encoded = encode(rgb);
+            float decoded[3];
+            decode(encoded, decoded);
+            const auto expected = interpret(encoded);
+            for (uint32_t c = 0u; c < 3u; c++)
+            {
+                const double clamped = core::min<double>(std::abs(rgb[c]), rgb18e7s3::MaxValue);
+                if (std::abs(std::abs(double(decoded[c])) - clamped) > expected.step * 0.5)
+                    return "encoding " + toString(rgb) + " as " + toString(encoded) + " is more than half a mantissa step off, it decodes to " + toString(decoded);
+                if (decoded[c] != 0.f && (decoded[c] < 0.f) != (rgb[c] < 0.f))
+                    return "encoding " + toString(rgb) + " as " + toString(encoded) + " flips a sign, it decodes to " + toString(decoded);
+                for (uint32_t other = 0u; other < 3u; other++)
+                if (std::abs(rgb[c]) <= std::abs(rgb[other]) && std::abs(decoded[c]) > std::abs(decoded[other]))
+                    return "encoding " + toString(rgb) + " as " + toString(encoded) + " reorders the channels, it decodes to " + toString(decoded);
+            }
+            float redecoded[3];
+            decode(encode(decoded), redecoded);
+            if (!equal(decoded, redecoded))
+                return "encoding " + toString(rgb) + " is not idempotent, " + toString(decoded) + " comes back as " + toString(redecoded);
+
+            if (monotonic)
+            {
+                const uint32_t c = signs % 3u;
+                if (i > EncodedSamples && std::abs(decoded[c]) < std::abs(previous[c]))
+                    return "encoding is not monotonic, " + toString(rgb) + " decodes to " + toString(decoded) + " which is smaller than " + toString(previous);
+                memcpy(previous, decoded, sizeof(decoded));
+            }
+        }
+        return {};
+    }
+
+    static bool validate(system::ILogger* logger)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        core::vector<uint32_t> items(ExponentCount * SignCombinations);
+        std::iota(items.begin(), items.end(), 0u);
+        core::vector<std::string> failures(items.size());
+        std::for_each(core::execution::par, items.begin(), items.end(), [&](const uint32_t item) -> void
+            {
+                failures[item] = checkItem(item / SignCombinations, item % SignCombinations);
+            }
+        );
+
+        uint32_t failedItems = 0u;
+        for (uint32_t item = 0u; item < items.size(); item++)
+        {
+            if (failures[item].empty())
+                continue;
+            // a broken encoder tends to break most items the same way, the first few are enough
+            if (failedItems++ < 8u)
+                logger->log("Exponent %u, signs %u: %s", system::ILogger::ELL_ERROR, item / SignCombinations, item % SignCombinations, failures[item].c_str());
+        }
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const size_t texelCount = size_t(items.size()) * (DecodedSamples + EncodedSamples + MonotonicSamples);
+        logger->log("Property sweep of %zu texels over %u exponent and sign combinations took %.2f s on %u threads, %u combinations failed",
+            failedItems ? system::ILogger::ELL_ERROR : system::ILogger::ELL_PERFORMANCE, texelCount, uint32_t(items.size()), seconds, std::thread::hardware_concurrency(), failedItems);
+        if (seconds > TimeBudgetSeconds)
+            logger->log("Property sweep took longer than the %.0f s a build machine gets for it", system::ILogger::ELL_WARNING, TimeBudgetSeconds);
+        return failedItems == 0u;
+    }
+}
+
+int main(int argc, char** argv)
 {
     constexpr std::string_view APP_NAME = "RGB18E7S3 utility test";
 
+    {
+        auto cpuLogger = core::make_smart_refctd_ptr<system::CStdoutLogger>(core::bitflag(system::ILogger::ELL_INFO) | system::ILogger::ELL_PERFORMANCE | system::ILogger::ELL_WARNING | system::ILogger::ELL_ERROR);
+        bool validateOnly = false, cpuOnly = false, benchmarkBatch = false;
+        for (int i = 1; i < argc; ++i)
+        {
+            validateOnly |= std::string_view(argv[i]) == "-validate";
+            cpuOnly |= std::string_view(argv[i]) == "-cpu_only";
+            benchmarkBatch |= std::string_view(argv[i]) == "-benchmark";
+        }
+
+        // for build machines without a GPU, the exit code is the verdict
+        if (validateOnly)
+        {
+            const bool batchMatches = batch_test::validate(cpuLogger.get());
+            const bool propertiesHold = property_test::validate(cpuLogger.get());
+            return batchMatches && propertiesHold ? 0 : 1;
+        }
+
+        if (!batch_test::validate(cpuLogger.get()))
+            return 1;
+        // converts 16M texels five times per path, too slow to run before every GPU test
+        if (benchmarkBatch)
+            batch_test::benchmark(cpuLogger.get());
+
+        // the GPU comparison below needs a device
+        if (cpuOnly)
+            return 0;
+    }
+
     system::IApplicationFramework::GlobalsInit();
 
     CommonAPI::InitParams initParams;
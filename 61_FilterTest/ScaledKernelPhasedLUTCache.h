@@ -0,0 +1,125 @@
+// Copyright (C) 2018-2023 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+#ifndef _FILTER_TEST_SCALED_KERNEL_PHASED_LUT_CACHE_H_INCLUDED_
+#define _FILTER_TEST_SCALED_KERNEL_PHASED_LUT_CACHE_H_INCLUDED_
+
+#include "nabla.h"
+
+#include <mutex>
+#include <typeindex>
+
+
+// Scaled kernel phased LUTs only depend on the in/out extents, the image type and the kernels, so a batch resizing many images
+// to a handful of target sizes can compute each LUT once and share it between CPU blits (copy into scratch) and GPU blits (upload).
+// Entries are never evicted, the set of distinct resolution pairs in a batch is expected to be small, call `clear` between batches if not.
+class CScaledKernelPhasedLUTCache
+{
+	public:
+		// Returns nullptr if the LUT couldn't be computed. Thread-safe, two threads missing on the same key at once will both compute it.
+		template<typename BlitUtilities>
+		nbl::core::smart_refctd_ptr<const nbl::asset::ICPUBuffer> get(
+			const nbl::core::vectorSIMDu32& inExtent, const nbl::core::vectorSIMDu32& outExtent, const nbl::asset::IImage::E_TYPE imageType,
+			const typename BlitUtilities::convolution_kernels_t& kernels)
+		{
+			SKey key = {std::type_index(typeid(BlitUtilities)),{inExtent.x,inExtent.y,inExtent.z},{outExtent.x,outExtent.y,outExtent.z},imageType};
+			// the kernels' stretch and scale are runtime state, so they're part of the key as raw bytes
+			std::apply([&key](const auto&... kernel) -> void
+			{
+				(appendKernelBytes(key.kernelBytes,kernel), ...);
+			},kernels);
+
+			{
+				std::unique_lock lock(m_mutex);
+				if (auto found=m_entries.find(key); found!=m_entries.end())
+				{
+					m_hits++;
+					return found->second;
+				}
+				m_misses++;
+			}
+
+			const size_t lutSize = BlitUtilities::getScaledKernelPhasedLUTSize(inExtent,outExtent,imageType,kernels);
+			auto lut = nbl::core::make_smart_refctd_ptr<nbl::asset::ICPUBuffer>(lutSize);
+			if (!BlitUtilities::computeScaledKernelPhasedLUT(reinterpret_cast<uint8_t*>(lut->getPointer()),inExtent,outExtent,imageType,kernels))
+				return nullptr;
+
+			std::unique_lock lock(m_mutex);
+			// if another thread beat us to it, keep theirs so everyone shares the same buffer
+			return m_entries.try_emplace(std::move(key),std::move(lut)).first->second;
+		}
+
+		inline void clear()
+		{
+			std::unique_lock lock(m_mutex);
+			m_entries.clear();
+			m_hits = m_misses = 0ull;
+		}
+
+		inline uint64_t getHitCount() const
+		{
+			std::unique_lock lock(m_mutex);
+			return m_hits;
+		}
+		inline uint64_t getMissCount() const
+		{
+			std::unique_lock lock(m_mutex);
+			return m_misses;
+		}
+
+		inline size_t getByteSize() const
+		{
+			std::unique_lock lock(m_mutex);
+			size_t retval = 0ull;
+			for (const auto& entry : m_entries)
+				retval += entry.second->getSize();
+			return retval;
+		}
+
+	private:
+		struct SKey
+		{
+			inline bool operator==(const SKey& other) const
+			{
+				return blitUtilities==other.blitUtilities && inExtent==other.inExtent && outExtent==other.outExtent && imageType==other.imageType && kernelBytes==other.kernelBytes;
+			}
+
+			std::type_index blitUtilities;
+			std::array<uint32_t,3> inExtent;
+			std::array<uint32_t,3> outExtent;
+			nbl::asset::IImage::E_TYPE imageType;
+			nbl::core::vector<uint8_t> kernelBytes = {};
+		};
+		struct SKeyHash
+		{
+			inline size_t operator()(const SKey& key) const
+			{
+				size_t hash = key.blitUtilities.hash_code();
+				auto combine = [&hash](const size_t value) -> void {hash ^= value+0x9e3779b97f4a7c15ull+(hash<<6)+(hash>>2);};
+				for (uint32_t i=0u; i<3u; i++)
+				{
+					combine(key.inExtent[i]);
+					combine(key.outExtent[i]);
+				}
+				combine(key.imageType);
+				combine(std::hash<std::string_view>()(std::string_view(reinterpret_cast<const char*>(key.kernelBytes.data()),key.kernelBytes.size())));
+				return hash;
+			}
+		};
+
+		// padding bytes could make equal kernels compare different, which only costs a miss, never a wrong hit
+		template<typename Kernel>
+		static inline void appendKernelBytes(nbl::core::vector<uint8_t>& bytes, const Kernel& kernel)
+		{
+			static_assert(std::is_trivially_copyable_v<Kernel>, "Kernel state has to be plain data to be used as a cache key");
+			const auto* begin = reinterpret_cast<const uint8_t*>(&kernel);
+			bytes.insert(bytes.end(),begin,begin+sizeof(Kernel));
+		}
+
+		mutable std::mutex m_mutex;
+		nbl::core::unordered_map<SKey,nbl::core::smart_refctd_ptr<const nbl::asset::ICPUBuffer>,SKeyHash> m_entries;
+		uint64_t m_hits = 0ull;
+		uint64_t m_misses = 0ull;
+};
+
+#endif
@@ -11,6 +11,8 @@
 #include "../common/CommonAPI.h"
 #include "nbl/ext/ScreenShot/ScreenShot.h"
 
+#include "ScaledKernelPhasedLUTCache.h"
+
 using namespace nbl;
 using namespace nbl::asset;
 using namespace nbl::core;
@@ -148,11 +150,13 @@ class BlitFilterTestApp : public ApplicationBase
 			blitFilterState.scratchMemoryByteSize = BlitFilter::getRequiredScratchByteSize(&blitFilterState);
 			blitFilterState.scratchMemory = reinterpret_cast<uint8_t*>(_NBL_ALIGNED_MALLOC(blitFilterState.scratchMemoryByteSize, 32));
 
-			if (!blit_utils_t::computeScaledKernelPhasedLUT(blitFilterState.scratchMemory + BlitFilter::getScratchOffset(&blitFilterState, BlitFilter::ESU_SCALED_KERNEL_PHASED_LUT), blitFilterState.inExtentLayerCount, blitFilterState.outExtentLayerCount, blitFilterState.inImage->getCreationParameters().type, m_convolutionKernels))
+			auto scaledKernelPhasedLUT = m_parentApp->scaledKernelPhasedLUTCache.get<blit_utils_t>(blitFilterState.inExtentLayerCount, blitFilterState.outExtentLayerCount, blitFilterState.inImage->getCreationParameters().type, m_convolutionKernels);
+			if (!scaledKernelPhasedLUT)
 			{
 				m_parentApp->logger->log("Failed to compute the LUT for blitting", system::ILogger::ELL_ERROR);
 				return false;
 			}
+			memcpy(blitFilterState.scratchMemory + BlitFilter::getScratchOffset(&blitFilterState, BlitFilter::ESU_SCALED_KERNEL_PHASED_LUT), scaledKernelPhasedLUT->getPointer(), scaledKernelPhasedLUT->getSize());
 
 			if (!BlitFilter::execute(core::execution::par_unseq, &blitFilterState))
 			{
@@ -431,7 +435,9 @@ class BlitFilterTestApp : public ApplicationBase
 				blitFilterState.scratchMemoryByteSize = BlitFilter::getRequiredScratchByteSize(&blitFilterState);
 				blitFilterState.scratchMemory = reinterpret_cast<uint8_t*>(_NBL_ALIGNED_MALLOC(blitFilterState.scratchMemoryByteSize, 32));
 
-				if (!BlitFilter::blit_utils_t::computeScaledKernelPhasedLUT(blitFilterState.scratchMemory + BlitFilter::getScratchOffset(&blitFilterState, BlitFilter::ESU_SCALED_KERNEL_PHASED_LUT), blitFilterState.inExtentLayerCount, blitFilterState.outExtentLayerCount, blitFilterState.inImage->getCreationParameters().type, m_convolutionKernels))
+				if (auto scaledKernelPhasedLUT = m_parentApp->scaledKernelPhasedLUTCache.get<blit_utils_t>(blitFilterState.inExtentLayerCount, blitFilterState.outExtentLayerCount, blitFilterState.inImage->getCreationParameters().type, m_convolutionKernels); scaledKernelPhasedLUT)
+					memcpy(blitFilterState.scratchMemory + BlitFilter::getScratchOffset(&blitFilterState, BlitFilter::ESU_SCALED_KERNEL_PHASED_LUT), scaledKernelPhasedLUT->getPointer(), scaledKernelPhasedLUT->getSize());
+				else
 					m_parentApp->logger->log("Failed to compute the LUT for blitting\n", system::ILogger::ELL_ERROR);
 
 				m_parentApp->logger->log("CPU begin..");
@@ -613,14 +619,14 @@ class BlitFilterTestApp : public ApplicationBase
 				// create scaledKernelPhasedLUT and its view
 				core::smart_refctd_ptr<video::IGPUBufferView> scaledKernelPhasedLUTView = nullptr;
 				{
-					const auto lutSize = blit_utils_t::getScaledKernelPhasedLUTSize(inExtent, m_outImageDim, inImageType, m_convolutionKernels);
-
-					uint8_t* lutMemory = reinterpret_cast<uint8_t*>(_NBL_ALIGNED_MALLOC(lutSize, 32));
-					if (!blit_utils_t::computeScaledKernelPhasedLUT(lutMemory, inExtent, m_outImageDim, inImageType, m_convolutionKernels))
+					// same LUT as the CPU blit above, so this is a cache hit
+					auto lut = m_parentApp->scaledKernelPhasedLUTCache.get<blit_utils_t>(inExtent, m_outImageDim, inImageType, m_convolutionKernels);
+					if (!lut)
 					{
 						m_parentApp->logger->log("Failed to compute scaled kernel phased LUT for the GPU case!", system::ILogger::ELL_ERROR);
 						return false;
 					}
+					const auto lutSize = lut->getSize();
 
 					video::IGPUBuffer::SCreationParams creationParams = {};
 					creationParams.usage = static_cast<video::IGPUBuffer::E_USAGE_FLAGS>(video::IGPUBuffer::EUF_STORAGE_BUFFER_BIT | video::IGPUBuffer::EUF_UNIFORM_TEXEL_BUFFER_BIT | video::IGPUBuffer::EUF_TRANSFER_DST_BIT);
@@ -635,7 +641,7 @@ class BlitFilterTestApp : public ApplicationBase
 					bufferRange.offset = 0ull;
 					bufferRange.size = lutSize;
 					bufferRange.buffer = scaledKernelPhasedLUT;
-					m_parentApp->utilities->updateBufferRangeViaStagingBufferAutoSubmit(bufferRange, lutMemory, m_parentApp->queues[CommonAPI::InitOutput::EQT_COMPUTE]);
+					m_parentApp->utilities->updateBufferRangeViaStagingBufferAutoSubmit(bufferRange, lut->getPointer(), m_parentApp->queues[CommonAPI::InitOutput::EQT_COMPUTE]);
 
 					asset::E_FORMAT bufferViewFormat;
 					if constexpr (std::is_same_v<blit_utils_t::lut_value_type, uint16_t>)
@@ -646,8 +652,6 @@ class BlitFilterTestApp : public ApplicationBase
 						assert(false);
 
 					scaledKernelPhasedLUTView = m_parentApp->logicalDevice->createBufferView(scaledKernelPhasedLUT.get(), bufferViewFormat, 0ull, scaledKernelPhasedLUT->getSize());
-
-					_NBL_ALIGNED_FREE(lutMemory);
 				}
 
 				auto blitDSLayout = blitFilter->getDefaultBlitDescriptorSetLayout(m_alphaSemantic);
@@ -881,6 +885,319 @@ class BlitFilterTestApp : public ApplicationBase
 		const char* m_writeImagePath;
 	};
 
+	// Not an `ITest`, the CPU blit gets timed over a grid of kernels, sizes, formats, alpha semantics and execution policies
+	// so that offline mip-map generation can pick a kernel based on numbers instead of looks.
+	class CBlitImageFilterBenchmark
+	{
+		using clock_type = std::chrono::steady_clock;
+
+	public:
+		CBlitImageFilterBenchmark(BlitFilterTestApp* parentApp) : m_parentApp(parentApp) { assert(m_parentApp); }
+
+		void run()
+		{
+			// 16K RGBA32F alone is 4GB, larger combinations get skipped
+			constexpr uint64_t MemoryBudget = 3ull << 30;
+			constexpr uint32_t Sizes[] = { 1024u, 2048u, 4096u, 8192u, 16384u };
+			constexpr std::pair<asset::E_FORMAT, const char*> Formats[] = {
+				{ asset::EF_R8G8B8A8_SRGB, "R8G8B8A8_SRGB" },
+				{ asset::EF_R16G16B16A16_SFLOAT, "R16G16B16A16_SFLOAT" },
+				{ asset::EF_R32G32B32A32_SFLOAT, "R32G32B32A32_SFLOAT" }
+			};
+			constexpr IBlitUtilities::E_ALPHA_SEMANTIC AlphaSemantics[] = { IBlitUtilities::EAS_NONE_OR_PREMULTIPLIED, IBlitUtilities::EAS_REFERENCE_OR_COVERAGE };
+			// thread scaling is measured on a single size, bigger ones would need a copy of the output and scratch per thread
+			constexpr uint32_t ScalingSize = 2048u;
+
+			m_parentApp->logger->log("CBlitImageFilter benchmark, %u hardware threads", system::ILogger::ELL_PERFORMANCE, std::thread::hardware_concurrency());
+
+			for (const auto& [format, formatName] : Formats)
+			for (const auto size : Sizes)
+			{
+				const uint64_t inBytes = uint64_t(size) * size * asset::getTexelOrBlockBytesize(format);
+				if (inBytes + inBytes / 4ull > MemoryBudget)
+				{
+					m_parentApp->logger->log("Skipping %ux%u %s, over the memory budget", system::ILogger::ELL_INFO, size, size, formatName);
+					continue;
+				}
+
+				auto inImage = m_parentApp->createCPUImage(core::vectorSIMDu32(size, size, 1u, 1u), asset::IImage::ET_2D, format, true);
+				if (!inImage)
+					continue;
+
+				for (const auto alphaSemantic : AlphaSemantics)
+				{
+					const SConfig config = { inImage.get(), formatName, alphaSemantic, MemoryBudget - inBytes, size == ScalingSize };
+					benchmarkKernel<asset::SBoxFunction>("Box", config);
+					benchmarkKernel<asset::SMitchellFunction<>>("Mitchell", config);
+					benchmarkKernel<asset::SKaiserFunction>("Kaiser", config);
+				}
+			}
+		}
+
+		// Resizes a batch of images to a few target sizes like a texture pipeline would, once computing the phased LUT
+		// for every blit and once going through a `CScaledKernelPhasedLUTCache`, to see what the cache saves.
+		void runRepeatedResolutionBatch()
+		{
+			constexpr uint32_t InSizes[] = { 1024u, 768u };
+			constexpr uint32_t OutSizes[] = { 256u, 128u, 64u };
+			constexpr asset::E_FORMAT Format = asset::EF_R8G8B8A8_SRGB;
+
+			SBatch batch;
+			for (const auto size : InSizes)
+			{
+				auto inImage = m_parentApp->createCPUImage(core::vectorSIMDu32(size, size, 1u, 1u), asset::IImage::ET_2D, Format, true);
+				if (!inImage)
+					return;
+				batch.inImages.push_back(std::move(inImage));
+			}
+			for (const auto size : OutSizes)
+			{
+				auto outImage = m_parentApp->createCPUImage(core::vectorSIMDu32(size, size, 1u, 1u), asset::IImage::ET_2D, Format);
+				if (!outImage)
+					return;
+				batch.outImages.push_back(std::move(outImage));
+			}
+
+			benchmarkLUTCache<asset::SMitchellFunction<>>("Mitchell", batch);
+			benchmarkLUTCache<asset::SKaiserFunction>("Kaiser", batch);
+		}
+
+	private:
+		struct SConfig
+		{
+			asset::ICPUImage* inImage;
+			const char* formatName;
+			IBlitUtilities::E_ALPHA_SEMANTIC alphaSemantic;
+			uint64_t memoryBudget;
+			bool measureScaling;
+		};
+
+		// what one blit needs on top of the input image, which all blits share
+		template <typename BlitFilter>
+		struct SBlitResources
+		{
+			template <typename ConvolutionKernels>
+			SBlitResources(const ConvolutionKernels& kernels) : state(kernels) {}
+			~SBlitResources()
+			{
+				if (state.scratchMemory)
+					_NBL_ALIGNED_FREE(state.scratchMemory);
+			}
+
+			core::smart_refctd_ptr<asset::ICPUImage> outImage;
+			typename BlitFilter::state_type state;
+		};
+
+		template <typename Kernel>
+		void benchmarkKernel(const char* kernelName, const SConfig& config)
+		{
+			asset::ICPUImage* const inImage = config.inImage;
+			using BlitUtilities = asset::CBlitUtilities<asset::CDefaultChannelIndependentWeightFunction1D<asset::CConvolutionWeightFunction1D<asset::CWeightFunction1D<Kernel>, asset::CWeightFunction1D<Kernel>>>>;
+			using BlitFilter = asset::CBlitImageFilter<asset::VoidSwizzle, asset::IdentityDither, void, true, BlitUtilities>;
+
+			const auto& inParams = inImage->getCreationParameters();
+			// halving every dimension, same as generating the next mip level
+			const core::vectorSIMDu32 outImageDim(inParams.extent.width / 2u, inParams.extent.height / 2u, 1u, inParams.arrayLayers);
+			const auto kernels = BlitUtilities::template getConvolutionKernels<asset::CWeightFunction1D<Kernel>>(core::vectorSIMDu32(inParams.extent.width, inParams.extent.height, inParams.extent.depth, 1u), outImageDim);
+
+			auto createResources = [&]() -> std::unique_ptr<SBlitResources<BlitFilter>>
+			{
+				auto retval = std::make_unique<SBlitResources<BlitFilter>>(kernels);
+				auto& state = retval->state;
+
+				state.inOffsetBaseLayer = core::vectorSIMDu32();
+				state.inExtentLayerCount = core::vectorSIMDu32(0u, 0u, 0u, inParams.arrayLayers) + inImage->getMipSize();
+				state.inImage = inImage;
+				state.outOffsetBaseLayer = core::vectorSIMDu32();
+				state.outExtentLayerCount = outImageDim;
+				state.alphaSemantic = config.alphaSemantic;
+				state.alphaRefValue = 0.5f;
+				state.scratchMemoryByteSize = BlitFilter::getRequiredScratchByteSize(&state);
+
+				const uint64_t outBytes = uint64_t(outImageDim.x) * outImageDim.y * asset::getTexelOrBlockBytesize(inParams.format);
+				if (outBytes + state.scratchMemoryByteSize > config.memoryBudget)
+					return nullptr;
+
+				retval->outImage = m_parentApp->createCPUImage(outImageDim, inParams.type, inParams.format);
+				if (!retval->outImage)
+					return nullptr;
+				state.outImage = retval->outImage.get();
+				state.scratchMemory = reinterpret_cast<uint8_t*>(_NBL_ALIGNED_MALLOC(state.scratchMemoryByteSize, 32));
+
+				if (!BlitUtilities::computeScaledKernelPhasedLUT(state.scratchMemory + BlitFilter::getScratchOffset(&state, BlitFilter::ESU_SCALED_KERNEL_PHASED_LUT), state.inExtentLayerCount, state.outExtentLayerCount, inParams.type, kernels))
+					return nullptr;
+				return retval;
+			};
+
+			auto resources = createResources();
+			if (!resources)
+			{
+				m_parentApp->logger->log("%s %ux%u %s: failed to set up the blit or over the memory budget", system::ILogger::ELL_ERROR, kernelName, inParams.extent.width, inParams.extent.height, config.formatName);
+				return;
+			}
+
+			const double inMegapixels = double(inParams.extent.width) * inParams.extent.height * inParams.arrayLayers / 1000000.0;
+			const double seqSeconds = timeBlit<BlitFilter>(core::execution::seq, &resources->state);
+			const double parSeconds = timeBlit<BlitFilter>(core::execution::par_unseq, &resources->state);
+			if (seqSeconds < 0.0 || parSeconds < 0.0)
+			{
+				m_parentApp->logger->log("%s %ux%u %s: blit failed", system::ILogger::ELL_ERROR, kernelName, inParams.extent.width, inParams.extent.height, config.formatName);
+				return;
+			}
+
+			m_parentApp->logger->log(
+				"%s %ux%u %s %s: seq %.1f MP/s, par_unseq %.1f MP/s (%.2fx), scratch %llu bytes",
+				system::ILogger::ELL_PERFORMANCE,
+				kernelName, inParams.extent.width, inParams.extent.height, config.formatName,
+				config.alphaSemantic == IBlitUtilities::EAS_REFERENCE_OR_COVERAGE ? "coverage" : "premultiplied",
+				inMegapixels / seqSeconds, inMegapixels / parSeconds, seqSeconds / parSeconds,
+				static_cast<unsigned long long>(resources->state.scratchMemoryByteSize)
+			);
+
+			if (!config.measureScaling)
+				return;
+
+			// `par_unseq` doesn't let us pick the thread count, so scaling is measured the way a batch pipeline would use the filter:
+			// every thread runs its own `seq` blit of the same input concurrently
+			const uint32_t maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+			core::vector<std::unique_ptr<SBlitResources<BlitFilter>>> perThread;
+			perThread.push_back(std::move(resources));
+			for (uint32_t threadCount = 1u; ; threadCount = core::min(threadCount * 2u, maxThreads))
+			{
+				while (perThread.size() < threadCount)
+				{
+					auto extra = createResources();
+					if (!extra)
+						return;
+					perThread.push_back(std::move(extra));
+				}
+
+				std::atomic_bool success = true;
+				const auto start = clock_type::now();
+				{
+					core::vector<std::thread> threads;
+					threads.reserve(threadCount);
+					for (uint32_t t = 0u; t < threadCount; t++)
+						threads.emplace_back([&, t]() -> void
+						{
+							if (!BlitFilter::execute(core::execution::seq, &perThread[t]->state))
+								success = false;
+						});
+					for (auto& thread : threads)
+						thread.join();
+				}
+				const double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+				if (!success)
+					return;
+
+				const double throughput = inMegapixels * threadCount / seconds;
+				m_parentApp->logger->log(
+					"\t%u threads: %.1f MP/s, %.0f%% efficiency",
+					system::ILogger::ELL_PERFORMANCE,
+					threadCount, throughput, 100.0 * throughput / (threadCount * inMegapixels / seqSeconds)
+				);
+				if (threadCount == maxThreads)
+					break;
+			}
+		}
+
+		struct SBatch
+		{
+			core::vector<core::smart_refctd_ptr<asset::ICPUImage>> inImages;
+			core::vector<core::smart_refctd_ptr<asset::ICPUImage>> outImages;
+		};
+
+		template <typename Kernel>
+		void benchmarkLUTCache(const char* kernelName, const SBatch& batch)
+		{
+			using BlitUtilities = asset::CBlitUtilities<asset::CDefaultChannelIndependentWeightFunction1D<asset::CConvolutionWeightFunction1D<asset::CWeightFunction1D<Kernel>, asset::CWeightFunction1D<Kernel>>>>;
+			using BlitFilter = asset::CBlitImageFilter<asset::VoidSwizzle, asset::IdentityDither, void, true, BlitUtilities>;
+
+			constexpr uint32_t BatchSize = 96u;
+
+			// local so that the numbers don't depend on which tests ran before
+			CScaledKernelPhasedLUTCache cache;
+			double lutSeconds[2] = {};
+			double totalSeconds[2] = {};
+			for (const bool useCache : { false, true })
+			{
+				const auto batchStart = clock_type::now();
+				for (uint32_t i = 0u; i < BatchSize; i++)
+				{
+					asset::ICPUImage* inImage = batch.inImages[i % batch.inImages.size()].get();
+					asset::ICPUImage* outImage = batch.outImages[(i / batch.inImages.size()) % batch.outImages.size()].get();
+					const auto inType = inImage->getCreationParameters().type;
+					const core::vectorSIMDu32 inExtentLayerCount = core::vectorSIMDu32(0u, 0u, 0u, inImage->getCreationParameters().arrayLayers) + inImage->getMipSize();
+					const core::vectorSIMDu32 outExtentLayerCount = core::vectorSIMDu32(0u, 0u, 0u, outImage->getCreationParameters().arrayLayers) + outImage->getMipSize();
+
+					const auto kernels = BlitUtilities::template getConvolutionKernels<asset::CWeightFunction1D<Kernel>>(inExtentLayerCount, outExtentLayerCount);
+					SBlitResources<BlitFilter> resources(kernels);
+					auto& state = resources.state;
+					state.inOffsetBaseLayer = core::vectorSIMDu32();
+					state.inExtentLayerCount = inExtentLayerCount;
+					state.inImage = inImage;
+					state.outOffsetBaseLayer = core::vectorSIMDu32();
+					state.outExtentLayerCount = outExtentLayerCount;
+					state.outImage = outImage;
+					state.scratchMemoryByteSize = BlitFilter::getRequiredScratchByteSize(&state);
+					state.scratchMemory = reinterpret_cast<uint8_t*>(_NBL_ALIGNED_MALLOC(state.scratchMemoryByteSize, 32));
+
+					uint8_t* const lutMemory = state.scratchMemory + BlitFilter::getScratchOffset(&state, BlitFilter::ESU_SCALED_KERNEL_PHASED_LUT);
+					const auto lutStart = clock_type::now();
+					if (useCache)
+					{
+						auto lut = cache.get<BlitUtilities>(inExtentLayerCount, outExtentLayerCount, inType, kernels);
+						if (!lut)
+							return;
+						memcpy(lutMemory, lut->getPointer(), lut->getSize());
+					}
+					else if (!BlitUtilities::computeScaledKernelPhasedLUT(lutMemory, inExtentLayerCount, outExtentLayerCount, inType, kernels))
+						return;
+					lutSeconds[useCache] += std::chrono::duration<double>(clock_type::now() - lutStart).count();
+
+					if (!BlitFilter::execute(core::execution::par_unseq, &state))
+					{
+						m_parentApp->logger->log("%s batch: blit failed", system::ILogger::ELL_ERROR, kernelName);
+						return;
+					}
+				}
+				totalSeconds[useCache] = std::chrono::duration<double>(clock_type::now() - batchStart).count();
+			}
+
+			m_parentApp->logger->log(
+				"%s batch of %u blits: uncached %.2f ms (LUTs %.2f ms), cached %.2f ms (LUTs %.2f ms), %.2fx faster, %llu LUTs taking %zu bytes",
+				system::ILogger::ELL_PERFORMANCE,
+				kernelName, BatchSize,
+				totalSeconds[0] * 1000.0, lutSeconds[0] * 1000.0, totalSeconds[1] * 1000.0, lutSeconds[1] * 1000.0,
+				totalSeconds[0] / totalSeconds[1],
+				static_cast<unsigned long long>(cache.getMissCount()), cache.getByteSize()
+			);
+		}
+
+		// best of a few runs, or a single one when the image is big enough for that to take a while, negative on failure
+		template <typename BlitFilter, typename ExecutionPolicy>
+		double timeBlit(ExecutionPolicy&& policy, typename BlitFilter::state_type* state)
+		{
+			constexpr uint32_t MaxIterations = 5u;
+			constexpr double MinTotalSeconds = 0.5;
+
+			double best = std::numeric_limits<double>::max();
+			double total = 0.0;
+			for (uint32_t i = 0u; i < MaxIterations && total < MinTotalSeconds; i++)
+			{
+				const auto start = clock_type::now();
+				if (!BlitFilter::execute(policy, state))
+					return -1.0;
+				const double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+				best = core::min(best, seconds);
+				total += seconds;
+			}
+			return best;
+		}
+
+		BlitFilterTestApp* m_parentApp;
+	};
+
 public:
 	void onAppInitialized_impl() override
 	{
@@ -908,6 +1225,9 @@ public:
 		constexpr bool TestSwizzleAndConvertFilter = true;
 		constexpr bool TestGPUBlitFilter = true;
 		constexpr bool TestRegionBlockFunctorFilter = true;
+		// the benchmarks take a long time (the blit one also needs a few GB of memory), so they are off by default
+		constexpr bool BenchmarkCPUBlitFilter = false;
+		constexpr bool BenchmarkLUTCache = false;
 
 		auto loadImage = [this](const char* path) -> core::smart_refctd_ptr<asset::ICPUImage>
 		{
@@ -1495,6 +1815,15 @@ public:
 
 			runTests(TestCount, tests);
 		}
+
+		if (BenchmarkCPUBlitFilter)
+			CBlitImageFilterBenchmark(this).run();
+
+		if (BenchmarkLUTCache)
+		{
+			logger->log("CScaledKernelPhasedLUTCache", system::ILogger::ELL_INFO);
+			CBlitImageFilterBenchmark(this).runRepeatedResolutionBatch();
+		}
 	}
 
 	void onAppTerminated_impl() override
@@ -1604,6 +1933,7 @@ private:
 	core::smart_refctd_ptr<nbl::system::ILogger> logger;
 	core::smart_refctd_ptr<CommonAPI::InputSystem> inputSystem;
 	video::IGPUObjectFromAssetConverter cpu2gpu;
+	CScaledKernelPhasedLUTCache scaledKernelPhasedLUTCache;
 
 public:
 	void setWindow(core::smart_refctd_ptr<nbl::ui::IWindow>&& wnd) override
@@ -0,0 +1,166 @@
+#ifndef _CAD_EXAMPLE_CURVE_BENCHMARK_H_
+#define _CAD_EXAMPLE_CURVE_BENCHMARK_H_
+
+#include "curves.h"
+
+#include <chrono>
+#include <random>
+#include <thread>
+
+// Headless micro-benchmarks of turning every `ExplicitCurve` type into Beziers, comparing the inverse CDF methods of `adaptiveSubdivision`
+// and the serial conversion against `adaptiveSubdivisionBatch` on CAD-like random curves.
+namespace curve_benchmark
+{
+
+template<InverseCDFMethod Method, typename Curve>
+inline double timeSubdivision(const nbl::core::vector<CurveSegment<Curve>>& instances, float64_t targetMaxError, uint32_t maxDepth, nbl::core::vector<QuadraticBezierInfo>& beziers)
+{
+    beziers.clear();
+    AddBezierFunc addBezier = [&beziers](const QuadraticBezierInfo& info) -> void
+        {
+            beziers.push_back(info);
+        };
+
+    const auto start = std::chrono::steady_clock::now();
+    for (const auto& instance : instances)
+        adaptiveSubdivision<Method>(instance.curve, instance.min, instance.max, targetMaxError, addBezier, maxDepth);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template<typename Curve>
+inline void benchmarkCurveType(nbl::system::ILogger* logger, const char* name, const nbl::core::vector<CurveSegment<Curve>>& instances)
+{
+    // same values as the curves drawn in the example
+    constexpr float64_t TargetMaxError = 1e-2;
+    constexpr uint32_t MaxDepth = 10u;
+
+    const uint32_t curveCount = static_cast<uint32_t>(instances.size());
+    nbl::core::vector<QuadraticBezierInfo> beziers;
+    beziers.reserve(curveCount * 16u);
+    const double bisectionSeconds = timeSubdivision<InverseCDFMethod::BISECTION>(instances, TargetMaxError, MaxDepth, beziers);
+    const size_t bisectionBezierCount = beziers.size();
+    const double newtonSeconds = timeSubdivision<InverseCDFMethod::NEWTON>(instances, TargetMaxError, MaxDepth, beziers);
+    const size_t newtonBezierCount = beziers.size();
+
+    // both solvers stop within the same CDF tolerance but not at the same split, so the counts can differ slightly
+    logger->log("%s x%u: bisection %.0f Beziers/s (%zu Beziers), newton %.0f Beziers/s (%zu Beziers), %.2fx faster", nbl::system::ILogger::ELL_PERFORMANCE,
+        name, curveCount,
+        double(bisectionBezierCount) / bisectionSeconds, bisectionBezierCount,
+        double(newtonBezierCount) / newtonSeconds, newtonBezierCount,
+        bisectionSeconds / newtonSeconds);
+}
+
+// every random value gets its own statement, the evaluation order of function arguments isn't specified and the curves should be the same everywhere
+using real_dist = std::uniform_real_distribution<float64_t>;
+
+inline CurveSegment<Parabola> generateParabola(std::mt19937& rng)
+{
+    const float64_t halfLen = real_dist(5.0, 50.0)(rng);
+    const float64_t a = real_dist(-0.05, 0.05)(rng);
+    const float64_t b = real_dist(-2.0, 2.0)(rng);
+    const float64_t c = real_dist(-10.0, 10.0)(rng);
+    return { Parabola(a, b, c), -halfLen, halfLen };
+}
+
+inline CurveSegment<MixedParabola> generateMixedParabola(std::mt19937& rng)
+{
+    const float64_t chordLen = real_dist(10.0, 100.0)(rng);
+    float64_t2 P0, P3;
+    P0.x = -real_dist(5.0, 60.0)(rng);
+    P0.y = real_dist(-90.0, 90.0)(rng);
+    P3.x = chordLen + real_dist(5.0, 60.0)(rng);
+    P3.y = real_dist(-90.0, 90.0)(rng);
+    return { MixedParabola::fromFourPoints(P0, float64_t2(0.0, 0.0), float64_t2(chordLen, 0.0), P3), 0.0, chordLen };
+}
+
+inline CurveSegment<ExplicitEllipse> generateEllipse(std::mt19937& rng)
+{
+    const float64_t b = real_dist(5.0, 50.0)(rng);
+    const float64_t a = real_dist(5.0, 50.0)(rng);
+    return { ExplicitEllipse(a, b), -b, b };
+}
+
+// built directly instead of with `fromFourPoints`, whose circle centers only land on x=0 up to rounding
+inline CurveSegment<MixedCircle> generateMixedCircle(std::mt19937& rng)
+{
+    const float64_t halfChord = real_dist(5.0, 50.0)(rng);
+    MixedCircle circle = {};
+    circle.origin1Y = real_dist(-60.0, 60.0)(rng);
+    circle.origin2Y = real_dist(-60.0, 60.0)(rng);
+    circle.radius1 = sqrt(halfChord * halfChord + circle.origin1Y * circle.origin1Y);
+    circle.radius2 = sqrt(halfChord * halfChord + circle.origin2Y * circle.origin2Y);
+    circle.chordLen = 2.0 * halfChord;
+    return { circle, -halfChord, halfChord };
+}
+
+template<typename Curve>
+inline nbl::core::vector<CurveSegment<Curve>> generateCurves(uint32_t count, CurveSegment<Curve>(*generate)(std::mt19937&))
+{
+    std::mt19937 rng(0x45u);
+    nbl::core::vector<CurveSegment<Curve>> curves;
+    curves.reserve(count);
+    for (uint32_t i = 0u; i < count; ++i)
+        curves.push_back(generate(rng));
+    return curves;
+}
+
+template<typename Curve>
+inline nbl::core::SRange<const CurveSegment<Curve>> asRange(const nbl::core::vector<CurveSegment<Curve>>& curves)
+{
+    return nbl::core::SRange<const CurveSegment<Curve>>(curves.data(), curves.data() + curves.size());
+}
+
+inline void benchmarkCurveSubdivision(nbl::system::ILogger* logger, uint32_t curveCount = 20000u)
+{
+    benchmarkCurveType(logger, "Parabola", generateCurves(curveCount, generateParabola));
+    benchmarkCurveType(logger, "MixedParabola", generateCurves(curveCount, generateMixedParabola));
+    benchmarkCurveType(logger, "ExplicitEllipse", generateCurves(curveCount, generateEllipse));
+    benchmarkCurveType(logger, "MixedCircle", generateCurves(curveCount, generateMixedCircle));
+}
+
+// A CAD import sized batch of every curve type, converted one curve at a time and with `adaptiveSubdivisionBatch`, the outputs have to match exactly
+inline void benchmarkCurveBatch(nbl::system::ILogger* logger, uint32_t curvesPerType = 250000u)
+{
+    constexpr float64_t TargetMaxError = 1e-2;
+    constexpr uint32_t MaxDepth = 10u;
+
+    const auto parabolas = generateCurves(curvesPerType, generateParabola);
+    const auto mixedParabolas = generateCurves(curvesPerType, generateMixedParabola);
+    const auto ellipses = generateCurves(curvesPerType, generateEllipse);
+    const auto mixedCircles = generateCurves(curvesPerType, generateMixedCircle);
+
+    nbl::core::vector<QuadraticBezierInfo> serialBeziers;
+    auto start = std::chrono::steady_clock::now();
+    {
+        AddBezierFunc addBezier = [&serialBeziers](const QuadraticBezierInfo& info) -> void
+            {
+                serialBeziers.push_back(info);
+            };
+        auto subdivideAll = [&](const auto& curves) -> void
+            {
+                for (const auto& segment : curves)
+                    adaptiveSubdivision(segment.curve, segment.min, segment.max, TargetMaxError, addBezier, MaxDepth);
+            };
+        subdivideAll(parabolas);
+        subdivideAll(mixedParabolas);
+        subdivideAll(ellipses);
+        subdivideAll(mixedCircles);
+    }
+    const double serialSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    nbl::core::vector<QuadraticBezierInfo> batchBeziers;
+    start = std::chrono::steady_clock::now();
+    adaptiveSubdivisionBatch(batchBeziers, TargetMaxError, MaxDepth, asRange(parabolas), asRange(mixedParabolas), asRange(ellipses), asRange(mixedCircles));
+    const double batchSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const bool identical = serialBeziers.size() == batchBeziers.size() && memcmp(serialBeziers.data(), batchBeziers.data(), serialBeziers.size() * sizeof(QuadraticBezierInfo)) == 0;
+    if (!identical)
+        logger->log("adaptiveSubdivisionBatch output differs from serial adaptiveSubdivision!", nbl::system::ILogger::ELL_ERROR);
+
+    logger->log("Batch of %u curves: serial %.3f s, batch %.3f s on %u hardware threads (%.2fx), %.0f Beziers/s", nbl::system::ILogger::ELL_PERFORMANCE,
+        curvesPerType * 4u, serialSeconds, batchSeconds, std::thread::hardware_concurrency(), serialSeconds / batchSeconds, double(batchBeziers.size()) / batchSeconds);
+}
+
+}
+
+#endif
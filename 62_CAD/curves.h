@@ -318,15 +318,80 @@ inline float64_t inverseCDF_Bisection(const ExplicitCurve& curve, float64_t targ
     return xi;
 }
 
-inline void adaptiveSubdivision_impl(const ExplicitCurve& curve, float64_t min, float64_t max, float64_t targetMaxError, AddBezierFunc& addBezierFunc, uint32_t depth)
+// Same job as `inverseCDF_Bisection` but the derivative of the CDF is just the differential arc length, so Newton steps converge in a few iterations,
+// bisection on a shrinking bracket kicks in whenever a step would leave it (near vertical tangents the derivative blows up).
+// Every iteration only integrates from the previous guess to the new one, instead of twice over the whole [min,max].
+// `integral` is the arc length over [min,max], `outCDF` receives the arc length over [min,xi] so callers splitting the curve can reuse both halves.
+inline float64_t inverseCDF_Newton(const ExplicitCurve& curve, float64_t targetCDF, float64_t min, float64_t max, float64_t integral, float64_t* outCDF = nullptr)
 {
-    float64_t split = inverseCDF_Bisection(curve, 0.5, min, max);
+    constexpr float64_t cdfAccuracyThreshold = 1e-4;
+    constexpr uint16_t iterationThreshold = 16u;
+
+    const float64_t target = targetCDF * integral;
+
+    float64_t low = min;
+    float64_t high = max;
+    // arc length grows at least as fast as x, so lerping the domain is a decent first guess
+    float64_t xi = min + targetCDF * (max - min);
+    float64_t sum = cdf(curve, min, xi);
+    for (uint16_t i = 0; i < iterationThreshold; ++i)
+    {
+        const float64_t valueAtParamGuess = sum - target;
+        if (abs(valueAtParamGuess) < cdfAccuracyThreshold * integral)
+            break;
+
+        if (valueAtParamGuess > 0.0)
+            high = xi;
+        else
+            low = xi;
+
+        float64_t next = xi - valueAtParamGuess / curve.differentialArcLen(xi);
+        if (!(next > low && next < high))
+            next = (low + high) / 2.0;
+
+        // integrating backwards gives a negative value, so this works for steps in both directions
+        sum += cdf(curve, xi, next);
+        xi = next;
+    }
+
+    if (outCDF)
+        *outCDF = sum;
+    return xi;
+}
+
+inline float64_t inverseCDF_Newton(const ExplicitCurve& curve, float64_t targetCDF, float64_t min, float64_t max)
+{
+    return inverseCDF_Newton(curve, targetCDF, min, max, cdf(curve, min, max));
+}
+
+enum class InverseCDFMethod
+{
+    BISECTION,
+    NEWTON,
+};
+
+template<InverseCDFMethod Method = InverseCDFMethod::NEWTON>
+inline void adaptiveSubdivision_impl(const ExplicitCurve& curve, float64_t min, float64_t max, float64_t integral, float64_t targetMaxError, AddBezierFunc& addBezierFunc, uint32_t depth)
+{
+    float64_t split;
+    float64_t lowerIntegral;
+    if constexpr (Method == InverseCDFMethod::NEWTON)
+    {
+        split = inverseCDF_Newton(curve, 0.5, min, max, integral, &lowerIntegral);
+    }
+    else
+    {
+        split = inverseCDF_Bisection(curve, 0.5, min, max);
+        lowerIntegral = 0.0; // bisection integrates from scratch every time anyway
+    }
 
     // Shouldn't happen but may happen if we don't use bisection for inverse CDF
     if (split <= min || split >= max)
     {
         _NBL_DEBUG_BREAK_IF(true);
         split = (min + max) / 2.0;
+        if constexpr (Method == InverseCDFMethod::NEWTON)
+            lowerIntegral = cdf(curve, min, split);
     }
 
     const float64_t2 P0 = float64_t2(min, curve.y(min));
@@ -354,8 +419,8 @@ inline void adaptiveSubdivision_impl(const ExplicitCurve& curve, float64_t min,
 
     if (shouldSubdivide)
     {
-        adaptiveSubdivision_impl(curve, min, split, targetMaxError, addBezierFunc, depth - 1u);
-        adaptiveSubdivision_impl(curve, split, max, targetMaxError, addBezierFunc, depth - 1u);
+        adaptiveSubdivision_impl<Method>(curve, min, split, lowerIntegral, targetMaxError, addBezierFunc, depth - 1u);
+        adaptiveSubdivision_impl<Method>(curve, split, max, integral - lowerIntegral, targetMaxError, addBezierFunc, depth - 1u);
     }
     else
     {
@@ -363,9 +428,80 @@ inline void adaptiveSubdivision_impl(const ExplicitCurve& curve, float64_t min,
     }
 }
 
+template<InverseCDFMethod Method = InverseCDFMethod::NEWTON>
 inline void adaptiveSubdivision(const ExplicitCurve& curve, float64_t min, float64_t max, float64_t targetMaxError, AddBezierFunc& addBezierFunc, uint32_t maxDepth = 12)
 {
-    adaptiveSubdivision_impl(curve, min, max, targetMaxError, addBezierFunc, maxDepth);
+    // the arc length over the whole domain is the only full integral, every split passes the lengths of both halves down
+    const float64_t integral = Method == InverseCDFMethod::NEWTON ? cdf(curve, min, max) : 0.0;
+    adaptiveSubdivision_impl<Method>(curve, min, max, integral, targetMaxError, addBezierFunc, maxDepth);
+}
+
+// A curve together with the x range to approximate it over, the unit of work for `adaptiveSubdivisionBatch`
+template<typename Curve>
+struct CurveSegment
+{
+    Curve curve;
+    float64_t min;
+    float64_t max;
+};
+
+// Converts whole spans of curves to Beziers on the `core::execution::par` thread pool, appending to `outBeziers`.
+// The output is always in the same order as calling `adaptiveSubdivision` on every curve of every span in turn, regardless of thread timing.
+template<typename... Curves>
+inline void adaptiveSubdivisionBatch(nbl::core::vector<QuadraticBezierInfo>& outBeziers, float64_t targetMaxError, uint32_t maxDepth, const nbl::core::SRange<const CurveSegment<Curves>>&... curves)
+{
+    struct WorkItem
+    {
+        const ExplicitCurve* curve;
+        float64_t min;
+        float64_t max;
+    };
+    nbl::core::vector<WorkItem> items;
+    items.reserve((curves.size() + ... + 0u));
+    auto appendItems = [&items](const auto& segments) -> void
+    {
+        for (const auto& segment : segments)
+            items.push_back({ &segment.curve, segment.min, segment.max });
+    };
+    (appendItems(curves), ...);
+
+    // chunks are fixed size so the split (and with it the output) doesn't depend on the thread count, yet big enough to amortize the scheduling
+    constexpr size_t CurvesPerChunk = 256u;
+    struct Chunk
+    {
+        size_t begin;
+        size_t end;
+        nbl::core::vector<QuadraticBezierInfo> beziers;
+        size_t outputOffset;
+    };
+    nbl::core::vector<Chunk> chunks((items.size() + CurvesPerChunk - 1u) / CurvesPerChunk);
+    for (size_t i = 0u; i < chunks.size(); ++i)
+    {
+        chunks[i].begin = i * CurvesPerChunk;
+        chunks[i].end = std::min(chunks[i].begin + CurvesPerChunk, items.size());
+    }
+
+    std::for_each(nbl::core::execution::par, chunks.begin(), chunks.end(), [&](Chunk& chunk) -> void
+        {
+            AddBezierFunc addBezier = [&chunk](const QuadraticBezierInfo& info) -> void
+                {
+                    chunk.beziers.push_back(info);
+                };
+            for (size_t i = chunk.begin; i < chunk.end; ++i)
+                adaptiveSubdivision(*items[i].curve, items[i].min, items[i].max, targetMaxError, addBezier, maxDepth);
+        });
+
+    size_t outputSize = outBeziers.size();
+    for (auto& chunk : chunks)
+    {
+        chunk.outputOffset = outputSize;
+        outputSize += chunk.beziers.size();
+    }
+    outBeziers.resize(outputSize);
+    std::for_each(nbl::core::execution::par, chunks.begin(), chunks.end(), [&outBeziers](const Chunk& chunk) -> void
+        {
+            std::copy(chunk.beziers.begin(), chunk.beziers.end(), outBeziers.begin() + chunk.outputOffset);
+        });
 }
 
 #endif
\ No newline at end of file
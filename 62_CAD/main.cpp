@@ -7,6 +7,9 @@
 #include <nbl/builtin/hlsl/cpp_compat/matrix.hlsl>
 #include <nbl/builtin/hlsl/cpp_compat/vector.hlsl>
 #include "curves.h"
+#include "CurveBenchmark.h"
+
+#include "nbl/system/CStdoutLogger.h"
 
 static constexpr bool DebugMode = false;
 static constexpr bool FragmentShaderPixelInterlock = true;
@@ -228,6 +231,15 @@ public:
 		m_quadBeziers.insert(m_quadBeziers.end(), quadBeziers.begin(), quadBeziers.end());
 	}
 
+	// Approximates whole spans of curves with quadratic beziers on multiple threads, then adds them as if `addQuadBeziers` was called per curve in order
+	template<typename... Curves>
+	void addCurves(float64_t targetMaxError, const core::SRange<const CurveSegment<Curves>>&... curves)
+	{
+		core::vector<QuadraticBezierInfo> quadBeziers;
+		adaptiveSubdivisionBatch(quadBeziers, targetMaxError, 12u, curves...);
+		addQuadBeziers(core::SRange<QuadraticBezierInfo>(quadBeziers.data(), quadBeziers.data() + quadBeziers.size()));
+	}
+
 protected:
 	std::vector<SectionInfo> m_sections;
 	std::vector<float64_t2> m_linePoints;
@@ -421,12 +433,30 @@ public:
 		cpuDrawBuffers.customClipProjectionBuffer = core::make_smart_refctd_ptr<asset::ICPUBuffer>(customClipProjectionBufferSize);
 	}
 
+	// CPU side only, for filling without a device (benchmarks), `finalizeAllCopiesToGPU` then has nothing to upload to and only marks everything as copied
+	void allocateCPUBuffers(uint32_t indices, uint32_t mainObjects, uint32_t drawObjects, size_t geometrySize, uint32_t stylesCount, uint32_t clipProjectionDataCount)
+	{
+		maxIndices = indices;
+		maxMainObjects = mainObjects;
+		maxDrawObjects = drawObjects;
+		maxGeometryBufferSize = geometrySize;
+		maxLineStyles = stylesCount;
+		maxClipProjectionData = clipProjectionDataCount;
+
+		cpuDrawBuffers.indexBuffer = core::make_smart_refctd_ptr<asset::ICPUBuffer>(maxIndices * sizeof(index_buffer_type));
+		cpuDrawBuffers.mainObjectsBuffer = core::make_smart_refctd_ptr<asset::ICPUBuffer>(maxMainObjects * sizeof(MainObject));
+		cpuDrawBuffers.drawObjectsBuffer = core::make_smart_refctd_ptr<asset::ICPUBuffer>(maxDrawObjects * sizeof(DrawObject));
+		cpuDrawBuffers.geometryBuffer = core::make_smart_refctd_ptr<asset::ICPUBuffer>(maxGeometryBufferSize);
+		cpuDrawBuffers.lineStylesBuffer = core::make_smart_refctd_ptr<asset::ICPUBuffer>(maxLineStyles * sizeof(LineStyle));
+		cpuDrawBuffers.customClipProjectionBuffer = core::make_smart_refctd_ptr<asset::ICPUBuffer>(maxClipProjectionData * sizeof(ClipProjectionData));
+	}
+
 	uint32_t getIndexCount() const { return currentIndexCount; }
 	
 	// TODO[Przemek]: look at the `drawPolyline` function and you may have to change that as well. if you found out the user input `const LineStyle& lineStyle` for stippling needs processing/computation to be ready to be fed into gpu
 	//	 then have two sturcts (one for cpu side and one that is private to this class and will be fed to gpu)
 	//	 don't force yourself to understand this function completely, it will change soon when I change CSG algo, 
-	//	 just be aware that this drawPolyline function will result in calls to addQuadBeziers_Internal and addLineStyle_Internal and will submit draws if there is no memory left and continue where it left off
+	//	 just be aware that this drawPolyline function will result in calls to addPolylineObjects_Internal and addLineStyle_Internal and will submit draws if there is no memory left and continue where it left off
 	//! this function fills buffers required for drawing a polyline and submits a draw through provided callback when there is not enough memory.
 	video::IGPUQueue::SSubmitInfo drawPolyline(
 		const CPolyline& polyline,
@@ -478,6 +508,71 @@ public:
 		return intendedNextSubmit;
 	}
 
+	//! same as calling `drawPolyline` for each polyline with `lineStyles[i % lineStyles.size()]`, and fills exactly the same bytes in the same order before every submit,
+	//! but only reserves the buffer ranges on the calling thread while the objects get written into the reserved ranges by worker threads.
+	video::IGPUQueue::SSubmitInfo drawPolylines(
+		const core::SRange<const CPolyline>& polylines,
+		const core::SRange<const LineStyle>& lineStyles,
+		const uint32_t clipProjectionIdx,
+		video::IGPUQueue* submissionQueue,
+		video::IGPUFence* submissionFence,
+		video::IGPUQueue::SSubmitInfo intendedNextSubmit)
+	{
+		assert(lineStyles.size() > 0u);
+		core::vector<PolylineFillCommand> pendingFills;
+
+		for (size_t i = 0u; i < polylines.size(); ++i)
+		{
+			const CPolyline& polyline = polylines.begin()[i];
+
+			// a failing add is going to submit, so everything reserved so far has to be written before that
+			uint32_t styleIdx = addLineStyle_Internal(lineStyles.begin()[i % lineStyles.size()]);
+			if (styleIdx == InvalidLineStyleIdx)
+			{
+				fillPolylineObjects_Parallel(pendingFills);
+				intendedNextSubmit = addLineStyle_SubmitIfNeeded(lineStyles.begin()[i % lineStyles.size()], styleIdx, submissionQueue, submissionFence, intendedNextSubmit);
+			}
+
+			MainObject mainObj = {};
+			mainObj.styleIdx = styleIdx;
+			mainObj.clipProjectionIdx = clipProjectionIdx;
+			uint32_t mainObjIdx = addMainObject_Internal(mainObj);
+			if (mainObjIdx == InvalidMainObjectIdx)
+			{
+				fillPolylineObjects_Parallel(pendingFills);
+				intendedNextSubmit = addMainObject_SubmitIfNeeded(mainObj, mainObjIdx, submissionQueue, submissionFence, intendedNextSubmit);
+			}
+
+			const auto sectionsCount = polyline.getSectionsCount();
+			uint32_t currentSectionIdx = 0u;
+			uint32_t currentObjectInSection = 0u;
+			while (currentSectionIdx < sectionsCount)
+			{
+				const auto& currentSection = polyline.getSectionInfoAt(currentSectionIdx);
+				const PolylineFillCommand fillCommand = reservePolylineObjects_Internal(polyline, currentSection, currentObjectInSection, mainObjIdx);
+				if (fillCommand.objectCount > 0u)
+					pendingFills.push_back(fillCommand);
+
+				if (currentObjectInSection >= currentSection.count)
+				{
+					currentSectionIdx++;
+					currentObjectInSection = 0u;
+				}
+				else
+				{
+					fillPolylineObjects_Parallel(pendingFills);
+					intendedNextSubmit = finalizeAllCopiesToGPU(submissionQueue, submissionFence, intendedNextSubmit);
+					intendedNextSubmit = submitDraws(submissionQueue, submissionFence, intendedNextSubmit);
+					resetIndexCounters();
+					resetGeometryCounters();
+				}
+			}
+		}
+
+		fillPolylineObjects_Parallel(pendingFills);
+		return intendedNextSubmit;
+	}
+
 	// TODO[Lucas]: drawHatch function with similar signature to drawPolyline
 	// If we had infinite mem, we would first upload all curves into geometry buffer then upload the "CurveBoxes" with correct gpu addresses to those
 	// But we don't have that so we have to follow a similar auto submission as the "drawPolyline" function with some mutations:
@@ -492,6 +587,18 @@ public:
 		video::IGPUFence* submissionFence,
 		video::IGPUQueue::SSubmitInfo intendedNextSubmit)
 	{
+		if (!utilities)
+		{
+			// CPU only filler
+			inMemIndexCount = currentIndexCount;
+			inMemMainObjectCount = currentMainObjectCount;
+			inMemDrawObjectCount = currentDrawObjectCount;
+			inMemGeometryBufferSize = currentGeometryBufferSize;
+			inMemLineStylesCount = currentLineStylesCount;
+			inMemClipProjectionDataCount = currentClipProjectionDataCount;
+			return intendedNextSubmit;
+		}
+
 		intendedNextSubmit = finalizeIndexCopiesToGPU(submissionQueue, submissionFence, intendedNextSubmit);
 		intendedNextSubmit = finalizeMainObjectCopiesToGPU(submissionQueue, submissionFence, intendedNextSubmit);
 		intendedNextSubmit = finalizeGeometryCopiesToGPU(submissionQueue, submissionFence, intendedNextSubmit);
@@ -741,108 +848,117 @@ protected:
 		return 0u;
 	};
 
+	// where the objects of one section (or the part of it which fit) go, the counters are already bumped past them so fills don't depend on each other
+	struct PolylineFillCommand
+	{
+		const CPolyline* polyline;
+		const CPolyline::SectionInfo* section;
+		uint32_t firstObjectInSection;
+		uint32_t objectCount;
+		uint32_t mainObjIdx;
+		uint32_t drawObjectOffset;
+		uint32_t indexOffset;
+		uint64_t geometryOffset;
+	};
+
 	void addPolylineObjects_Internal(const CPolyline& polyline, const CPolyline::SectionInfo& section, uint32_t& currentObjectInSection, uint32_t mainObjIdx)
 	{
-		if (section.type == ObjectType::LINE)
-			addLines_Internal(polyline, section, currentObjectInSection, mainObjIdx);
-		else if (section.type == ObjectType::QUAD_BEZIER)
-			addQuadBeziers_Internal(polyline, section, currentObjectInSection, mainObjIdx);
-		else
-			assert(false); // we don't handle other object types
+		const PolylineFillCommand fillCommand = reservePolylineObjects_Internal(polyline, section, currentObjectInSection, mainObjIdx);
+		fillPolylineObjects_Internal(fillCommand, 0u, fillCommand.objectCount);
 	}
 
-	void addLines_Internal(const CPolyline& polyline, const CPolyline::SectionInfo& section, uint32_t& currentObjectInSection, uint32_t mainObjIdx)
+	// Reserves as many of the remaining objects of the section as fit in every buffer by bumping the counters, doesn't write anything.
+	PolylineFillCommand reservePolylineObjects_Internal(const CPolyline& polyline, const CPolyline::SectionInfo& section, uint32_t& currentObjectInSection, uint32_t mainObjIdx)
 	{
 		assert(section.count >= 1u);
-		assert(section.type == ObjectType::LINE);
-
-		const auto maxGeometryBufferPoints = (maxGeometryBufferSize - currentGeometryBufferSize) / sizeof(float64_t2);
-		const auto maxGeometryBufferLines = (maxGeometryBufferPoints <= 1u) ? 0u : maxGeometryBufferPoints - 1u;
-
-		uint32_t uploadableObjects = (maxIndices - currentIndexCount) / 6u;
-		uploadableObjects = core::min(uploadableObjects, maxGeometryBufferLines);
-		uploadableObjects = core::min(uploadableObjects, maxDrawObjects - currentDrawObjectCount);
+		const uint32_t cagesPerObject = getCageCountPerPolylineObject(section.type);
 
-		const auto lineCount = section.count;
-		const auto remainingObjects = lineCount - currentObjectInSection;
-		uint32_t objectsToUpload = core::min(uploadableObjects, remainingObjects);
-
-		// Add Indices
-		addPolylineObjectIndices_Internal(currentDrawObjectCount, objectsToUpload);
-
-		// Add DrawObjs
-		DrawObject drawObj = {};
-		drawObj.mainObjIndex = mainObjIdx;
-		drawObj.type_subsectionIdx = uint32_t(static_cast<uint16_t>(ObjectType::LINE) | 0 << 16);
-		drawObj.geometryAddress = geometryBufferAddress + currentGeometryBufferSize;
-		for (uint32_t i = 0u; i < objectsToUpload; ++i)
+		uint32_t uploadableObjects = (maxIndices - currentIndexCount) / (6u * cagesPerObject);
+		if (section.type == ObjectType::LINE)
 		{
-			void* dst = reinterpret_cast<DrawObject*>(cpuDrawBuffers.drawObjectsBuffer->getPointer()) + currentDrawObjectCount;
-			memcpy(dst, &drawObj, sizeof(DrawObject));
-			currentDrawObjectCount += 1u;
-			drawObj.geometryAddress += sizeof(float64_t2);
+			const auto maxGeometryBufferPoints = (maxGeometryBufferSize - currentGeometryBufferSize) / sizeof(float64_t2);
+			const auto maxGeometryBufferLines = (maxGeometryBufferPoints <= 1u) ? 0u : maxGeometryBufferPoints - 1u;
+			uploadableObjects = core::min(uploadableObjects, maxGeometryBufferLines);
 		}
-
-		// Add Geometry
+		else if (section.type == ObjectType::QUAD_BEZIER)
+		{
+			const auto maxGeometryBufferBeziers = (maxGeometryBufferSize - currentGeometryBufferSize) / sizeof(QuadraticBezierInfo);
+			uploadableObjects = core::min(uploadableObjects, maxGeometryBufferBeziers);
+		}
+		else
+			assert(false); // we don't handle other object types
+		// every cage is a draw object
+		uploadableObjects = core::min(uploadableObjects, (maxDrawObjects - currentDrawObjectCount) / cagesPerObject);
+
+		const auto remainingObjects = section.count - currentObjectInSection;
+		const uint32_t objectsToUpload = core::min(uploadableObjects, remainingObjects);
+
+		PolylineFillCommand fillCommand = {};
+		fillCommand.polyline = &polyline;
+		fillCommand.section = &section;
+		fillCommand.firstObjectInSection = currentObjectInSection;
+		fillCommand.objectCount = objectsToUpload;
+		fillCommand.mainObjIdx = mainObjIdx;
+		fillCommand.drawObjectOffset = currentDrawObjectCount;
+		fillCommand.indexOffset = currentIndexCount;
+		fillCommand.geometryOffset = currentGeometryBufferSize;
+
+		currentDrawObjectCount += objectsToUpload * cagesPerObject;
+		currentIndexCount += objectsToUpload * cagesPerObject * 6u;
 		if (objectsToUpload > 0u)
 		{
-			const auto pointsByteSize = sizeof(float64_t2) * (objectsToUpload + 1u);
-			void* dst = reinterpret_cast<char*>(cpuDrawBuffers.geometryBuffer->getPointer()) + currentGeometryBufferSize;
-			auto& linePoint = polyline.getLinePointAt(section.index + currentObjectInSection);
-			memcpy(dst, &linePoint, pointsByteSize);
-			currentGeometryBufferSize += pointsByteSize;
+			if (section.type == ObjectType::LINE)
+				currentGeometryBufferSize += sizeof(float64_t2) * (objectsToUpload + 1u);
+			else
+				currentGeometryBufferSize += sizeof(QuadraticBezierInfo) * objectsToUpload;
 		}
-
 		currentObjectInSection += objectsToUpload;
+		return fillCommand;
 	}
 
-	void addQuadBeziers_Internal(const CPolyline& polyline, const CPolyline::SectionInfo& section, uint32_t& currentObjectInSection, uint32_t mainObjIdx)
+	// Writes objects [begin,end) of a reserved command, disjoint ranges of any commands can be filled concurrently.
+	void fillPolylineObjects_Internal(const PolylineFillCommand& fillCommand, uint32_t begin, uint32_t end) const
 	{
-		// TODO[Przemek]: Beziers are added here, understand how this function works, may come in handy
-		constexpr uint32_t CagesPerQuadBezier = getCageCountPerPolylineObject(ObjectType::QUAD_BEZIER);
-		constexpr uint32_t IndicesPerQuadBezier	= 6u * CagesPerQuadBezier;
-		assert(section.type == ObjectType::QUAD_BEZIER);
-
-		const auto maxGeometryBufferEllipses = (maxGeometryBufferSize - currentGeometryBufferSize) / sizeof(QuadraticBezierInfo);
-
-		uint32_t uploadableObjects = (maxIndices - currentIndexCount) / IndicesPerQuadBezier;
-		uploadableObjects = core::min(uploadableObjects, maxGeometryBufferEllipses);
-		uploadableObjects = core::min(uploadableObjects, maxDrawObjects - currentDrawObjectCount);
-
-		const auto beziersCount = section.count;
-		const auto remainingObjects = beziersCount - currentObjectInSection;
-		uint32_t objectsToUpload = core::min(uploadableObjects, remainingObjects);
+		const auto& section = *fillCommand.section;
+		const uint32_t cagesPerObject = getCageCountPerPolylineObject(section.type);
+		const size_t objectGeometrySize = section.type == ObjectType::LINE ? sizeof(float64_t2) : sizeof(QuadraticBezierInfo);
 
 		// Add Indices
-		addPolylineObjectIndices_Internal(currentDrawObjectCount, objectsToUpload * CagesPerQuadBezier);
+		const uint32_t firstDrawObject = fillCommand.drawObjectOffset + begin * cagesPerObject;
+		addPolylineObjectIndices_Internal(fillCommand.indexOffset + begin * cagesPerObject * 6u, firstDrawObject, (end - begin) * cagesPerObject);
 
 		// Add DrawObjs
+		DrawObject* drawObjects = reinterpret_cast<DrawObject*>(cpuDrawBuffers.drawObjectsBuffer->getPointer()) + firstDrawObject;
 		DrawObject drawObj = {};
-		drawObj.mainObjIndex = mainObjIdx;
-		drawObj.geometryAddress = geometryBufferAddress + currentGeometryBufferSize;
-		for (uint32_t i = 0u; i < objectsToUpload; ++i)
+		drawObj.mainObjIndex = fillCommand.mainObjIdx;
+		drawObj.geometryAddress = geometryBufferAddress + fillCommand.geometryOffset + begin * objectGeometrySize;
+		for (uint32_t i = begin; i < end; ++i)
 		{
-			for (uint16_t subObject = 0; subObject < CagesPerQuadBezier; subObject++)
+			for (uint16_t subObject = 0; subObject < cagesPerObject; subObject++)
 			{
-				drawObj.type_subsectionIdx = uint32_t(static_cast<uint16_t>(ObjectType::QUAD_BEZIER) | (subObject << 16));
-				void* dst = reinterpret_cast<DrawObject*>(cpuDrawBuffers.drawObjectsBuffer->getPointer()) + currentDrawObjectCount;
-				memcpy(dst, &drawObj, sizeof(DrawObject));
-				currentDrawObjectCount += 1u;
+				drawObj.type_subsectionIdx = uint32_t(static_cast<uint16_t>(section.type) | (subObject << 16));
+				memcpy(drawObjects++, &drawObj, sizeof(DrawObject));
 			}
-			drawObj.geometryAddress += sizeof(QuadraticBezierInfo);
+			drawObj.geometryAddress += objectGeometrySize;
 		}
 
 		// Add Geometry
-		if (objectsToUpload > 0u)
+		if (end > begin)
 		{
-			const auto beziersByteSize = sizeof(QuadraticBezierInfo) * (objectsToUpload);
-			void* dst = reinterpret_cast<char*>(cpuDrawBuffers.geometryBuffer->getPointer()) + currentGeometryBufferSize;
-			auto& quadBezier = polyline.getQuadBezierInfoAt(section.index + currentObjectInSection);
-			memcpy(dst, &quadBezier, beziersByteSize);
-			currentGeometryBufferSize += beziersByteSize;
+			void* dst = reinterpret_cast<char*>(cpuDrawBuffers.geometryBuffer->getPointer()) + fillCommand.geometryOffset + begin * objectGeometrySize;
+			const uint32_t objectIx = section.index + fillCommand.firstObjectInSection + begin;
+			if (section.type == ObjectType::LINE)
+			{
+				// lines share their end points, only the last range writes the closing point so concurrent ranges never touch the same bytes
+				const uint32_t pointCount = (end - begin) + (end == fillCommand.objectCount ? 1u : 0u);
+				memcpy(dst, &fillCommand.polyline->getLinePointAt(objectIx), sizeof(float64_t2) * pointCount);
+			}
+			else
+			{
+				// every Bezier has its own control points, so ranges of them are disjoint
+				memcpy(dst, &fillCommand.polyline->getQuadBezierInfoAt(objectIx), sizeof(QuadraticBezierInfo) * (end - begin));
+			}
 		}
-
-		currentObjectInSection += objectsToUpload;
 	}
 
 	// TODO[Lucas] addHatch_Internal with similar signature to functions above. 
@@ -858,11 +974,34 @@ protected:
 			the solution is simple when we iterate on curve boxes and keep track of what curves we have already copied into mem (a map from cpuCurveIndex to geomBufferOffset)
 	*/
 
+	// Writes the reserved commands in chunks of roughly `ObjectsPerFillChunk` objects, every chunk touches disjoint bytes so they need no synchronization
+	void fillPolylineObjects_Parallel(core::vector<PolylineFillCommand>& fillCommands) const
+	{
+		constexpr uint32_t ObjectsPerFillChunk = 4096u;
+		struct FillChunk
+		{
+			const PolylineFillCommand* command;
+			uint32_t begin;
+			uint32_t end;
+		};
+		core::vector<FillChunk> chunks;
+		for (const auto& command : fillCommands)
+		for (uint32_t begin = 0u; begin < command.objectCount; begin += ObjectsPerFillChunk)
+			chunks.push_back({ &command, begin, core::min(begin + ObjectsPerFillChunk, command.objectCount) });
+
+		std::for_each(core::execution::par, chunks.begin(), chunks.end(), [this](const FillChunk& chunk) -> void
+			{
+				fillPolylineObjects_Internal(*chunk.command, chunk.begin, chunk.end);
+			}
+		);
+		fillCommands.clear();
+	}
+
 	//@param oddProvokingVertex is used for our polyline-wide transparency algorithm where we draw the object twice, once to resolve the alpha and another time to draw them
-	void addPolylineObjectIndices_Internal(uint32_t startObject, uint32_t objectCount)
+	void addPolylineObjectIndices_Internal(uint32_t indexOffset, uint32_t startObject, uint32_t objectCount) const
 	{
 		constexpr bool oddProvokingVertex = true; // was useful before, might probably deprecate it later for simplicity or it might be useful for some tricks later on
-		index_buffer_type* indices = reinterpret_cast<index_buffer_type*>(cpuDrawBuffers.indexBuffer->getPointer()) + currentIndexCount;
+		index_buffer_type* indices = reinterpret_cast<index_buffer_type*>(cpuDrawBuffers.indexBuffer->getPointer()) + indexOffset;
 		for (uint32_t i = 0u; i < objectCount; ++i)
 		{
 			index_buffer_type objIndex = startObject + i;
@@ -890,7 +1029,6 @@ protected:
 			}
 			indices[i * 6 + 5u] = objIndex * 4u + 3u;
 		}
-		currentIndexCount += objectCount * 6u;
 	}
 
 	void resetAllCounters()
@@ -965,6 +1103,153 @@ protected:
 	uint64_t geometryBufferAddress = 0u; // Actual BDA offset 0 of the gpu buffer
 };
 
+// Packs synthetic scenes into a `DrawBuffersFiller` backed only by `ICPUBuffer`s, the submit function just counts the flushes,
+// so packing bottlenecks can be found without a GPU.
+static void benchmarkDrawBuffersFiller(system::ILogger* logger)
+{
+	// same limits as `CADApp::initDrawObjects`
+	constexpr uint32_t MaxObjects = 20480u;
+	// CAD polylines are short, split into sections which alternate between lines and beziers in the mixed scene
+	constexpr uint32_t ObjectsPerPolyline = 256u;
+	constexpr uint32_t ObjectsPerSection = 64u;
+	constexpr uint32_t ObjectCounts[] = { 10000u, 100000u, 1000000u, 10000000u };
+
+	enum class SceneType : uint8_t
+	{
+		LINES,
+		BEZIERS,
+		MIXED,
+	};
+	constexpr std::pair<SceneType, const char*> SceneTypes[] = { { SceneType::LINES, "lines" }, { SceneType::BEZIERS, "beziers" }, { SceneType::MIXED, "mixed" } };
+
+	LineStyle styles[3] = {};
+	for (uint32_t i = 0u; i < 3u; ++i)
+	{
+		styles[i].screenSpaceLineWidth = 0.0f;
+		styles[i].worldSpaceLineWidth = 1.0f + float(i);
+		styles[i].color = float32_t4(0.2f * float(i), 0.5f, 0.8f, 1.0f);
+	}
+
+	for (const auto& [sceneType, sceneName] : SceneTypes)
+	for (const uint32_t objectCount : ObjectCounts)
+	{
+		std::mt19937 rng(0x45u);
+		std::uniform_real_distribution<float64_t> coord(-1000.0, 1000.0);
+		auto randomPoint = [&]() -> float64_t2
+		{
+			const float64_t x = coord(rng);
+			const float64_t y = coord(rng);
+			return float64_t2(x, y);
+		};
+
+		core::vector<CPolyline> polylines((objectCount + ObjectsPerPolyline - 1u) / ObjectsPerPolyline);
+		{
+			core::vector<float64_t2> linePoints;
+			core::vector<QuadraticBezierInfo> quadBeziers;
+			uint32_t remaining = objectCount;
+			for (auto& polyline : polylines)
+			{
+				const uint32_t polylineObjects = core::min(remaining, ObjectsPerPolyline);
+				remaining -= polylineObjects;
+				// consecutive sections of the same type would merge, and for lines gain an extra connecting line
+				const uint32_t sectionSize = sceneType == SceneType::MIXED ? ObjectsPerSection : ObjectsPerPolyline;
+				for (uint32_t sectionStart = 0u; sectionStart < polylineObjects; sectionStart += sectionSize)
+				{
+					const uint32_t sectionObjects = core::min(polylineObjects - sectionStart, sectionSize);
+					const bool lines = sceneType == SceneType::LINES || (sceneType == SceneType::MIXED && (sectionStart / sectionSize) % 2u == 0u);
+					if (lines)
+					{
+						linePoints.resize(sectionObjects + 1u);
+						for (auto& point : linePoints)
+							point = randomPoint();
+						polyline.addLinePoints(core::SRange<float64_t2>(linePoints.data(), linePoints.data() + linePoints.size()));
+					}
+					else
+					{
+						quadBeziers.resize(sectionObjects);
+						for (auto& bezier : quadBeziers)
+						for (uint32_t i = 0u; i < 3u; ++i)
+							bezier.p[i] = randomPoint();
+						polyline.addQuadBeziers(core::SRange<QuadraticBezierInfo>(quadBeziers.data(), quadBeziers.data() + quadBeziers.size()));
+					}
+				}
+			}
+		}
+
+		// the submit function hashes what would be uploaded, so the serial and the sharded fill can be checked for identical output
+		struct SFillResult
+		{
+			double seconds;
+			uint32_t flushCount;
+			uint64_t checksum;
+		};
+		auto runFill = [&](const bool sharded) -> SFillResult
+		{
+			DrawBuffersFiller filler;
+			filler.allocateCPUBuffers(MaxObjects * 6u * 2u, MaxObjects, MaxObjects * 5u, MaxObjects * sizeof(QuadraticBezierInfo) * 3u, 16u, 128u);
+			SFillResult result = {};
+			result.checksum = 0xcbf29ce484222325ull; // FNV-1a
+			std::chrono::steady_clock::duration hashingTime = {};
+			auto hashBuffers = [&]() -> void
+			{
+				const auto hashStart = std::chrono::steady_clock::now();
+				const auto& buffers = filler.cpuDrawBuffers;
+				auto hash = [&result](const void* data, size_t size) -> void
+				{
+					const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+					for (size_t i = 0u; i < size; ++i)
+						result.checksum = (result.checksum ^ bytes[i]) * 0x100000001b3ull;
+				};
+				hash(buffers.indexBuffer->getPointer(), filler.getCurrentIndexBufferSize());
+				hash(buffers.mainObjectsBuffer->getPointer(), filler.getCurrentMainObjectsBufferSize());
+				hash(buffers.drawObjectsBuffer->getPointer(), filler.getCurrentDrawObjectsBufferSize());
+				hash(buffers.geometryBuffer->getPointer(), filler.getCurrentGeometryBufferSize());
+				hashingTime += std::chrono::steady_clock::now() - hashStart;
+			};
+			filler.setSubmitDrawsFunction(
+				[&](video::IGPUQueue*, video::IGPUFence*, video::IGPUQueue::SSubmitInfo intendedNextSubmit)
+				{
+					hashBuffers();
+					result.flushCount++;
+					return intendedNextSubmit;
+				}
+			);
+			filler.reset();
+
+			const auto start = std::chrono::steady_clock::now();
+			video::IGPUQueue::SSubmitInfo intendedNextSubmit = {};
+			if (sharded)
+			{
+				const core::SRange<const CPolyline> polylineRange(polylines.data(), polylines.data() + polylines.size());
+				const core::SRange<const LineStyle> styleRange(styles, styles + 3u);
+				intendedNextSubmit = filler.drawPolylines(polylineRange, styleRange, UseDefaultClipProjectionIdx, nullptr, nullptr, intendedNextSubmit);
+			}
+			else
+			{
+				for (size_t i = 0u; i < polylines.size(); ++i)
+					intendedNextSubmit = filler.drawPolyline(polylines[i], styles[i % 3u], UseDefaultClipProjectionIdx, nullptr, nullptr, intendedNextSubmit);
+			}
+			// the end of frame submit
+			filler.finalizeAllCopiesToGPU(nullptr, nullptr, intendedNextSubmit);
+			hashBuffers();
+			result.flushCount++;
+			result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start - hashingTime).count();
+			return result;
+		};
+
+		const SFillResult serial = runFill(false);
+		const SFillResult sharded = runFill(true);
+		if (serial.checksum != sharded.checksum || serial.flushCount != sharded.flushCount)
+			logger->log("DrawBuffersFiller %s x%u: sharded fill output differs from the serial fill!", system::ILogger::ELL_ERROR, sceneName, objectCount);
+
+		logger->log("DrawBuffersFiller %s x%u in %zu polylines: serial %.2f M objects/s (%.2f ms), sharded %.2f M objects/s (%.2f ms) on %u hardware threads, %u flushes", system::ILogger::ELL_PERFORMANCE,
+			sceneName, objectCount, polylines.size(),
+			double(objectCount) / serial.seconds / 1000000.0, serial.seconds * 1000.0,
+			double(objectCount) / sharded.seconds / 1000000.0, sharded.seconds * 1000.0,
+			std::thread::hardware_concurrency(), sharded.flushCount);
+	}
+}
+
 class CADApp : public ApplicationBase
 {
 	constexpr static uint32_t FRAMES_IN_FLIGHT = 3u;
@@ -2225,5 +2510,22 @@ public:
 
 //NBL_COMMON_API_MAIN(CADApp)
 int main(int argc, char** argv) {
+	// CPU only benchmarks, no window or device gets created
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string_view arg = argv[i];
+		if (arg != "-benchmark_curves" && arg != "-benchmark_draw_buffers")
+			continue;
+
+		auto logger = core::make_smart_refctd_ptr<system::CStdoutLogger>(core::bitflag(system::ILogger::ELL_INFO) | system::ILogger::ELL_PERFORMANCE | system::ILogger::ELL_ERROR);
+		if (arg == "-benchmark_curves")
+		{
+			curve_benchmark::benchmarkCurveSubdivision(logger.get());
+			curve_benchmark::benchmarkCurveBatch(logger.get());
+		}
+		else
+			benchmarkDrawBuffersFiller(logger.get());
+		return 0;
+	}
 	CommonAPI::main<CADApp>(argc, argv);
 }
\ No newline at end of file
@@ -0,0 +1,225 @@
+// Copyright (C) 2018-2023 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+
+#include "../common/MonoSystemMonoLoggerApplication.hpp"
+
+// CPU side of 22_RaytracedAO's sampling, that example needs a scene and a GL context to start so it's timed and validated here
+#include "../22_RaytracedAO/SampleSequenceGenerator.h"
+#include "../22_RaytracedAO/LightSampling.h"
+
+#include <chrono>
+#include <random>
+
+using namespace nbl;
+using namespace core;
+using namespace system;
+
+
+class SampleSequenceBenchmarkApp final : public nbl::examples::MonoSystemMonoLoggerApplication
+{
+		using base_t = examples::MonoSystemMonoLoggerApplication;
+	public:
+		using base_t::base_t;
+
+		// we stuff all our work here because its a "single shot" app
+		bool onAppInitialized(smart_refctd_ptr<ISystem>&& system) override
+		{
+			// Remember to call the base class initialization!
+			if (!base_t::onAppInitialized(std::move(system)))
+				return false;
+
+			// run everything unless a single test was asked for
+			const bool runAll = std::find(argv.begin(), argv.end(), "-sample_sequence") == argv.end() && std::find(argv.begin(), argv.end(), "-light_sampling") == argv.end();
+			bool allGood = true;
+			if (runAll || std::find(argv.begin(), argv.end(), "-sample_sequence") != argv.end())
+				allGood = benchmarkSampleSequence() && allGood;
+			if (runAll || std::find(argv.begin(), argv.end(), "-light_sampling") != argv.end())
+				allGood = testLightSampling() && allGood;
+
+			if (allGood)
+				m_logger->log("all good");
+			return allGood;
+		}
+
+		void workLoopBody() override {}
+
+		bool keepRunning() override { return false; }
+
+	private:
+		bool benchmarkSampleSequence()
+		{
+			// same seed as `Renderer::SampleSequence`
+			constexpr uint32_t Seed = 0xdeadbeefu;
+			// 22_RaytracedAO clamps to 2^21, 2^20 is a typical high quality render
+			constexpr uint32_t SampleCount = 0x1u<<20;
+			// the default path depth of 22_RaytracedAO first, the renderer uses one quantized dimension per path vertex after the first
+			constexpr uint32_t PathDepths[] = { 8u, 32u, 64u };
+
+			m_logger->log("Owen scrambled sample sequence generation, %u samples, %u hardware threads", ILogger::ELL_PERFORMANCE, SampleCount, std::thread::hardware_concurrency());
+			bool allIdentical = true;
+			for (const uint32_t pathDepth : PathDepths)
+			{
+				const uint32_t quantizedDimensions = pathDepth - 1u;
+				const size_t bytesize = sample_sequence::QuantizedDimensionsBytesize * quantizedDimensions * SampleCount;
+				core::vector<uint64_t> serial(bytesize / sizeof(uint64_t)), parallel(bytesize / sizeof(uint64_t));
+
+				auto start = std::chrono::steady_clock::now();
+				sample_sequence::generateSerial(reinterpret_cast<uint32_t(*)[2]>(serial.data()), quantizedDimensions, SampleCount, Seed);
+				const double serialSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+				start = std::chrono::steady_clock::now();
+				sample_sequence::generate(reinterpret_cast<uint32_t(*)[2]>(parallel.data()), quantizedDimensions, SampleCount, Seed);
+				const double parallelSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+				// the cache file and the shaders depend on the exact bits, so the parallel generator has to reproduce the serial one
+				const bool identical = serial == parallel;
+				if (!identical)
+				{
+					m_logger->log("Path depth %u: parallel sample sequence differs from the serial one!", ILogger::ELL_ERROR, pathDepth);
+					allIdentical = false;
+				}
+
+				const double dimensionSamples = double(quantizedDimensions) * double(sample_sequence::DimensionsPerQuanta) * double(SampleCount);
+				m_logger->log(
+					"Path depth %3u (%.1f MB): serial %.2f M samples/s, parallel %.2f M samples/s, %.2fx", ILogger::ELL_PERFORMANCE,
+					pathDepth, double(bytesize) / double(0x1u << 20), dimensionSamples / serialSeconds * 1e-6, dimensionSamples / parallelSeconds * 1e-6, serialSeconds / parallelSeconds
+				);
+				// without a cache nothing can be dispatched until the whole sequence is uploaded, so this is what it adds to the time-to-first-frame
+				m_logger->log(
+					"Path depth %3u: time-to-first-frame with a cold sample sequence cache %.3f s -> %.3f s", ILogger::ELL_PERFORMANCE,
+					pathDepth, serialSeconds, parallelSeconds
+				);
+			}
+
+			return allIdentical;
+		}
+
+		// Light selection of 22_RaytracedAO with a binary search over the fixed point CDF versus the alias table,
+		// on a scene sized set of emitters whose power spans several orders of magnitude.
+		bool testLightSampling()
+		{
+			constexpr uint32_t LightCount = 200000u;
+			constexpr uint32_t SampleCount = 0x1u << 26;
+
+			std::mt19937 rng(0x45u);
+			core::vector<float> weights(LightCount);
+			{
+				std::uniform_real_distribution<float> exponent(-4.f, 4.f);
+				for (auto& weight : weights)
+					weight = std::pow(10.f, exponent(rng));
+				// a few lights with no power at all
+				for (uint32_t i = 0u; i < LightCount; i += 997u)
+					weights[i] = 0.f;
+			}
+			const double weightSum = std::accumulate(weights.begin(), weights.end(), 0.0);
+
+			core::vector<uint32_t> cdf(LightCount);
+			auto start = std::chrono::steady_clock::now();
+			light_sampling::buildCDF(weights.data(), LightCount, cdf.data());
+			const double cdfBuildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			core::vector<light_sampling::SAliasTableEntry> aliasTable;
+			start = std::chrono::steady_clock::now();
+			light_sampling::buildAliasTable(weights.data(), LightCount, aliasTable);
+			const double aliasBuildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			// the exact probability the alias table assigns to every light, up to the fixed point quantization
+			double maxAliasError = 0.0;
+			{
+				core::vector<double> aliasPMF(LightCount, 0.0);
+				for (uint32_t bin = 0u; bin < LightCount; bin++)
+				{
+					const double keep = double(aliasTable[bin].threshold) / light_sampling::FixedPointOne;
+					aliasPMF[bin] += keep / double(LightCount);
+					aliasPMF[aliasTable[bin].alias] += (1.0 - keep) / double(LightCount);
+				}
+				for (uint32_t i = 0u; i < LightCount; i++)
+					maxAliasError = core::max(maxAliasError, std::abs(aliasPMF[i] - double(weights[i]) / weightSum));
+			}
+
+			// both get the same random numbers, the selected lights are summed so the loops can't be optimized out
+			core::vector<uint32_t> randomNumbers(SampleCount);
+			for (auto& xi : randomNumbers)
+				xi = rng();
+			core::vector<uint32_t> cdfHistogram(LightCount, 0u), aliasHistogram(LightCount, 0u);
+			auto timeSampling = [&](auto sample, core::vector<uint32_t>& histogram) -> double
+			{
+				core::vector<uint32_t> selected(SampleCount);
+				const auto start = std::chrono::steady_clock::now();
+				for (uint32_t i = 0u; i < SampleCount; i++)
+					selected[i] = sample(randomNumbers[i]);
+				const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				for (const uint32_t light : selected)
+					histogram[light]++;
+				return seconds;
+			};
+			const double cdfSeconds = timeSampling([&](const uint32_t xi) -> uint32_t { return light_sampling::sampleCDF(cdf.data(), LightCount, xi); }, cdfHistogram);
+			const double aliasSeconds = timeSampling([&](const uint32_t xi) -> uint32_t { return light_sampling::sampleAliasTable(aliasTable.data(), LightCount, xi); }, aliasHistogram);
+
+			// Pearson's chi-square against the exact distribution, lights expecting fewer than 5 samples get pooled into one bin
+			auto chiSquare = [&](const core::vector<uint32_t>& histogram, uint32_t& outDegreesOfFreedom) -> double
+			{
+				double retval = 0.0;
+				double pooledExpected = 0.0, pooledObserved = 0.0;
+				uint32_t bins = 0u;
+				for (uint32_t i = 0u; i < LightCount; i++)
+				{
+					const double expected = double(weights[i]) / weightSum * double(SampleCount);
+					if (expected < 5.0)
+					{
+						pooledExpected += expected;
+						pooledObserved += double(histogram[i]);
+						// a light without power must never be picked
+						if (expected == 0.0 && histogram[i] != 0u)
+							return std::numeric_limits<double>::infinity();
+						continue;
+					}
+					const double diff = double(histogram[i]) - expected;
+					retval += diff * diff / expected;
+					bins++;
+				}
+				if (pooledExpected > 0.0)
+				{
+					const double diff = pooledObserved - pooledExpected;
+					retval += diff * diff / pooledExpected;
+					bins++;
+				}
+				outDegreesOfFreedom = bins - 1u;
+				return retval;
+			};
+			uint32_t cdfDegreesOfFreedom, aliasDegreesOfFreedom;
+			const double cdfChiSquare = chiSquare(cdfHistogram, cdfDegreesOfFreedom);
+			const double aliasChiSquare = chiSquare(aliasHistogram, aliasDegreesOfFreedom);
+			// for many degrees of freedom chi-square is close to normal, more than 5 sigma off means the sampler is biased
+			auto sigmas = [](const double chiSquare, const uint32_t degreesOfFreedom) -> double { return (chiSquare - double(degreesOfFreedom)) / std::sqrt(2.0 * double(degreesOfFreedom)); };
+			const double cdfSigmas = sigmas(cdfChiSquare, cdfDegreesOfFreedom);
+			const double aliasSigmas = sigmas(aliasChiSquare, aliasDegreesOfFreedom);
+
+			m_logger->log("%u lights, %u samples", ILogger::ELL_PERFORMANCE, LightCount, SampleCount);
+			m_logger->log(
+				"CDF: built in %.3f ms, %.2f M samples/s, chi-square %.1f with %u degrees of freedom (%.2f sigma)", ILogger::ELL_PERFORMANCE,
+				cdfBuildSeconds * 1000.0, double(SampleCount) / cdfSeconds * 1e-6, cdfChiSquare, cdfDegreesOfFreedom, cdfSigmas
+			);
+			m_logger->log(
+				"Alias table: built in %.3f ms, %.2f M samples/s, chi-square %.1f with %u degrees of freedom (%.2f sigma), max probability error %e", ILogger::ELL_PERFORMANCE,
+				aliasBuildSeconds * 1000.0, double(SampleCount) / aliasSeconds * 1e-6, aliasChiSquare, aliasDegreesOfFreedom, aliasSigmas, maxAliasError
+			);
+
+			bool success = true;
+			if (!(cdfSigmas < 5.0))
+			{
+				m_logger->log("Light CDF doesn't sample the light distribution!", ILogger::ELL_ERROR);
+				success = false;
+			}
+			if (!(aliasSigmas < 5.0))
+			{
+				m_logger->log("Light alias table doesn't sample the light distribution!", ILogger::ELL_ERROR);
+				success = false;
+			}
+			return success;
+		}
+};
+
+NBL_MAIN_FUNC(SampleSequenceBenchmarkApp)
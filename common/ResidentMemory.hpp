@@ -0,0 +1,88 @@
+// Copyright (C) 2023-2023 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+#ifndef _NBL_EXAMPLES_COMMON_RESIDENT_MEMORY_HPP_INCLUDED_
+#define _NBL_EXAMPLES_COMMON_RESIDENT_MEMORY_HPP_INCLUDED_
+
+// always include nabla first
+#include "nabla.h"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <thread>
+
+#ifdef _NBL_PLATFORM_WINDOWS_
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace nbl::examples
+{
+
+// Bytes of physical memory the process currently uses, 0 if unknown
+inline size_t getResidentBytes()
+{
+#ifdef _NBL_PLATFORM_WINDOWS_
+	PROCESS_MEMORY_COUNTERS counters = {};
+	if (GetProcessMemoryInfo(GetCurrentProcess(),&counters,sizeof(counters)))
+		return counters.WorkingSetSize;
+	return 0ull;
+#else
+	size_t totalPages = 0ull, residentPages = 0ull;
+	std::ifstream statm("/proc/self/statm");
+	if (statm >> totalPages >> residentPages)
+		return residentPages*static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	return 0ull;
+#endif
+}
+
+// Tracks the peak resident memory from construction until `stop` by polling every millisecond on its own thread,
+// the OS only knows the peak over the whole process lifetime which is useless when measuring one part of a run.
+class CResidentMemorySampler
+{
+	public:
+		CResidentMemorySampler() : m_residentBefore(getResidentBytes()), m_peakResident(m_residentBefore), m_thread([this]() -> void
+			{
+				while (m_running)
+				{
+					const size_t resident = getResidentBytes();
+					if (resident>m_peakResident)
+						m_peakResident = resident;
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				}
+			})
+		{
+		}
+		~CResidentMemorySampler() {stop();}
+
+		inline void stop()
+		{
+			m_running = false;
+			if (m_thread.joinable())
+				m_thread.join();
+		}
+
+		inline size_t getResidentBefore() const {return m_residentBefore;}
+		inline size_t getPeakResident() const {return m_peakResident;}
+		inline size_t getPeakGrowth() const
+		{
+			const size_t peak = m_peakResident;
+			return peak>m_residentBefore ? (peak-m_residentBefore):0ull;
+		}
+
+	private:
+		const size_t m_residentBefore;
+		std::atomic<size_t> m_peakResident;
+		std::atomic_bool m_running = true;
+		std::thread m_thread;
+};
+
+}
+
+#endif
@@ -0,0 +1,608 @@
+// Copyright (C) 2023-2023 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+#ifndef _NBL_EXAMPLES_COMMON_STREAMING_IMAGE_WRITER_HPP_INCLUDED_
+#define _NBL_EXAMPLES_COMMON_STREAMING_IMAGE_WRITER_HPP_INCLUDED_
+
+// always include nabla first
+#include "nabla.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <numeric>
+
+namespace nbl::examples
+{
+
+// Image writers which take bands of rows as they get produced instead of a whole `ICPUImage`, so the image never has to be in memory twice.
+// Bands get encoded on the thread that hands them in, so producing and encoding them on many threads makes the encode parallel,
+// the only serialized part is appending the encoded blocks to the file in the order the formats demand.
+class CInOrderBlockWriter
+{
+	public:
+		CInOrderBlockWriter(const std::filesystem::path& path, const uint32_t blockCount)
+			: m_file(path,std::ios::binary|std::ios::trunc), m_blockOffsets(blockCount)
+		{
+			m_failed = !m_file;
+		}
+
+		inline bool isValid() const {return !m_failed;}
+
+		// needs to be called before any block gets submitted
+		inline bool writeHeader(const core::vector<uint8_t>& header)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_file.write(reinterpret_cast<const char*>(header.data()),header.size());
+			m_cursor = header.size();
+			m_failed = m_failed || !m_file.good();
+			return isValid();
+		}
+
+		// Block `index` gets written right after block `index-1`, if that one isn't in the file yet this one waits in memory until it is.
+		// Safe to call from many threads at once as long as every block gets submitted only once.
+		inline bool submit(const uint32_t index, core::vector<uint8_t>&& block)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_failed || index<m_nextBlock || index>=m_blockOffsets.size() || !m_pending.emplace(index,std::move(block)).second)
+				return false;
+			for (auto it=m_pending.begin(); it!=m_pending.end() && it->first==m_nextBlock; it=m_pending.erase(it))
+			{
+				m_blockOffsets[m_nextBlock++] = m_cursor;
+				m_file.write(reinterpret_cast<const char*>(it->second.data()),it->second.size());
+				m_cursor += it->second.size();
+			}
+			m_failed = !m_file.good();
+			return isValid();
+		}
+
+		// only complete once every block was written
+		inline const core::vector<uint64_t>& getBlockOffsets() const {return m_blockOffsets;}
+
+		// optionally overwrites already written bytes (like a table of block offsets) and closes the file, fails if any block is missing
+		inline bool close(const uint64_t patchOffset=0ull, const core::vector<uint8_t>& patch={})
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			bool success = !m_failed && m_nextBlock==m_blockOffsets.size();
+			if (success && !patch.empty())
+			{
+				m_file.seekp(patchOffset);
+				m_file.write(reinterpret_cast<const char*>(patch.data()),patch.size());
+			}
+			m_file.close();
+			success = success && !m_file.fail();
+			m_failed = true;
+			return success;
+		}
+
+	private:
+		std::ofstream m_file;
+		std::mutex m_mutex;
+		std::atomic_bool m_failed;
+		uint64_t m_cursor = 0ull;
+		uint32_t m_nextBlock = 0u;
+		core::vector<uint64_t> m_blockOffsets;
+		core::map<uint32_t,core::vector<uint8_t>> m_pending;
+};
+
+// The lossless OpenEXR codecs which work on one scanline block at a time with no state shared between blocks.
+// RLE and ZIP first split the bytes into two halves (even and odd bytes) and store the differences between neighbours,
+// if the result isn't smaller than the raw data the block gets stored raw, readers tell the two apart by the size.
+namespace openexr_codec
+{
+	enum E_COMPRESSION : uint8_t
+	{
+		EC_NONE = 0,
+		EC_RLE = 1,
+		EC_ZIPS = 2,
+		EC_ZIP = 3,
+		EC_PIZ = 4,
+		EC_DWAA = 8
+	};
+
+	inline uint32_t getRowsPerBlock(const E_COMPRESSION compression)
+	{
+		switch (compression)
+		{
+			case EC_ZIP:
+				return 16u;
+			case EC_PIZ:
+				return 32u;
+			case EC_DWAA:
+				return 32u;
+			default:
+				return 1u;
+		}
+	}
+
+	inline bool isSupported(const E_COMPRESSION compression)
+	{
+		return compression==EC_NONE || compression==EC_RLE || compression==EC_ZIPS || compression==EC_ZIP;
+	}
+
+	namespace impl
+	{
+		inline void interleaveAndPredict(const uint8_t* raw, const size_t size, uint8_t* out)
+		{
+			uint8_t* t1 = out;
+			uint8_t* t2 = out+(size+1u)/2u;
+			for (size_t i=0u; i<size; i++)
+				*((i&0x1u) ? t2++:t1++) = raw[i];
+			for (size_t i=size-1u; i>0u && size; i--)
+				out[i] = static_cast<uint8_t>(int32_t(out[i])-int32_t(out[i-1u])+128+256);
+		}
+
+		inline void unpredictAndDeinterleave(uint8_t* data, const size_t size, uint8_t* out)
+		{
+			for (size_t i=1u; i<size; i++)
+				data[i] = static_cast<uint8_t>(int32_t(data[i-1u])+int32_t(data[i])-128);
+			const uint8_t* t1 = data;
+			const uint8_t* t2 = data+(size+1u)/2u;
+			for (size_t i=0u; i<size; i++)
+				out[i] = *((i&0x1u) ? t2++:t1++);
+		}
+
+		// byte runs of 3 or more become a count and the byte, everything else is stored as negative count of literals
+		inline void rleCompress(const uint8_t* in, const size_t size, core::vector<uint8_t>& out)
+		{
+			constexpr ptrdiff_t MinRunLength = 3;
+			constexpr ptrdiff_t MaxRunLength = 127;
+			const uint8_t* const end = in+size;
+			const uint8_t* runStart = in;
+			const uint8_t* runEnd = in+1;
+			while (runStart<end)
+			{
+				while (runEnd<end && *runStart==*runEnd && runEnd-runStart-1<MaxRunLength)
+					runEnd++;
+				if (runEnd-runStart>=MinRunLength)
+				{
+					out.push_back(static_cast<uint8_t>(runEnd-runStart-1));
+					out.push_back(*runStart);
+					runStart = runEnd;
+				}
+				else
+				{
+					while (runEnd<end && (runEnd+1>=end || *runEnd!=runEnd[1] || runEnd+2>=end || runEnd[1]!=runEnd[2]) && runEnd-runStart<MaxRunLength)
+						runEnd++;
+					out.push_back(static_cast<uint8_t>(runStart-runEnd));
+					out.insert(out.end(),runStart,runEnd);
+					runStart = runEnd;
+				}
+				runEnd++;
+			}
+		}
+
+		inline bool rleUncompress(const uint8_t* in, const size_t size, uint8_t* out, const size_t outSize)
+		{
+			const uint8_t* const end = in+size;
+			const uint8_t* const outEnd = out+outSize;
+			while (in<end)
+			{
+				const int32_t count = static_cast<int8_t>(*(in++));
+				if (count<0)
+				{
+					if (end-in<-count || outEnd-out<-count)
+						return false;
+					memcpy(out,in,-count);
+					out -= count;
+					in -= count;
+				}
+				else
+				{
+					if (in==end || outEnd-out<count+1)
+						return false;
+					memset(out,*(in++),count+1);
+					out += count+1;
+				}
+			}
+			return out==outEnd;
+		}
+	}
+
+	// `raw` is a whole block of scanlines, returns the bytes to store
+	inline core::vector<uint8_t> compress(const E_COMPRESSION compression, const uint8_t* raw, const size_t size)
+	{
+		core::vector<uint8_t> out;
+		if (compression!=EC_NONE && size)
+		{
+			core::vector<uint8_t> predicted(size);
+			impl::interleaveAndPredict(raw,size,predicted.data());
+			if (compression==EC_RLE)
+				impl::rleCompress(predicted.data(),size,out);
+			else
+			{
+				uLongf compressedSize = compressBound(size);
+				out.resize(compressedSize);
+				if (::compress2(out.data(),&compressedSize,predicted.data(),size,Z_DEFAULT_COMPRESSION)==Z_OK)
+					out.resize(compressedSize);
+				else
+					out.clear();
+			}
+			if (!out.empty() && out.size()<size)
+				return out;
+		}
+		out.assign(raw,raw+size);
+		return out;
+	}
+
+	// `rawSize` is known from the header, a block of exactly that size was stored raw
+	inline bool decompress(const E_COMPRESSION compression, const uint8_t* data, const size_t size, uint8_t* raw, const size_t rawSize)
+	{
+		if (size==rawSize)
+		{
+			memcpy(raw,data,size);
+			return true;
+		}
+		if (!isSupported(compression) || compression==EC_NONE)
+			return false;
+
+		core::vector<uint8_t> predicted(rawSize);
+		if (compression==EC_RLE)
+		{
+			if (!impl::rleUncompress(data,size,predicted.data(),rawSize))
+				return false;
+		}
+		else
+		{
+			uLongf uncompressedSize = rawSize;
+			if (::uncompress(predicted.data(),&uncompressedSize,data,size)!=Z_OK || uncompressedSize!=rawSize)
+				return false;
+		}
+		impl::unpredictAndDeinterleave(predicted.data(),rawSize,raw);
+		return true;
+	}
+}
+
+// Writes a single part scanline OpenEXR file from bands of rows, compressed with any of the codecs in `openexr_codec` which work per block.
+// Bands can arrive from many threads in any order, but have to start on a block boundary and cover whole blocks (except at the bottom of the image).
+class CStreamingEXRWriter
+{
+	public:
+		using E_COMPRESSION = openexr_codec::E_COMPRESSION;
+		enum E_PIXEL_TYPE : int32_t
+		{
+			EPT_UINT = 0,
+			EPT_HALF = 1,
+			EPT_FLOAT = 2
+		};
+		struct SChannel
+		{
+			std::string name;
+			E_PIXEL_TYPE pixelType;
+		};
+
+		// `channels` in the order `writeRows` interleaves them, the file stores them sorted by name. Check `isValid` before writing.
+		CStreamingEXRWriter(const std::filesystem::path& path, const uint32_t width, const uint32_t height, core::vector<SChannel>&& channels, const E_COMPRESSION compression)
+			: m_width(width), m_height(height), m_compression(compression), m_rowsPerBlock(openexr_codec::getRowsPerBlock(compression)),
+			m_channels(std::move(channels)), m_blocks(path,(height+m_rowsPerBlock-1u)/m_rowsPerBlock)
+		{
+			if (!m_blocks.isValid() || width==0u || height==0u || m_channels.empty() || !openexr_codec::isSupported(compression))
+			{
+				m_blocks.close();
+				return;
+			}
+
+			m_sortedChannels.resize(m_channels.size());
+			std::iota(m_sortedChannels.begin(),m_sortedChannels.end(),0u);
+			std::sort(m_sortedChannels.begin(),m_sortedChannels.end(),[&](const uint32_t lhs, const uint32_t rhs){return m_channels[lhs].name<m_channels[rhs].name;});
+			for (const auto& channel : m_channels)
+				m_rowByteSize += size_t(width)*getPixelTypeBytesize(channel.pixelType);
+
+			// the offset table gets filled in by `finish` once every block's size is known
+			core::vector<uint8_t> header;
+			writeHeader(header);
+			m_offsetTableOffset = header.size();
+			header.resize(header.size()+getBlockCount()*sizeof(uint64_t),0u);
+			m_blocks.writeHeader(header);
+		}
+		// the first `channelCount` of R, G, B and A all of the same type
+		CStreamingEXRWriter(const std::filesystem::path& path, const uint32_t width, const uint32_t height, const uint32_t channelCount, const E_PIXEL_TYPE pixelType, const E_COMPRESSION compression)
+			: CStreamingEXRWriter(path,width,height,getRGBAChannels(channelCount,pixelType),compression) {}
+
+		inline bool isValid() const {return m_blocks.isValid();}
+
+		inline uint32_t getRowsPerBlock() const {return m_rowsPerBlock;}
+		inline uint32_t getBlockCount() const {return (m_height+m_rowsPerBlock-1u)/m_rowsPerBlock;}
+		// bytes of one scanline in the file layout of `writeLines`
+		inline size_t getRowByteSize() const {return m_rowByteSize;}
+
+		// `texels` are `rowCount` rows of interleaved 32bit floats, one per channel in the order they were given to the constructor,
+		// consecutive rows start `rowPitch` floats apart. `EPT_UINT` channels get the values cast to integers.
+		bool writeRows(const uint32_t firstRow, const uint32_t rowCount, const float* texels, const size_t rowPitch)
+		{
+			if (!isValidBand(firstRow,rowCount))
+				return false;
+
+			const uint32_t channelCount = static_cast<uint32_t>(m_channels.size());
+			core::vector<uint8_t> lines(m_rowByteSize*rowCount);
+			uint8_t* out = lines.data();
+			for (uint32_t row=0u; row<rowCount; row++)
+			{
+				const float* rowTexels = texels+rowPitch*row;
+				for (const uint32_t channel : m_sortedChannels)
+				{
+					const float* in = rowTexels+channel;
+					switch (m_channels[channel].pixelType)
+					{
+						case EPT_UINT:
+							for (uint32_t x=0u; x<m_width; x++, in+=channelCount, out+=sizeof(uint32_t))
+							{
+								const uint32_t value = static_cast<uint32_t>(*in);
+								memcpy(out,&value,sizeof(value));
+							}
+							break;
+						case EPT_HALF:
+							for (uint32_t x=0u; x<m_width; x++, in+=channelCount, out+=sizeof(uint16_t))
+							{
+								const uint16_t value = core::Float16Compressor::compress(*in);
+								memcpy(out,&value,sizeof(value));
+							}
+							break;
+						default:
+							for (uint32_t x=0u; x<m_width; x++, in+=channelCount, out+=sizeof(float))
+								memcpy(out,in,sizeof(float));
+							break;
+					}
+				}
+			}
+			return writeLines(firstRow,rowCount,lines.data());
+		}
+
+		// `lines` are `rowCount` rows already in the file layout, every row is all the channels sorted by name one after the other,
+		// each channel `width` values of its pixel type. Safe to call from many threads at once as long as each row is written only once.
+		bool writeLines(const uint32_t firstRow, const uint32_t rowCount, const uint8_t* lines)
+		{
+			if (!isValidBand(firstRow,rowCount))
+				return false;
+
+			for (uint32_t blockRow=0u; blockRow<rowCount; blockRow+=m_rowsPerBlock)
+			{
+				const uint32_t blockRowCount = std::min(m_rowsPerBlock,rowCount-blockRow);
+				const auto data = openexr_codec::compress(m_compression,lines+m_rowByteSize*blockRow,m_rowByteSize*blockRowCount);
+
+				core::vector<uint8_t> block;
+				block.reserve(2u*sizeof(int32_t)+data.size());
+				appendLE(block,firstRow+blockRow);
+				appendLE(block,static_cast<uint32_t>(data.size()));
+				block.insert(block.end(),data.begin(),data.end());
+				if (!m_blocks.submit((firstRow+blockRow)/m_rowsPerBlock,std::move(block)))
+					return false;
+			}
+			return true;
+		}
+
+		// writes the offset table and closes the file, fails if any row is missing
+		bool finish()
+		{
+			core::vector<uint8_t> offsetTable;
+			for (const uint64_t offset : m_blocks.getBlockOffsets())
+				appendLE(offsetTable,offset);
+			return m_blocks.close(m_offsetTableOffset,offsetTable);
+		}
+
+	private:
+		static inline size_t getPixelTypeBytesize(const E_PIXEL_TYPE pixelType) {return pixelType==EPT_HALF ? sizeof(uint16_t):sizeof(float);}
+
+		static inline core::vector<SChannel> getRGBAChannels(const uint32_t channelCount, const E_PIXEL_TYPE pixelType)
+		{
+			constexpr const char* ChannelNames[4] = {"R","G","B","A"};
+			core::vector<SChannel> channels;
+			for (uint32_t i=0u; i<std::min(channelCount,4u); i++)
+				channels.push_back({ChannelNames[i],pixelType});
+			return channels;
+		}
+
+		inline bool isValidBand(const uint32_t firstRow, const uint32_t rowCount) const
+		{
+			if (!isValid() || rowCount==0u || firstRow+rowCount>m_height || firstRow%m_rowsPerBlock)
+				return false;
+			return rowCount%m_rowsPerBlock==0u || firstRow+rowCount==m_height;
+		}
+
+		template<typename T>
+		static inline void appendLE(core::vector<uint8_t>& out, const T value)
+		{
+			for (uint32_t i=0u; i<sizeof(T); i++)
+				out.push_back(static_cast<uint8_t>(uint64_t(value)>>(i*8u)));
+		}
+		static inline void appendString(core::vector<uint8_t>& out, const char* str)
+		{
+			out.insert(out.end(),str,str+strlen(str)+1u);
+		}
+		static inline void appendAttributeHeader(core::vector<uint8_t>& out, const char* name, const char* type, const uint32_t size)
+		{
+			appendString(out,name);
+			appendString(out,type);
+			appendLE(out,size);
+		}
+
+		// magic, version 2 without any flags, then the attributes every OpenEXR file needs, all little endian
+		void writeHeader(core::vector<uint8_t>& out) const
+		{
+			appendLE(out,20000630u);
+			appendLE(out,2u);
+
+			core::vector<uint8_t> channels;
+			for (const uint32_t channel : m_sortedChannels)
+			{
+				appendString(channels,m_channels[channel].name.c_str());
+				appendLE(channels,static_cast<uint32_t>(m_channels[channel].pixelType));
+				appendLE(channels,0u); // pLinear and reserved
+				appendLE(channels,1u); // x sampling
+				appendLE(channels,1u); // y sampling
+			}
+			channels.push_back(0u);
+			appendAttributeHeader(out,"channels","chlist",static_cast<uint32_t>(channels.size()));
+			out.insert(out.end(),channels.begin(),channels.end());
+
+			appendAttributeHeader(out,"compression","compression",1u);
+			out.push_back(m_compression);
+			for (const char* window : {"dataWindow","displayWindow"})
+			{
+				appendAttributeHeader(out,window,"box2i",4u*sizeof(int32_t));
+				appendLE(out,0u);
+				appendLE(out,0u);
+				appendLE(out,m_width-1u);
+				appendLE(out,m_height-1u);
+			}
+			appendAttributeHeader(out,"lineOrder","lineOrder",1u);
+			out.push_back(0u); // INCREASING_Y
+			appendAttributeHeader(out,"pixelAspectRatio","float",sizeof(float));
+			appendLE(out,std::bit_cast<uint32_t>(1.f));
+			appendAttributeHeader(out,"screenWindowCenter","v2f",2u*sizeof(float));
+			appendLE(out,0ull);
+			appendAttributeHeader(out,"screenWindowWidth","float",sizeof(float));
+			appendLE(out,std::bit_cast<uint32_t>(1.f));
+			out.push_back(0u);
+		}
+
+		const uint32_t m_width, m_height;
+		const E_COMPRESSION m_compression;
+		const uint32_t m_rowsPerBlock;
+		const core::vector<SChannel> m_channels;
+		core::vector<uint32_t> m_sortedChannels;
+		size_t m_rowByteSize = 0ull;
+		uint64_t m_offsetTableOffset = 0ull;
+		CInOrderBlockWriter m_blocks;
+};
+
+// Writes an 8 bit per channel PNG from bands of rows. Every block of `RowsPerBlock` rows is filtered and deflated on its own,
+// as a piece of one deflate stream which ends on a byte boundary, so the blocks can be compressed in parallel and concatenated into IDAT chunks.
+class CStreamingPNGWriter
+{
+	public:
+		static inline constexpr uint32_t RowsPerBlock = 64u;
+
+		// `channelCount` of 1 to 4 is gray, gray and alpha, RGB or RGBA, `compressionLevel` is a zlib level. Check `isValid` before writing.
+		CStreamingPNGWriter(const std::filesystem::path& path, const uint32_t width, const uint32_t height, const uint32_t channelCount, const int32_t compressionLevel=Z_DEFAULT_COMPRESSION)
+			: m_width(width), m_height(height), m_channelCount(channelCount), m_compressionLevel(compressionLevel),
+			m_blockChecksums(getBlockCount()), m_blocks(path,getBlockCount()+2u)
+		{
+			if (!m_blocks.isValid() || width==0u || height==0u || channelCount==0u || channelCount>4u)
+			{
+				m_blocks.close();
+				return;
+			}
+
+			constexpr uint8_t ColorTypes[4] = {0u,4u,2u,6u};
+			core::vector<uint8_t> ihdr;
+			appendBE(ihdr,width);
+			appendBE(ihdr,height);
+			ihdr.push_back(8u); // bit depth
+			ihdr.push_back(ColorTypes[channelCount-1u]);
+			ihdr.push_back(0u); // deflate
+			ihdr.push_back(0u); // adaptive filtering
+			ihdr.push_back(0u); // no interlace
+
+			core::vector<uint8_t> header = {0x89u,'P','N','G','\r','\n',0x1au,'\n'};
+			appendChunk(header,"IHDR",ihdr);
+			m_blocks.writeHeader(header);
+		}
+
+		inline bool isValid() const {return m_blocks.isValid();}
+
+		inline uint32_t getBlockCount() const {return (m_height+RowsPerBlock-1u)/RowsPerBlock;}
+
+		// `texels` are `rowCount` rows of `width*channelCount` interleaved bytes, consecutive rows start `rowPitch` bytes apart.
+		// Bands have to start on a multiple of `RowsPerBlock` and cover whole blocks, except at the bottom of the image.
+		// Safe to call from many threads at once as long as each row is written only once.
+		bool writeRows(const uint32_t firstRow, const uint32_t rowCount, const uint8_t* texels, const size_t rowPitch)
+		{
+			if (!isValid() || rowCount==0u || firstRow+rowCount>m_height || firstRow%RowsPerBlock || (rowCount%RowsPerBlock && firstRow+rowCount!=m_height))
+				return false;
+
+			const size_t rowByteSize = size_t(m_width)*m_channelCount;
+			for (uint32_t blockRow=0u; blockRow<rowCount; blockRow+=RowsPerBlock)
+			{
+				const uint32_t blockIx = (firstRow+blockRow)/RowsPerBlock;
+				const uint32_t blockRowCount = std::min(RowsPerBlock,rowCount-blockRow);
+
+				// the Sub filter only looks at the row itself, so blocks don't need the last row of the previous one
+				core::vector<uint8_t> filtered((rowByteSize+1u)*blockRowCount);
+				for (uint32_t row=0u; row<blockRowCount; row++)
+				{
+					const uint8_t* in = texels+rowPitch*(blockRow+row);
+					uint8_t* out = filtered.data()+(rowByteSize+1u)*row;
+					*(out++) = 1u;
+					for (size_t i=0u; i<rowByteSize; i++)
+						out[i] = in[i]-(i>=m_channelCount ? in[i-m_channelCount]:0u);
+				}
+				m_blockChecksums[blockIx] = {adler32(1ul,filtered.data(),filtered.size()),filtered.size()};
+
+				// raw deflate, the zlib header goes in front of the first block and the checksum after the last
+				core::vector<uint8_t> data;
+				if (blockIx==0u)
+					data = {0x78u,0x9cu};
+				z_stream stream = {};
+				if (deflateInit2(&stream,m_compressionLevel,Z_DEFLATED,-15,8,Z_DEFAULT_STRATEGY)!=Z_OK)
+					return false;
+				const size_t headerSize = data.size();
+				data.resize(headerSize+deflateBound(&stream,filtered.size())+16u);
+				stream.next_in = filtered.data();
+				stream.avail_in = static_cast<uInt>(filtered.size());
+				stream.next_out = data.data()+headerSize;
+				stream.avail_out = static_cast<uInt>(data.size()-headerSize);
+				const bool lastBlock = blockIx+1u==getBlockCount();
+				const int result = deflate(&stream,lastBlock ? Z_FINISH:Z_SYNC_FLUSH);
+				data.resize(data.size()-stream.avail_out);
+				const bool consumedAll = stream.avail_in==0u;
+				deflateEnd(&stream);
+				if (!consumedAll || result!=(lastBlock ? Z_STREAM_END:Z_OK))
+					return false;
+
+				core::vector<uint8_t> chunk;
+				appendChunk(chunk,"IDAT",data);
+				if (!m_blocks.submit(blockIx,std::move(chunk)))
+					return false;
+			}
+			return true;
+		}
+
+		// appends the checksum of the whole deflate stream and the end marker, fails if any row is missing
+		bool finish()
+		{
+			if (!isValid())
+				return m_blocks.close();
+			uLong checksum = 1ul;
+			for (const auto& [blockChecksum,blockSize] : m_blockChecksums)
+				checksum = adler32_combine(checksum,blockChecksum,blockSize);
+			core::vector<uint8_t> checksumBytes;
+			appendBE(checksumBytes,static_cast<uint32_t>(checksum));
+
+			core::vector<uint8_t> tail;
+			appendChunk(tail,"IDAT",checksumBytes);
+			core::vector<uint8_t> end;
+			appendChunk(end,"IEND",{});
+			return m_blocks.submit(getBlockCount(),std::move(tail)) && m_blocks.submit(getBlockCount()+1u,std::move(end)) && m_blocks.close();
+		}
+
+	private:
+		static inline void appendBE(core::vector<uint8_t>& out, const uint32_t value)
+		{
+			for (int32_t shift=24; shift>=0; shift-=8)
+				out.push_back(static_cast<uint8_t>(value>>shift));
+		}
+		static inline void appendChunk(core::vector<uint8_t>& out, const char type[4], const core::vector<uint8_t>& data)
+		{
+			appendBE(out,static_cast<uint32_t>(data.size()));
+			const size_t typeOffset = out.size();
+			out.insert(out.end(),type,type+4);
+			out.insert(out.end(),data.begin(),data.end());
+			appendBE(out,static_cast<uint32_t>(crc32(0ul,out.data()+typeOffset,static_cast<uInt>(out.size()-typeOffset))));
+		}
+
+		const uint32_t m_width, m_height, m_channelCount;
+		const int32_t m_compressionLevel;
+		// adler32 and byte size of every block's filtered rows, each block writes only its own
+		core::vector<std::pair<uLong,size_t>> m_blockChecksums;
+		CInOrderBlockWriter m_blocks;
+};
+
+}
+
+#endif